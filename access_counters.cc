@@ -0,0 +1,136 @@
+#include "registry/access_counters.h"
+
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace registry {
+
+namespace internal {
+
+namespace {
+
+// Counters of every thread, live or exited. Never destroyed, so that
+// counting stays valid during static destruction
+struct CounterList {
+  std::mutex mutex;
+  std::vector<ThreadAccessCounters*> all;
+  std::vector<ThreadAccessCounters*> free;
+};
+
+CounterList& Counters() {
+  static CounterList* const counters = new CounterList();
+  return *counters;
+}
+
+// Takes counters for the thread on first use and hands them back on exit
+class CounterLease {
+ public:
+  CounterLease() {
+    CounterList& list = Counters();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (list.free.empty()) {
+      counters_ = new ThreadAccessCounters();
+      list.all.push_back(counters_);
+    } else {
+      counters_ = list.free.back();
+      list.free.pop_back();
+    }
+  }
+
+  ~CounterLease() {
+    CounterList& list = Counters();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    list.free.push_back(counters_);
+  }
+
+  ThreadAccessCounters& counters() { return *counters_; }
+
+ private:
+  ThreadAccessCounters* counters_;
+};
+
+}  // namespace
+
+StatsId NextStatsId() {
+  static std::atomic<StatsId> next_id(1);
+  StatsId id = next_id.load(std::memory_order_relaxed);
+  do {
+    if (id == std::numeric_limits<StatsId>::max()) {
+      return 0;
+    }
+  } while (!next_id.compare_exchange_weak(id, id + 1,
+                                          std::memory_order_relaxed));
+  return id;
+}
+
+ThreadAccessCounters::ThreadAccessCounters() {
+  for (std::atomic<AccessCounts*>& chunk : chunks_) {
+    chunk.store(nullptr, std::memory_order_relaxed);
+  }
+  for (auto& latencies : latencies_) {
+    for (std::atomic<uint64_t>& bucket : latencies) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+ThreadAccessCounters::~ThreadAccessCounters() {
+  for (std::atomic<AccessCounts*>& chunk : chunks_) {
+    delete[] chunk.load(std::memory_order_relaxed);
+  }
+}
+
+void ThreadAccessCounters::RecordLatency(LookupKind kind,
+                                         std::chrono::nanoseconds latency) {
+  std::size_t bucket = 0;
+  for (uint64_t nanoseconds = latency.count(); nanoseconds > 1;
+       nanoseconds >>= 1) {
+    ++bucket;
+  }
+  if (bucket >= kLatencyBucketCount) {
+    bucket = kLatencyBucketCount - 1;
+  }
+  Increment(&latencies_[static_cast<std::size_t>(kind)][bucket]);
+}
+
+AccessCounts* ThreadAccessCounters::AllocateChunk(std::size_t chunk) {
+  AccessCounts* counts = new AccessCounts[kChunkSize];
+  chunks_[chunk].store(counts, std::memory_order_release);
+  return counts;
+}
+
+ThreadAccessCounters& LocalAccessCounters() {
+  thread_local CounterLease lease;
+  return lease.counters();
+}
+
+void SumAccessCounts(StatsId id, uint64_t* reads, uint64_t* writes,
+                     uint64_t* lookups) {
+  *reads = *writes = *lookups = 0;
+  CounterList& list = Counters();
+  std::lock_guard<std::mutex> lock(list.mutex);
+  for (const ThreadAccessCounters* counters : list.all) {
+    if (const AccessCounts* counts = counters->Find(id)) {
+      *reads += counts->reads.load(std::memory_order_relaxed);
+      *writes += counts->writes.load(std::memory_order_relaxed);
+      *lookups += counts->lookups.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+LatencyHistogram SumLookupLatencies(LookupKind kind) {
+  LatencyHistogram histogram = {};
+  CounterList& list = Counters();
+  std::lock_guard<std::mutex> lock(list.mutex);
+  for (const ThreadAccessCounters* counters : list.all) {
+    for (std::size_t bucket = 0; bucket < kLatencyBucketCount; ++bucket) {
+      histogram[bucket] += counters->latency(kind, bucket);
+    }
+  }
+  return histogram;
+}
+
+}  // namespace internal
+
+}  // namespace registry
@@ -0,0 +1,182 @@
+#ifndef REGISTRY_ACCESS_COUNTERS_H_
+#define REGISTRY_ACCESS_COUNTERS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace registry {
+
+/// Kinds of lookups timed by access instrumentation
+enum class LookupKind {
+  // Registry::FindElement() and the typed Find methods
+  kName = 0,
+  // Registry::FindElementByExtendedName() and FindElementHandle()
+  kExtendedName = 1,
+  // Registry::FindElementByFullName() and Find(RegistryPath)
+  kFullName = 2,
+};
+
+constexpr std::size_t kLookupKindCount = 3;
+
+/// Lookup latencies bucketed by powers of two: bucket b counts lookups of
+/// [2^b, 2^(b+1)) nanoseconds, the first bucket also those under a
+/// nanosecond and the last one every longer lookup
+constexpr std::size_t kLatencyBucketCount = 32;
+using LatencyHistogram = std::array<uint64_t, kLatencyBucketCount>;
+
+namespace internal {
+
+/// Access instrumentation is compiled in when REGISTRY_INSTRUMENTATION is
+/// defined, with bazel build --define registry_instrumentation=true. Every
+/// hook is discarded at compile time otherwise
+#if defined(REGISTRY_INSTRUMENTATION)
+constexpr bool kInstrumented = true;
+#else
+constexpr bool kInstrumented = false;
+#endif
+
+/// Identifier of a registry node in access counters, 0 for none
+using StatsId = uint32_t;
+
+/// @return a new identifier, 0 once every identifier was handed out
+StatsId NextStatsId();
+
+struct AccessCounts {
+  std::atomic<uint64_t> reads{0};
+  std::atomic<uint64_t> writes{0};
+  std::atomic<uint64_t> lookups{0};
+};
+
+/// @class ThreadAccessCounters
+/// Access counters of the nodes of every registry, owned by one thread at a
+/// time so that counting is a plain load and store without any contention.
+/// Counters are allocated in chunks, the first time a node in the chunk is
+/// accessed by the thread. Sums are taken over the counters of every thread
+class ThreadAccessCounters {
+ public:
+  static constexpr std::size_t kChunkSize = 1024;
+  static constexpr std::size_t kMaxChunks = 4096;
+
+  ThreadAccessCounters();
+  ~ThreadAccessCounters();
+
+  ThreadAccessCounters(const ThreadAccessCounters&) = delete;
+  ThreadAccessCounters& operator=(const ThreadAccessCounters&) = delete;
+
+  void CountRead(StatsId id) {
+    if (AccessCounts* counts = Counts(id)) {
+      Increment(&counts->reads);
+    }
+  }
+
+  void CountWrite(StatsId id) {
+    if (AccessCounts* counts = Counts(id)) {
+      Increment(&counts->writes);
+    }
+  }
+
+  void CountLookup(StatsId id) {
+    if (AccessCounts* counts = Counts(id)) {
+      Increment(&counts->lookups);
+    }
+  }
+
+  void RecordLatency(LookupKind kind, std::chrono::nanoseconds latency);
+
+  /// May be called from any thread
+  /// @return counters of the node, nullptr if the thread never counted any
+  /// access to its chunk
+  const AccessCounts* Find(StatsId id) const {
+    const std::size_t chunk = id / kChunkSize;
+    if (id == 0 || chunk >= kMaxChunks) {
+      return nullptr;
+    }
+    const AccessCounts* counts = chunks_[chunk].load(std::memory_order_acquire);
+    return counts == nullptr ? nullptr : counts + id % kChunkSize;
+  }
+
+  /// May be called from any thread
+  uint64_t latency(LookupKind kind, std::size_t bucket) const {
+    return latencies_[static_cast<std::size_t>(kind)][bucket].load(
+        std::memory_order_relaxed);
+  }
+
+ private:
+  // Only the owning thread writes the counters
+  static void Increment(std::atomic<uint64_t>* counter) {
+    counter->store(counter->load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+
+  AccessCounts* Counts(StatsId id) {
+    const std::size_t chunk = id / kChunkSize;
+    if (id == 0 || chunk >= kMaxChunks) {
+      return nullptr;
+    }
+    AccessCounts* counts = chunks_[chunk].load(std::memory_order_relaxed);
+    if (counts == nullptr) {
+      counts = AllocateChunk(chunk);
+    }
+    return counts + id % kChunkSize;
+  }
+
+  AccessCounts* AllocateChunk(std::size_t chunk);
+
+  std::atomic<AccessCounts*> chunks_[kMaxChunks];
+  std::atomic<uint64_t> latencies_[kLookupKindCount][kLatencyBucketCount];
+};
+
+/// @return counters of the calling thread. Counters of exited threads are
+/// handed to new threads and never released, so counts are never lost
+ThreadAccessCounters& LocalAccessCounters();
+
+/// @param[in] id identifier of a node
+/// @param[out] reads, writes, lookups accesses counted by every thread
+void SumAccessCounts(StatsId id, uint64_t* reads, uint64_t* writes,
+                     uint64_t* lookups);
+
+/// @return latencies of lookups of the given kind recorded by every thread
+LatencyHistogram SumLookupLatencies(LookupKind kind);
+
+/// @class LookupRecorder
+/// Counts a lookup run on a registry, and the element it finds, and records
+/// its latency once it goes out of scope. Empty unless instrumented
+template <bool kEnabled = kInstrumented>
+class LookupRecorder {
+ public:
+  LookupRecorder(LookupKind kind, StatsId registry_id)
+      : kind_(kind), start_(std::chrono::steady_clock::now()) {
+    LocalAccessCounters().CountLookup(registry_id);
+  }
+
+  ~LookupRecorder() {
+    LocalAccessCounters().RecordLatency(
+        kind_, std::chrono::steady_clock::now() - start_);
+  }
+
+  LookupRecorder(const LookupRecorder&) = delete;
+  LookupRecorder& operator=(const LookupRecorder&) = delete;
+
+  void Found(StatsId id) { LocalAccessCounters().CountLookup(id); }
+
+ private:
+  const LookupKind kind_;
+  const std::chrono::steady_clock::time_point start_;
+};
+
+template <>
+class LookupRecorder<false> {
+ public:
+  LookupRecorder(LookupKind, StatsId) {}
+
+  void Found(StatsId) {}
+};
+
+}  // namespace internal
+
+}  // namespace registry
+
+#endif  // REGISTRY_ACCESS_COUNTERS_H_
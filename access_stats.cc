@@ -0,0 +1,116 @@
+#include "registry/access_stats.h"
+
+#include <algorithm>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace registry {
+
+namespace {
+
+struct ReportLine {
+  const char* kind;
+  std::string_view full_name;
+  AccessStats stats;
+};
+
+void CollectLines(const Registry& registry, std::vector<ReportLine>* lines) {
+  const AccessStats stats = GetAccessStats(registry);
+  if (stats.lookups != 0 || stats.reads != 0 || stats.writes != 0) {
+    lines->push_back(ReportLine{"registry", registry.FullName(), stats});
+  }
+  for (const Registry::Element& element : registry.MatchElements("*")) {
+    const AccessStats element_stats = GetAccessStats(element);
+    if (element_stats.lookups != 0 || element_stats.reads != 0 ||
+        element_stats.writes != 0) {
+      lines->push_back(
+          ReportLine{"element", element.FullName(), element_stats});
+    }
+  }
+  for (const Registry& child : registry.ChildRegistries()) {
+    CollectLines(child, lines);
+  }
+}
+
+const char* LookupKindName(LookupKind kind) {
+  switch (kind) {
+    case LookupKind::kName:
+      return "name";
+    case LookupKind::kExtendedName:
+      return "extended_name";
+    case LookupKind::kFullName:
+      return "full_name";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+AccessStats GetAccessStats(const Registry::Element& element) {
+  AccessStats stats;
+  internal::SumAccessCounts(element.stats_id(), &stats.reads, &stats.writes,
+                            &stats.lookups);
+  return stats;
+}
+
+AccessStats GetAccessStats(const Registry& registry) {
+  AccessStats stats;
+  uint64_t reads;
+  uint64_t writes;
+  internal::SumAccessCounts(registry.stats_id(), &reads, &writes,
+                            &stats.lookups);
+  for (const Registry::Element& element : registry.MatchElements("*")) {
+    const AccessStats element_stats = GetAccessStats(element);
+    stats.reads += element_stats.reads;
+    stats.writes += element_stats.writes;
+  }
+  return stats;
+}
+
+LatencyHistogram GetLookupLatencies(LookupKind kind) {
+  return internal::SumLookupLatencies(kind);
+}
+
+void DumpAccessStats(const Registry& registry, std::string* out) {
+  std::vector<ReportLine> lines;
+  CollectLines(registry, &lines);
+  std::stable_sort(lines.begin(), lines.end(),
+                   [](const ReportLine& left, const ReportLine& right) {
+                     return std::tie(left.stats.lookups, left.stats.reads) >
+                            std::tie(right.stats.lookups, right.stats.reads);
+                   });
+  out->append("# kind lookups reads writes full_name\n");
+  for (const ReportLine& line : lines) {
+    out->append(line.kind);
+    for (uint64_t count :
+         {line.stats.lookups, line.stats.reads, line.stats.writes}) {
+      out->push_back(' ');
+      out->append(std::to_string(count));
+    }
+    out->push_back(' ');
+    out->append(line.full_name);
+    out->push_back('\n');
+  }
+  out->append("# lookup latency: kind upper_bound_ns count...\n");
+  for (LookupKind kind : {LookupKind::kName, LookupKind::kExtendedName,
+                          LookupKind::kFullName}) {
+    const LatencyHistogram histogram = GetLookupLatencies(kind);
+    out->append("latency ");
+    out->append(LookupKindName(kind));
+    for (std::size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+      if (histogram[bucket] == 0) {
+        continue;
+      }
+      out->push_back(' ');
+      out->append(bucket + 1 == histogram.size()
+                      ? "inf"
+                      : std::to_string(uint64_t{2} << bucket));
+      out->push_back(':');
+      out->append(std::to_string(histogram[bucket]));
+    }
+    out->push_back('\n');
+  }
+}
+
+}  // namespace registry
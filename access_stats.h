@@ -0,0 +1,49 @@
+#ifndef REGISTRY_ACCESS_STATS_H_
+#define REGISTRY_ACCESS_STATS_H_
+
+#include <cstdint>
+#include <string>
+
+#include "registry/access_counters.h"
+#include "registry/registry.h"
+
+namespace registry {
+
+/// Access statistics of registries built with instrumentation, see
+/// internal::kInstrumented. Every read and write of an element value and
+/// every lookup is counted per element and per registry, in counters sharded
+/// per thread, and lookup latencies are recorded in histograms. Elements
+/// looked up far more often than their registry is set up are typically
+/// found from inside a loop, and are better resolved once into a handle or a
+/// pointer. Without instrumentation every statistic reads 0
+
+/// @struct AccessStats
+/// Accesses counted since the process started
+struct AccessStats {
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  uint64_t lookups = 0;
+};
+
+/// @return reads and writes of the value of the element, and lookups that
+/// found it
+AccessStats GetAccessStats(const Registry::Element& element);
+
+/// @return lookups run on the registry, whether they found anything or not,
+/// and reads and writes of the elements it holds directly
+AccessStats GetAccessStats(const Registry& registry);
+
+/// @return latencies of the lookups of the given kind run on any registry
+LatencyHistogram GetLookupLatencies(LookupKind kind);
+
+/// Appends a text report of the subtree of registry: a line per registry
+/// and per element accessed at least once, listing its lookups, reads and
+/// writes and its full name, most looked up first. The non-empty buckets of
+/// the lookup latency histograms follow
+/// @param[in] registry root of the subtree reported
+/// @param[out] out report
+void DumpAccessStats(const Registry& registry, std::string* out);
+
+}  // namespace registry
+
+#endif  // REGISTRY_ACCESS_STATS_H_
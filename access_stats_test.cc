@@ -0,0 +1,144 @@
+#include "registry/access_stats.h"
+
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+TEST(AccessCountersTest, CountsPerThread) {
+  auto counters = std::make_unique<internal::ThreadAccessCounters>();
+  EXPECT_EQ(counters->Find(5), nullptr);
+  counters->CountRead(5);
+  counters->CountRead(5);
+  counters->CountWrite(5);
+  counters->CountLookup(5000);
+  // Identifier 0 is never counted
+  counters->CountRead(0);
+  EXPECT_EQ(counters->Find(0), nullptr);
+  ASSERT_NE(counters->Find(5), nullptr);
+  EXPECT_EQ(counters->Find(5)->reads.load(), 2u);
+  EXPECT_EQ(counters->Find(5)->writes.load(), 1u);
+  EXPECT_EQ(counters->Find(6)->reads.load(), 0u);
+  EXPECT_EQ(counters->Find(5000)->lookups.load(), 1u);
+  EXPECT_EQ(counters->Find(internal::ThreadAccessCounters::kChunkSize * 2),
+            nullptr);
+
+  counters->RecordLatency(LookupKind::kName, std::chrono::nanoseconds(0));
+  counters->RecordLatency(LookupKind::kName, std::chrono::nanoseconds(3));
+  counters->RecordLatency(LookupKind::kName, std::chrono::nanoseconds(100));
+  counters->RecordLatency(LookupKind::kFullName, std::chrono::hours(1));
+  EXPECT_EQ(counters->latency(LookupKind::kName, 0), 1u);
+  EXPECT_EQ(counters->latency(LookupKind::kName, 1), 1u);
+  EXPECT_EQ(counters->latency(LookupKind::kName, 6), 1u);
+  EXPECT_EQ(counters->latency(LookupKind::kExtendedName, 6), 0u);
+  EXPECT_EQ(counters->latency(LookupKind::kFullName, kLatencyBucketCount - 1),
+            1u);
+}
+
+TEST(AccessCountersTest, SumsOverThreads) {
+  const internal::StatsId id = internal::NextStatsId();
+  ASSERT_NE(id, 0u);
+  EXPECT_NE(internal::NextStatsId(), id);
+  constexpr int kThreads = 4;
+  constexpr int kCount = 1000;
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([id]() {
+      for (int count = 0; count < kCount; ++count) {
+        internal::LocalAccessCounters().CountWrite(id);
+      }
+      internal::LocalAccessCounters().RecordLatency(
+          LookupKind::kExtendedName, std::chrono::nanoseconds(1 << 20));
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  // Counts of exited threads are kept
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t lookups;
+  internal::SumAccessCounts(id, &reads, &writes, &lookups);
+  EXPECT_EQ(reads, 0u);
+  EXPECT_EQ(writes, static_cast<uint64_t>(kThreads * kCount));
+  EXPECT_EQ(lookups, 0u);
+  EXPECT_GE(GetLookupLatencies(LookupKind::kExtendedName)[20],
+            static_cast<uint64_t>(kThreads));
+}
+
+TEST(AccessStatsTest, CountsRegistryAccesses) {
+  if (!internal::kInstrumented) {
+    GTEST_SKIP() << "Built without REGISTRY_INSTRUMENTATION";
+  }
+  Registry root("robot");
+  Registry* arm = root.AddChildRegistry("arm").ValueOrDie();
+  Registry::Double* gain = arm->AddDouble("gain").ValueOrDie();
+  Registry::DoubleArray* limits = arm->AddDoubleArray("limits", 3).ValueOrDie();
+  const LatencyHistogram before = GetLookupLatencies(LookupKind::kExtendedName);
+
+  for (int loop = 0; loop < 10; ++loop) {
+    Registry::Element* element =
+        root.FindElementByExtendedName("arm.gain").ValueOrDie();
+    double value;
+    element->Extract(&value);
+    *gain = value + 1.0;
+  }
+  EXPECT_FALSE(root.FindElementByExtendedName("arm.missing").HasValue());
+  EXPECT_EQ(arm->FindDouble("gain").ValueOrDie()->value(), 10.0);
+  double values[3];
+  limits->Get(0, 3, values);
+  EXPECT_EQ((*limits)[1], 0.0);
+
+  const AccessStats gain_stats = GetAccessStats(*gain);
+  EXPECT_EQ(gain_stats.lookups, 11u);
+  EXPECT_EQ(gain_stats.reads, 11u);
+  EXPECT_EQ(gain_stats.writes, 10u);
+  const AccessStats limits_stats = GetAccessStats(*limits);
+  EXPECT_EQ(limits_stats.lookups, 0u);
+  EXPECT_EQ(limits_stats.reads, 2u);
+  EXPECT_EQ(limits_stats.writes, 0u);
+  // Lookups run on the registry, reads and writes of its own elements
+  const AccessStats root_stats = GetAccessStats(root);
+  EXPECT_EQ(root_stats.lookups, 11u);
+  EXPECT_EQ(root_stats.reads, 0u);
+  const AccessStats arm_stats = GetAccessStats(*arm);
+  EXPECT_EQ(arm_stats.lookups, 1u);
+  EXPECT_EQ(arm_stats.reads, 13u);
+  EXPECT_EQ(arm_stats.writes, 10u);
+
+  const LatencyHistogram after = GetLookupLatencies(LookupKind::kExtendedName);
+  EXPECT_EQ(std::accumulate(after.begin(), after.end(), uint64_t{0}) -
+                std::accumulate(before.begin(), before.end(), uint64_t{0}),
+            11u);
+
+  std::string report;
+  DumpAccessStats(root, &report);
+  EXPECT_NE(report.find("element 11 11 10 robot.arm.gain\n"),
+            std::string::npos);
+  EXPECT_NE(report.find("registry 11 0 0 robot\n"), std::string::npos);
+  EXPECT_NE(report.find("registry 1 13 10 robot.arm\n"), std::string::npos);
+  // Most looked up first
+  EXPECT_LT(report.find("robot.arm.gain"), report.find("robot.arm.limits"));
+  EXPECT_NE(report.find("latency extended_name "), std::string::npos);
+}
+
+TEST(AccessStatsTest, ReportsNothingWhenNotInstrumented) {
+  if (internal::kInstrumented) {
+    GTEST_SKIP() << "Built with REGISTRY_INSTRUMENTATION";
+  }
+  Registry root("robot");
+  Registry::Double* gain = root.AddDouble("gain").ValueOrDie();
+  *gain = 1.0;
+  root.FindDouble("gain");
+  EXPECT_EQ(gain->stats_id(), 0u);
+  const AccessStats stats = GetAccessStats(*gain);
+  EXPECT_EQ(stats.lookups + stats.reads + stats.writes, 0u);
+}
+
+}  // namespace registry
@@ -0,0 +1,79 @@
+#include "registry/arena.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace registry {
+
+namespace {
+
+char* AlignUp(char* ptr, std::size_t alignment) {
+  const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+  return ptr + ((alignment - (address & (alignment - 1))) & (alignment - 1));
+}
+
+}  // namespace
+
+Arena::Arena(std::size_t block_size)
+    : block_size_(block_size), space_allocated_(0) {}
+
+Arena::~Arena() {
+  // Objects are destroyed in the reverse order of their creation, the memory
+  // itself is released block by block afterwards
+  for (auto it = cleanups_.rbegin(); it != cleanups_.rend(); ++it) {
+    it->destroy(it->object);
+  }
+}
+
+void* Arena::Allocate(std::size_t size, std::size_t alignment) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return PoolFor(nullptr).Allocate(size, alignment, this);
+}
+
+std::string_view Arena::CopyString(std::string_view str) {
+  char* copy = static_cast<char*>(Allocate(str.size(), alignof(char)));
+  std::memcpy(copy, str.data(), str.size());
+  return std::string_view(copy, str.size());
+}
+
+std::size_t Arena::SpaceAllocated() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return space_allocated_;
+}
+
+void* Arena::Pool::Allocate(std::size_t size, std::size_t alignment,
+                            Arena* arena) {
+  char* aligned = next_ == nullptr ? nullptr : AlignUp(next_, alignment);
+  if (aligned == nullptr || aligned + size > end_) {
+    if (size + alignment > arena->block_size_ / 4) {
+      // Large allocations get a block of their own so that the remainder of
+      // the current block is not wasted
+      return AlignUp(arena->NewBlock(size + alignment), alignment);
+    }
+    next_ = arena->NewBlock(arena->block_size_);
+    end_ = next_ + arena->block_size_;
+    aligned = AlignUp(next_, alignment);
+  }
+  next_ = aligned + size;
+  return aligned;
+}
+
+Arena::Pool& Arena::PoolFor(const void* key) {
+  // An arena only ever sees a handful of distinct types, a linear scan is
+  // cheaper than hashing
+  for (Pool& pool : pools_) {
+    if (pool.key() == key) {
+      return pool;
+    }
+  }
+  pools_.emplace_back(key);
+  return pools_.back();
+}
+
+char* Arena::NewBlock(std::size_t size) {
+  blocks_.emplace_back(new char[size]);
+  space_allocated_ += size;
+  return blocks_.back().get();
+}
+
+}  // namespace registry
@@ -0,0 +1,113 @@
+#ifndef REGISTRY_ARENA_H_
+#define REGISTRY_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace registry {
+
+/// Trait used by the Arena to decide whether an object needs its destructor
+/// run when the arena is torn down. Types holding no resources outside of the
+/// arena may specialise it to std::true_type even when their destructor is
+/// not trivial, in which case they are simply released with the arena memory
+template <typename T>
+struct ArenaDestructorSkippable : std::is_trivially_destructible<T> {};
+
+/// @class Arena
+/// Block allocator that owns every object created through it. Objects of the
+/// same type are packed next to each other in dedicated blocks, and the whole
+/// arena is released in one step when it is destroyed. Only objects whose
+/// destructor cannot be skipped are destroyed individually. All methods may be
+/// called concurrently
+class Arena {
+ public:
+  static constexpr std::size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(std::size_t block_size = kDefaultBlockSize);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// Allocates raw memory from the general purpose pool of the arena
+  /// @param[in] size number of bytes to allocate
+  /// @param[in] alignment required alignment, must be a power of two
+  /// @return pointer to the memory, valid for the lifetime of the arena
+  void* Allocate(std::size_t size, std::size_t alignment);
+
+  /// Constructs an object in the pool dedicated to its type
+  /// @param[in] args arguments forwarded to the constructor of T
+  /// @return pointer to the object, owned by the arena
+  template <typename T, typename... Args>
+  T* Create(Args&&... args) {
+    void* memory;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      memory = PoolFor(TypeKey<T>()).Allocate(sizeof(T), alignof(T), this);
+    }
+    T* object = new (memory) T(std::forward<Args>(args)...);
+    if (!ArenaDestructorSkippable<T>::value) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cleanups_.push_back({object, &Destroy<T>});
+    }
+    return object;
+  }
+
+  /// Copies a string into the arena
+  /// @param[in] str characters to copy
+  /// @return view of the copy, valid for the lifetime of the arena
+  std::string_view CopyString(std::string_view str);
+
+  /// @return total number of bytes reserved from the system by the arena
+  std::size_t SpaceAllocated() const;
+
+ private:
+  struct Cleanup {
+    void* object;
+    void (*destroy)(void*);
+  };
+
+  class Pool {
+   public:
+    explicit Pool(const void* key) : key_(key), next_(nullptr), end_(nullptr) {}
+
+    const void* key() const { return key_; }
+    void* Allocate(std::size_t size, std::size_t alignment, Arena* arena);
+
+   private:
+    const void* key_;
+    char* next_;
+    char* end_;
+  };
+
+  template <typename T>
+  static const void* TypeKey() {
+    static const char key = 0;
+    return &key;
+  }
+
+  template <typename T>
+  static void Destroy(void* object) {
+    static_cast<T*>(object)->~T();
+  }
+
+  Pool& PoolFor(const void* key);
+  char* NewBlock(std::size_t size);
+
+  const std::size_t block_size_;
+  mutable std::mutex mutex_;
+  std::size_t space_allocated_;
+  std::vector<Pool> pools_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  std::vector<Cleanup> cleanups_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_ARENA_H_
@@ -0,0 +1,80 @@
+#include "registry/arena.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+namespace {
+
+struct Counted {
+  explicit Counted(int* destroyed) : destroyed(destroyed) {}
+  ~Counted() { ++*destroyed; }
+
+  int* destroyed;
+};
+
+struct Skipped {
+  explicit Skipped(int* destroyed) : destroyed(destroyed) {}
+  ~Skipped() { ++*destroyed; }
+
+  int* destroyed;
+};
+
+}  // namespace
+
+template <>
+struct ArenaDestructorSkippable<Skipped> : std::true_type {};
+
+TEST(ArenaTest, ConstructDestructTest) { Arena arena; }
+
+TEST(ArenaTest, AllocateAlignmentTest) {
+  Arena arena(256);
+  for (std::size_t alignment : {1, 2, 4, 8, 16, 32, 64}) {
+    arena.Allocate(1, 1);
+    void* memory = arena.Allocate(3, alignment);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(memory) % alignment, 0);
+  }
+  void* large = arena.Allocate(1024, 64);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(large) % 64, 0);
+  EXPECT_GE(arena.SpaceAllocated(), 1024);
+}
+
+TEST(ArenaTest, SameTypePackedTest) {
+  Arena arena;
+  double* first = arena.Create<double>(1.0);
+  arena.Create<int32_t>(2);
+  arena.CopyString("interleaved");
+  double* second = arena.Create<double>(3.0);
+  EXPECT_EQ(second, first + 1);
+  EXPECT_EQ(*first, 1.0);
+  EXPECT_EQ(*second, 3.0);
+}
+
+TEST(ArenaTest, CopyStringTest) {
+  Arena arena;
+  std::string original = "joint3";
+  std::string_view copy = arena.CopyString(original);
+  original[0] = 'x';
+  EXPECT_EQ(copy, "joint3");
+  EXPECT_EQ(arena.CopyString(""), "");
+}
+
+TEST(ArenaTest, CleanupTest) {
+  int counted_destroyed = 0;
+  int skipped_destroyed = 0;
+  {
+    Arena arena;
+    arena.Create<Counted>(&counted_destroyed);
+    arena.Create<Counted>(&counted_destroyed);
+    arena.Create<Skipped>(&skipped_destroyed);
+    arena.Create<std::string>(100, 'a');
+    EXPECT_EQ(counted_destroyed, 0);
+  }
+  EXPECT_EQ(counted_destroyed, 2);
+  EXPECT_EQ(skipped_destroyed, 0);
+}
+
+}  // namespace registry
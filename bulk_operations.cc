@@ -0,0 +1,149 @@
+#include "registry/bulk_operations.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+namespace registry {
+
+namespace {
+
+// @return true if both elements hold values of the same type and size, and
+// equal values
+bool SameValue(const Registry::Element& lhs, const Registry::Element& rhs) {
+  if (lhs.type() != rhs.type() || lhs.extent() != rhs.extent() ||
+      lhs.value_size() != rhs.value_size()) {
+    return false;
+  }
+  if (lhs.value_size() == 0) {
+    thread_local std::string lhs_value;
+    thread_local std::string rhs_value;
+    if (!lhs.Extract(&lhs_value) || !rhs.Extract(&rhs_value)) {
+      // Neither trivially copyable nor a string, nothing to compare
+      return true;
+    }
+    return lhs_value == rhs_value;
+  }
+  // Buffers of words are aligned for any value. They are kept per thread so
+  // that comparing does not allocate once they have grown
+  thread_local std::vector<uint64_t> lhs_bytes;
+  thread_local std::vector<uint64_t> rhs_bytes;
+  const std::size_t words = (lhs.value_size() + 7) / 8;
+  if (lhs_bytes.size() < words) {
+    lhs_bytes.resize(words);
+    rhs_bytes.resize(words);
+  }
+  lhs.ExtractBytes(lhs_bytes.data());
+  rhs.ExtractBytes(rhs_bytes.data());
+  return std::memcmp(lhs_bytes.data(), rhs_bytes.data(), lhs.value_size()) ==
+         0;
+}
+
+// Registries at the same relative path below the two registries compared,
+// either of which may be missing
+struct RegistryPair {
+  Registry* lhs;
+  Registry* rhs;
+};
+
+// Appends the pairs of registries below lhs and rhs whose content differs.
+// Subtrees with equal content hashes are skipped, as are the descendants of
+// registries missing on one side, whose elements all differ
+void CollectChangedRegistries(Registry* lhs, Registry* rhs,
+                              std::vector<RegistryPair>* pairs) {
+  if (lhs == nullptr || rhs == nullptr) {
+    pairs->push_back(RegistryPair{lhs, rhs});
+    return;
+  }
+  if (lhs->ContentHash() == rhs->ContentHash()) {
+    return;
+  }
+  pairs->push_back(RegistryPair{lhs, rhs});
+  lhs->ForEachChildRegistry([rhs, pairs](Registry& child) {
+    common::ErrorOr<Registry*> other = rhs->FindChildRegistry(child.name());
+    CollectChangedRegistries(
+        &child, other.HasValue() ? other.ValueOrDie() : nullptr, pairs);
+  });
+  rhs->ForEachChildRegistry([lhs, pairs](Registry& child) {
+    if (!lhs->FindChildRegistry(child.name()).HasValue()) {
+      CollectChangedRegistries(nullptr, &child, pairs);
+    }
+  });
+}
+
+// Appends the relative path of every element held by from whose counterpart
+// in to is missing or, when compare_values is set, holds another value
+void CollectDifferences(Registry* from, Registry* to, bool compare_values,
+                        std::size_t prefix_size,
+                        std::vector<std::string>* differences) {
+  // Own elements are walked directly, listing them from the sorted names of
+  // the tree would sort the whole tree after any addition
+  from->ForEachOwnElement([&](const Registry::Element& element) {
+    common::ErrorOr<Registry::Element*> other = to->FindElement(element.name());
+    if (other.HasValue() &&
+        (!compare_values || SameValue(element, *other.ValueOrDie()))) {
+      return;
+    }
+    differences->emplace_back(element.FullName().substr(prefix_size));
+  });
+}
+
+}  // namespace
+
+void ResetToDefaults(Registry* registry, ThreadPool* pool) {
+  registry->ParallelForEachElement(
+      pool, [](Registry::Element& element) { element.Reset(); });
+}
+
+std::vector<Registry::Element*> FindInvalidElements(
+    const Registry& registry, ThreadPool* pool,
+    const std::function<bool(const Registry::Element&)>& is_valid) {
+  std::mutex mutex;
+  std::vector<Registry::Element*> invalid;
+  registry.ParallelForEachElement(
+      pool, [&mutex, &invalid, &is_valid](Registry::Element& element) {
+        if (!is_valid(element)) {
+          std::lock_guard<std::mutex> lock(mutex);
+          invalid.push_back(&element);
+        }
+      });
+  std::sort(invalid.begin(), invalid.end(),
+            [](const Registry::Element* lhs, const Registry::Element* rhs) {
+              return lhs->handle().id() < rhs->handle().id();
+            });
+  return invalid;
+}
+
+std::vector<std::string> Diff(Registry* lhs, Registry* rhs, ThreadPool* pool) {
+  std::vector<RegistryPair> pairs;
+  CollectChangedRegistries(lhs, rhs, &pairs);
+  const std::size_t lhs_prefix_size = lhs->FullName().size() + 1;
+  const std::size_t rhs_prefix_size = rhs->FullName().size() + 1;
+  std::mutex mutex;
+  std::vector<std::string> differences;
+  pool->ParallelFor(pairs.size(), [&](std::size_t index) {
+    const RegistryPair& pair = pairs[index];
+    std::vector<std::string> found;
+    if (pair.rhs == nullptr) {
+      pair.lhs->ForEachElement([&](const Registry::Element& element) {
+        found.emplace_back(element.FullName().substr(lhs_prefix_size));
+      });
+    } else if (pair.lhs == nullptr) {
+      pair.rhs->ForEachElement([&](const Registry::Element& element) {
+        found.emplace_back(element.FullName().substr(rhs_prefix_size));
+      });
+    } else {
+      CollectDifferences(pair.lhs, pair.rhs, true, lhs_prefix_size, &found);
+      // Elements held by both were compared by the first pass
+      CollectDifferences(pair.rhs, pair.lhs, false, rhs_prefix_size, &found);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    differences.insert(differences.end(), found.begin(), found.end());
+  });
+  std::sort(differences.begin(), differences.end());
+  return differences;
+}
+
+}  // namespace registry
@@ -0,0 +1,48 @@
+#ifndef REGISTRY_BULK_OPERATIONS_H_
+#define REGISTRY_BULK_OPERATIONS_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "registry/registry.h"
+#include "registry/thread_pool.h"
+
+namespace registry {
+
+/// Whole-tree operations run on the threads of a pool, see
+/// Registry::ParallelForEachElement(). Pools of a single thread run them on
+/// the calling thread. Parallel snapshots and serialization are provided by
+/// Snapshot::Capture() and Serializer::Serialize() themselves
+
+/// Resets every element below a registry to the default value of its type,
+/// see Registry::Element::Reset()
+/// @param[in] registry registry whose subtree is reset
+/// @param[in] pool threads resetting the elements
+void ResetToDefaults(Registry* registry, ThreadPool* pool);
+
+/// Checks every element below a registry
+/// @param[in] registry registry whose subtree is checked
+/// @param[in] pool threads checking the elements
+/// @param[in] is_valid called concurrently with every element, returns false
+/// for invalid ones
+/// @return the invalid elements, in order of handle
+std::vector<Registry::Element*> FindInvalidElements(
+    const Registry& registry, ThreadPool* pool,
+    const std::function<bool(const Registry::Element&)>& is_valid);
+
+/// Compares the elements below two registries, of the same tree or not,
+/// matched by their dotted path relative to their registry. Values are
+/// compared bit for bit, strings by content. Subtrees whose content hashes
+/// match are skipped, see Registry::ContentHash(), so that diffs of large
+/// trees differing by a few writes cost little more than those writes
+/// @param[in] lhs registry whose subtree is compared
+/// @param[in] rhs registry whose subtree is compared
+/// @param[in] pool threads comparing the elements
+/// @return sorted relative paths of the elements found below a single
+/// registry, or below both with different types, sizes or values
+std::vector<std::string> Diff(Registry* lhs, Registry* rhs, ThreadPool* pool);
+
+}  // namespace registry
+
+#endif  // REGISTRY_BULK_OPERATIONS_H_
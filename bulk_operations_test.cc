@@ -0,0 +1,138 @@
+#include "registry/bulk_operations.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+class BulkOperationsTest : public ::testing::Test {
+ public:
+  BulkOperationsTest() : pool_(4) {}
+
+ protected:
+  // Fills a registry with child registries of elements of every kind
+  static void Populate(Registry* registry) {
+    for (int child = 0; child < 20; ++child) {
+      Registry* joint =
+          registry->FindOrAddChildRegistry("joint" + std::to_string(child));
+      for (int element = 0; element < 50; ++element) {
+        *joint->AddDouble("gain" + std::to_string(element)).ValueOrDie() =
+            child + element * 0.5;
+      }
+      *joint->AddString("label", "joint").ValueOrDie() = "moving";
+      joint->AddDoubleArray("limits", 3).ValueOrDie()->Set(1, 2.0);
+    }
+    *registry->AddInt32("mode").ValueOrDie() = 3;
+  }
+
+  ThreadPool pool_;
+};
+
+TEST_F(BulkOperationsTest, ParallelForEachElement) {
+  Registry registry("robot");
+  Populate(&registry);
+  std::atomic<std::size_t> count(0);
+  registry.ParallelForEachElement(
+      &pool_, [&count](Registry::Element&) { ++count; });
+  EXPECT_EQ(count.load(), registry.ElementCount());
+
+  // Subtrees only walk their own elements
+  count = 0;
+  registry.FindOrAddChildRegistry("joint3")->ParallelVisit(
+      &pool_, [&count](auto&) { ++count; });
+  EXPECT_EQ(count.load(), 52u);
+}
+
+TEST_F(BulkOperationsTest, ResetToDefaults) {
+  Registry registry("robot");
+  Populate(&registry);
+  ResetToDefaults(&registry, &pool_);
+  registry.ForEachElementOfType<double>(
+      [](Registry::Double& element) { EXPECT_EQ(element.value(), 0.0); });
+  Registry* joint = registry.FindOrAddChildRegistry("joint7");
+  EXPECT_EQ(joint->FindString("label").ValueOrDie()->value(), "");
+  EXPECT_EQ((*joint->FindDoubleArray("limits").ValueOrDie())[1], 0.0);
+  EXPECT_EQ(registry.FindInt32("mode").ValueOrDie()->value(), 0);
+}
+
+TEST_F(BulkOperationsTest, FindInvalidElements) {
+  Registry registry("robot");
+  Populate(&registry);
+  Registry::Double* first = registry.FindOrAddChildRegistry("joint2")
+                                 ->FindDouble("gain4")
+                                 .ValueOrDie();
+  Registry::Double* second = registry.FindOrAddChildRegistry("joint9")
+                                  ->FindDouble("gain1")
+                                  .ValueOrDie();
+  *second = std::numeric_limits<double>::quiet_NaN();
+  *first = std::numeric_limits<double>::infinity();
+
+  std::vector<Registry::Element*> invalid = FindInvalidElements(
+      registry, &pool_, [](const Registry::Element& element) {
+        double value = 0.0;
+        return !element.Extract(&value) || std::isfinite(value);
+      });
+  ASSERT_EQ(invalid.size(), 2u);
+  EXPECT_EQ(invalid[0], first);
+  EXPECT_EQ(invalid[1], second);
+}
+
+TEST_F(BulkOperationsTest, Diff) {
+  Registry lhs("lhs");
+  Registry rhs("rhs");
+  Populate(&lhs);
+  Populate(rhs.FindOrAddChildRegistry("nested"));
+  Registry* nested = rhs.FindOrAddChildRegistry("nested");
+  EXPECT_TRUE(Diff(&lhs, nested, &pool_).empty());
+
+  *nested->FindOrAddChildRegistry("joint5")->FindDouble("gain0").ValueOrDie() =
+      -1.0;
+  *lhs.FindOrAddChildRegistry("joint1")->FindString("label").ValueOrDie() =
+      "stopped";
+  nested->FindOrAddChildRegistry("joint2")
+      ->FindDoubleArray("limits")
+      .ValueOrDie()
+      ->Set(0, 1.0);
+  lhs.AddDouble("extra");
+  nested->FindOrAddChildRegistry("joint4")->AddInt32("extra");
+  std::vector<std::string> differences = Diff(&lhs, nested, &pool_);
+  ASSERT_EQ(differences.size(), 5u);
+  EXPECT_EQ(differences[0], "extra");
+  EXPECT_EQ(differences[1], "joint1.label");
+  EXPECT_EQ(differences[2], "joint2.limits");
+  EXPECT_EQ(differences[3], "joint4.extra");
+  EXPECT_EQ(differences[4], "joint5.gain0");
+}
+
+TEST_F(BulkOperationsTest, DiffSkipsEqualSubtrees) {
+  Registry lhs("lhs");
+  Registry rhs("rhs");
+  Populate(&lhs);
+  Populate(&rhs);
+  Registry::Double* gain =
+      lhs.FindOrAddChildRegistry("joint3")->FindDouble("gain7").ValueOrDie();
+  *gain = 100.0;
+  lhs.FindOrAddChildRegistry("joint3")
+      ->FindOrAddChildRegistry("motor")
+      ->AddDouble("current");
+  rhs.FindOrAddChildRegistry("arm")->FindOrAddChildRegistry("wrist")->AddInt32(
+      "mode");
+  std::vector<std::string> differences = Diff(&lhs, &rhs, &pool_);
+  ASSERT_EQ(differences.size(), 3u);
+  EXPECT_EQ(differences[0], "arm.wrist.mode");
+  EXPECT_EQ(differences[1], "joint3.gain7");
+  EXPECT_EQ(differences[2], "joint3.motor.current");
+
+  // Diffs follow the writes made since the previous one
+  *gain = 6.5;
+  differences = Diff(&lhs, &rhs, &pool_);
+  ASSERT_EQ(differences.size(), 2u);
+  EXPECT_EQ(differences[0], "arm.wrist.mode");
+}
+
+}  // namespace registry
@@ -0,0 +1,32 @@
+#include "registry/change_dispatcher.h"
+
+namespace registry {
+
+ChangeDispatcher::ChangeDispatcher(Registry* registry,
+                                   std::chrono::microseconds period)
+    : registry_(registry), period_(period), stop_(false) {
+  thread_ = std::thread(&ChangeDispatcher::Run, this);
+}
+
+ChangeDispatcher::~ChangeDispatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+}
+
+void ChangeDispatcher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    lock.unlock();
+    registry_->DispatchChanges();
+    lock.lock();
+    stop_condition_.wait_for(lock, period_, [this]() { return stop_; });
+  }
+  lock.unlock();
+  registry_->DispatchChanges();
+}
+
+}  // namespace registry
@@ -0,0 +1,43 @@
+#ifndef REGISTRY_CHANGE_DISPATCHER_H_
+#define REGISTRY_CHANGE_DISPATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "registry/registry.h"
+
+namespace registry {
+
+/// @class ChangeDispatcher
+/// Background thread delivering the change notifications of a registry tree
+/// by calling Registry::DispatchChanges() periodically. Subscription
+/// callbacks run on this thread
+class ChangeDispatcher {
+ public:
+  /// Starts the dispatch thread
+  /// @param[in] registry any registry of the tree, must outlive the dispatcher
+  /// @param[in] period time between two dispatches
+  ChangeDispatcher(Registry* registry, std::chrono::microseconds period);
+
+  /// Stops the thread once it has delivered the pending changes
+  ~ChangeDispatcher();
+
+  ChangeDispatcher(const ChangeDispatcher&) = delete;
+  ChangeDispatcher& operator=(const ChangeDispatcher&) = delete;
+
+ private:
+  void Run();
+
+  Registry* const registry_;
+  const std::chrono::microseconds period_;
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_;
+  std::thread thread_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_CHANGE_DISPATCHER_H_
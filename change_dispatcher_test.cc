@@ -0,0 +1,42 @@
+#include "registry/change_dispatcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+TEST(ChangeDispatcherTest, DeliversOnItsThread) {
+  Registry registry("registry");
+  Registry::Int32* value = registry.AddInt32("value").ValueOrDie();
+  std::atomic<int32_t> delivered(0);
+  std::atomic<bool> other_thread(false);
+  const std::thread::id test_thread = std::this_thread::get_id();
+  registry.SubscribeSubtree(
+      [&](const std::vector<Registry::Element*>& changed) {
+        int32_t current = 0;
+        changed[0]->Extract(&current);
+        delivered = current;
+        other_thread = std::this_thread::get_id() != test_thread;
+      });
+
+  {
+    ChangeDispatcher dispatcher(&registry, std::chrono::milliseconds(1));
+    *value = 1;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (delivered != 1 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(delivered, 1);
+    EXPECT_TRUE(other_thread);
+
+    // Pending changes are delivered when the dispatcher stops
+    *value = 2;
+  }
+  EXPECT_EQ(delivered, 2);
+}
+
+}  // namespace registry
@@ -0,0 +1,262 @@
+#ifndef REGISTRY_CONCURRENT_CONTAINERS_H_
+#define REGISTRY_CONCURRENT_CONTAINERS_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace registry {
+
+namespace internal {
+
+// Reads eight characters as a little endian word. Compilers do not reliably
+// merge the byte loop into a single load, so memcpy is used outside of
+// constant evaluation
+constexpr uint64_t LoadWord(const char* data) {
+  uint64_t word = 0;
+  if (!__builtin_is_constant_evaluated()) {
+    std::memcpy(&word, data, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+  }
+  for (std::size_t byte = 0; byte < 8; ++byte) {
+    word |= uint64_t{static_cast<unsigned char>(data[byte])} << (8 * byte);
+  }
+  return word;
+}
+
+/// 64 bit hash of a name, consuming it eight characters at a time. Being
+/// constexpr, hashes of names known at compile time can be computed once and
+/// reused for every lookup
+constexpr uint64_t HashName(std::string_view name) {
+  constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+  uint64_t hash = name.size() * kMultiplier;
+  std::size_t index = 0;
+  for (; index + 8 <= name.size(); index += 8) {
+    hash = (hash ^ LoadWord(name.data() + index)) * kMultiplier;
+    hash ^= hash >> 29;
+  }
+  uint64_t tail = 0;
+  for (std::size_t byte = 0; index < name.size(); ++index, ++byte) {
+    tail |= uint64_t{static_cast<unsigned char>(name[index])} << (8 * byte);
+  }
+  hash = (hash ^ tail) * kMultiplier;
+  return hash ^ (hash >> 32);
+}
+
+/// @class ConcurrentNameMap
+/// Insert-only open addressing hash map from names to non-owning pointers.
+/// The key of a value is not stored, it is obtained from the value itself
+/// through KeyOf, so keys stay valid for as long as the values do.
+///
+/// Find() and ForEach() are lock-free and may run concurrently with Insert():
+/// they never block and always observe a consistent table. Calls to Insert()
+/// and Reserve() must be serialised by the caller. Tables replaced while
+/// growing are retired rather than freed, so that concurrent readers can keep
+/// using them; they are released together with the map
+template <typename T, typename KeyOf>
+class ConcurrentNameMap {
+ public:
+  ConcurrentNameMap() : size_(0) { Publish(kMinCapacity); }
+
+  ConcurrentNameMap(const ConcurrentNameMap&) = delete;
+  ConcurrentNameMap& operator=(const ConcurrentNameMap&) = delete;
+
+  T* Find(std::string_view key) const { return Find(key, HashName(key)); }
+
+  /// Looks up a key whose hash, as returned by HashName(), is already known
+  T* Find(std::string_view key, uint64_t hash) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (std::size_t index = hash & table->mask;;
+         index = (index + 1) & table->mask) {
+      const Slot& slot = table->slots[index];
+      T* value = slot.value.load(std::memory_order_acquire);
+      if (value == nullptr) {
+        return nullptr;
+      }
+      if (slot.hash == hash && KeyOf()(*value) == key) {
+        return value;
+      }
+    }
+  }
+
+  /// Inserts value under the key returned by KeyOf, unless the key is in use
+  /// @return the value stored under the key and whether it was inserted
+  std::pair<T*, bool> Insert(T* value) {
+    const std::string_view key = KeyOf()(*value);
+    const uint64_t hash = HashName(key);
+    if (T* existing = Find(key, hash)) {
+      return std::make_pair(existing, false);
+    }
+    Reserve(size_.load(std::memory_order_relaxed) + 1);
+    Place(table_.load(std::memory_order_relaxed), hash, value);
+    size_.fetch_add(1, std::memory_order_release);
+    return std::make_pair(value, true);
+  }
+
+  /// Grows the table so that it can hold count values without growing again
+  void Reserve(std::size_t count) {
+    const Table* table = table_.load(std::memory_order_relaxed);
+    std::size_t capacity = table->mask + 1;
+    while (count * 2 > capacity) {
+      capacity *= 2;
+    }
+    if (capacity == table->mask + 1) {
+      return;
+    }
+    Table* grown = Publish(capacity);
+    for (std::size_t index = 0; index <= table->mask; ++index) {
+      const Slot& slot = table->slots[index];
+      if (T* value = slot.value.load(std::memory_order_relaxed)) {
+        Place(grown, slot.hash, value);
+      }
+    }
+    table_.store(grown, std::memory_order_release);
+  }
+
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  /// Calls function with every value of the map, in no particular order
+  template <typename Function>
+  void ForEach(Function function) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (std::size_t index = 0; index <= table->mask; ++index) {
+      T* value = table->slots[index].value.load(std::memory_order_acquire);
+      if (value != nullptr) {
+        function(*value);
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kMinCapacity = 8;
+
+  struct Slot {
+    uint64_t hash = 0;
+    std::atomic<T*> value{nullptr};
+  };
+
+  struct Table {
+    explicit Table(std::size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]) {}
+
+    const std::size_t mask;
+    const std::unique_ptr<Slot[]> slots;
+  };
+
+  // Allocates a table of the given capacity, only publishing it straight
+  // away when the map does not have one yet
+  Table* Publish(std::size_t capacity) {
+    tables_.push_back(std::make_unique<Table>(capacity));
+    if (tables_.size() == 1) {
+      table_.store(tables_.back().get(), std::memory_order_release);
+    }
+    return tables_.back().get();
+  }
+
+  // The hash is written before the value is released, readers only look at
+  // the hash of slots whose value they acquired
+  static void Place(Table* table, uint64_t hash, T* value) {
+    std::size_t index = hash & table->mask;
+    while (table->slots[index].value.load(std::memory_order_relaxed) !=
+           nullptr) {
+      index = (index + 1) & table->mask;
+    }
+    table->slots[index].hash = hash;
+    table->slots[index].value.store(value, std::memory_order_release);
+  }
+
+  std::atomic<Table*> table_;
+  std::atomic<std::size_t> size_;
+  std::vector<std::unique_ptr<Table>> tables_;
+};
+
+/// @class ConcurrentTable
+/// Append-only array whose storage never moves. Storage is allocated in
+/// segments of doubling size, so an index is resolved with two loads and
+/// reads may run concurrently with PushBack(). Calls to PushBack() must be
+/// serialised by the caller, and an index may only be read once the value
+/// stored at it has been published to the reading thread
+template <typename T>
+class ConcurrentTable {
+ public:
+  ConcurrentTable() : size_(0) {}
+
+  ConcurrentTable(const ConcurrentTable&) = delete;
+  ConcurrentTable& operator=(const ConcurrentTable&) = delete;
+
+  const T& operator[](std::size_t index) const {
+    const Location location = Locate(index);
+    return segments_[location.segment].load(
+        std::memory_order_acquire)[location.offset];
+  }
+
+  /// @return index of the appended value
+  std::size_t PushBack(const T& value) {
+    const std::size_t index = size_.load(std::memory_order_relaxed);
+    const Location location = Locate(index);
+    if (location.offset == 0) {
+      owned_segments_.emplace_back(
+          new T[kFirstSegmentSize << location.segment]);
+      segments_[location.segment].store(owned_segments_.back().get(),
+                                        std::memory_order_release);
+    }
+    segments_[location.segment].load(
+        std::memory_order_relaxed)[location.offset] = value;
+    size_.store(index + 1, std::memory_order_release);
+    return index;
+  }
+
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  /// Calls function with every value published so far, in index order. Walks
+  /// the segments directly rather than resolving every index
+  template <typename Function>
+  void ForEach(Function function) const {
+    std::size_t remaining = size();
+    for (std::size_t segment = 0; remaining != 0; ++segment) {
+      const T* values = segments_[segment].load(std::memory_order_acquire);
+      const std::size_t count =
+          std::min(remaining, kFirstSegmentSize << segment);
+      for (std::size_t offset = 0; offset < count; ++offset) {
+        function(values[offset]);
+      }
+      remaining -= count;
+    }
+  }
+
+ private:
+  static constexpr std::size_t kFirstSegmentBits = 6;
+  static constexpr std::size_t kFirstSegmentSize = 1 << kFirstSegmentBits;
+  static constexpr std::size_t kMaxSegments = 48;
+
+  struct Location {
+    std::size_t segment;
+    std::size_t offset;
+  };
+
+  // Segment k holds indices [64 * (2^k - 1), 64 * (2^(k + 1) - 1))
+  static Location Locate(std::size_t index) {
+    const uint64_t biased = index + kFirstSegmentSize;
+    const std::size_t bit = 63 - __builtin_clzll(biased);
+    return Location{bit - kFirstSegmentBits, biased - (uint64_t{1} << bit)};
+  }
+
+  std::array<std::atomic<T*>, kMaxSegments> segments_{};
+  std::atomic<std::size_t> size_;
+  std::vector<std::unique_ptr<T[]>> owned_segments_;
+};
+
+}  // namespace internal
+
+}  // namespace registry
+
+#endif  // REGISTRY_CONCURRENT_CONTAINERS_H_
@@ -0,0 +1,140 @@
+#include "registry/concurrent_containers.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+namespace internal {
+
+namespace {
+
+struct Named {
+  explicit Named(const std::string& name) : name(name) {}
+
+  std::string name;
+};
+
+struct NameOf {
+  std::string_view operator()(const Named& named) const { return named.name; }
+};
+
+using NamedMap = ConcurrentNameMap<Named, NameOf>;
+
+std::vector<std::unique_ptr<Named>> MakeNamed(int count) {
+  std::vector<std::unique_ptr<Named>> values;
+  for (int index = 0; index < count; ++index) {
+    values.push_back(std::make_unique<Named>("name" + std::to_string(index)));
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(ConcurrentContainersTest, HashNameTest) {
+  constexpr uint64_t kHash = HashName("robot.arm.joint3.torque");
+  EXPECT_EQ(HashName(std::string("robot.arm.joint3.torque")), kHash);
+  EXPECT_NE(HashName("joint1"), HashName("joint2"));
+  EXPECT_NE(HashName("a"), HashName(std::string_view("a\0", 2)));
+  EXPECT_NE(HashName(""), HashName(std::string_view("\0", 1)));
+}
+
+TEST(ConcurrentContainersTest, NameMapInsertFindTest) {
+  NamedMap map;
+  std::vector<std::unique_ptr<Named>> values = MakeNamed(1000);
+  for (const std::unique_ptr<Named>& value : values) {
+    std::pair<Named*, bool> result = map.Insert(value.get());
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(result.first, value.get());
+  }
+  EXPECT_EQ(map.size(), 1000);
+
+  Named duplicate("name10");
+  std::pair<Named*, bool> result = map.Insert(&duplicate);
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(result.first, values[10].get());
+
+  for (const std::unique_ptr<Named>& value : values) {
+    EXPECT_EQ(map.Find(value->name), value.get());
+  }
+  EXPECT_EQ(map.Find("name1000"), nullptr);
+  EXPECT_EQ(map.Find(""), nullptr);
+
+  int visited = 0;
+  map.ForEach([&visited](const Named&) { ++visited; });
+  EXPECT_EQ(visited, 1000);
+}
+
+TEST(ConcurrentContainersTest, NameMapReserveTest) {
+  NamedMap map;
+  map.Reserve(100);
+  std::vector<std::unique_ptr<Named>> values = MakeNamed(100);
+  for (const std::unique_ptr<Named>& value : values) {
+    map.Insert(value.get());
+  }
+  for (const std::unique_ptr<Named>& value : values) {
+    EXPECT_EQ(map.Find(value->name, HashName(value->name)), value.get());
+  }
+}
+
+TEST(ConcurrentContainersTest, NameMapConcurrentReadTest) {
+  NamedMap map;
+  std::vector<std::unique_ptr<Named>> values = MakeNamed(20000);
+  std::atomic<int> inserted(0);
+  std::atomic<bool> failed(false);
+
+  std::vector<std::thread> readers;
+  for (int reader = 0; reader < 4; ++reader) {
+    readers.emplace_back([&]() {
+      while (inserted < 20000) {
+        // Everything inserted before the counter was read must be found
+        const int count = inserted;
+        for (int index = count - 1; index >= 0 && index > count - 100;
+             --index) {
+          if (map.Find(values[index]->name) != values[index].get()) {
+            failed = true;
+          }
+        }
+      }
+    });
+  }
+  for (const std::unique_ptr<Named>& value : values) {
+    map.Insert(value.get());
+    ++inserted;
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_FALSE(failed);
+}
+
+TEST(ConcurrentContainersTest, TablePushBackTest) {
+  ConcurrentTable<int> table;
+  for (int index = 0; index < 10000; ++index) {
+    EXPECT_EQ(table.PushBack(index * 2), index);
+  }
+  EXPECT_EQ(table.size(), 10000);
+  for (int index = 0; index < 10000; ++index) {
+    ASSERT_EQ(table[index], index * 2);
+  }
+}
+
+TEST(ConcurrentContainersTest, TableForEachTest) {
+  ConcurrentTable<int> table;
+  int visited = 0;
+  table.ForEach([&visited](int) { ++visited; });
+  EXPECT_EQ(visited, 0);
+  // Ends partway through the third segment
+  for (int index = 0; index < 300; ++index) {
+    table.PushBack(index);
+  }
+  table.ForEach([&visited](int value) { EXPECT_EQ(value, visited++); });
+  EXPECT_EQ(visited, 300);
+}
+
+}  // namespace internal
+}  // namespace registry
@@ -0,0 +1,481 @@
+#include "registry/config_loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace registry {
+
+namespace internal {
+
+/// Parses and adds the elements of one type. Values are parsed into raw
+/// bytes and assigned through AssignBytes(), strings excepted
+struct ConfigValueKind {
+  using Add = common::ErrorOr<Registry::Element*> (*)(
+      Registry*, const std::string& name);
+  using AddArray = common::ErrorOr<Registry::Element*> (*)(
+      Registry*, const std::string& name, std::size_t extent);
+
+  std::string_view name;
+  TypeEnum type;
+  // Size of a value, 0 for strings
+  std::size_t size;
+  // Parses a single value into size bytes
+  bool (*parse)(std::string_view text, char* value);
+  Add add;
+  // nullptr for strings
+  AddArray add_array;
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::ConfigValueKind;
+
+bool IsSpace(char character) {
+  return character == ' ' || character == '\t' || character == '\r';
+}
+
+std::string_view TrimLeft(std::string_view text) {
+  std::size_t begin = 0;
+  while (begin < text.size() && IsSpace(text[begin])) {
+    ++begin;
+  }
+  return text.substr(begin);
+}
+
+std::string_view Trim(std::string_view text) {
+  text = TrimLeft(text);
+  std::size_t end = text.size();
+  while (end > 0 && IsSpace(text[end - 1])) {
+    --end;
+  }
+  return text.substr(0, end);
+}
+
+// Splits the leading token, up to whitespace or stop, off text
+std::string_view NextToken(std::string_view* text, char stop = ' ') {
+  std::size_t end = 0;
+  while (end < text->size() && (*text)[end] != stop &&
+         !IsSpace((*text)[end])) {
+    ++end;
+  }
+  const std::string_view token = text->substr(0, end);
+  *text = TrimLeft(text->substr(end));
+  return token;
+}
+
+// Paths are made of non-empty names free of reserved characters, which
+// would otherwise be silently removed from the names of the elements
+bool IsValidPath(std::string_view path) {
+  if (path.empty() || path.front() == internal::kNamespaceCharacter ||
+      path.back() == internal::kNamespaceCharacter) {
+    return false;
+  }
+  char previous = '\0';
+  for (const char character : path) {
+    if (character == internal::kNamespaceCharacter) {
+      if (previous == internal::kNamespaceCharacter) {
+        return false;
+      }
+    } else if (internal::kReservedCharacterTable[static_cast<unsigned char>(
+                   character)]) {
+      return false;
+    }
+    previous = character;
+  }
+  return true;
+}
+
+// @return dotted path of the registry holding the element at path
+std::string_view ParentPath(std::string_view path) {
+  const std::size_t separator = path.rfind(internal::kNamespaceCharacter);
+  return separator == std::string_view::npos ? std::string_view()
+                                             : path.substr(0, separator);
+}
+
+template <typename T>
+bool ParseValue(std::string_view text, char* value) {
+  T parsed;
+  if constexpr (std::is_same<T, bool>::value) {
+    if (text == "true" || text == "1") {
+      parsed = true;
+    } else if (text == "false" || text == "0") {
+      parsed = false;
+    } else {
+      return false;
+    }
+  } else if constexpr (std::is_same<T, char>::value) {
+    if (text.size() != 1) {
+      return false;
+    }
+    parsed = text[0];
+  } else {
+    const char* end = text.data() + text.size();
+    const std::from_chars_result result =
+        std::from_chars(text.data(), end, parsed);
+    if (result.ec != std::errc() || result.ptr != end) {
+      return false;
+    }
+  }
+  std::memcpy(value, &parsed, sizeof(T));
+  return true;
+}
+
+// Unquotes a string value, unescaping it
+bool ParseString(std::string_view text, std::string* value) {
+  if (text.empty() || text.front() != '"') {
+    value->assign(text);
+    return true;
+  }
+  if (text.size() < 2 || text.back() != '"') {
+    return false;
+  }
+  text = text.substr(1, text.size() - 2);
+  value->clear();
+  value->reserve(text.size());
+  for (std::size_t index = 0; index < text.size(); ++index) {
+    char character = text[index];
+    if (character == '"') {
+      return false;
+    }
+    if (character == '\\') {
+      if (++index == text.size()) {
+        return false;
+      }
+      switch (text[index]) {
+        case 'n':
+          character = '\n';
+          break;
+        case 't':
+          character = '\t';
+          break;
+        case '"':
+        case '\\':
+          character = text[index];
+          break;
+        default:
+          return false;
+      }
+    }
+    value->push_back(character);
+  }
+  return true;
+}
+
+template <typename ElementType>
+common::ErrorOr<Registry::Element*> Added(
+    const common::ErrorOr<ElementType*>& element) {
+  if (!element.HasValue()) {
+    return element.ErrorOrDie();
+  }
+  return static_cast<Registry::Element*>(element.ValueOrDie());
+}
+
+template <typename T>
+common::ErrorOr<Registry::Element*> AddArray(Registry* registry,
+                                             const std::string& name,
+                                             std::size_t extent) {
+  return Added(registry->AddArray<T>(name, extent));
+}
+
+template <typename T>
+constexpr ConfigValueKind Kind(std::string_view name,
+                               ConfigValueKind::Add add) {
+  return ConfigValueKind{name,           TypeTrait<T>::type, sizeof(T),
+                         &ParseValue<T>, add,                &AddArray<T>};
+}
+
+const ConfigValueKind kKinds[] = {
+    Kind<int32_t>("int32",
+                  [](Registry* registry, const std::string& name) {
+                    return Added(registry->AddInt32(name));
+                  }),
+    Kind<uint32_t>("uint32",
+                   [](Registry* registry, const std::string& name) {
+                     return Added(registry->AddUnsignedInt32(name));
+                   }),
+    Kind<int64_t>("int64",
+                  [](Registry* registry, const std::string& name) {
+                    return Added(registry->AddInt64(name));
+                  }),
+    Kind<uint64_t>("uint64",
+                   [](Registry* registry, const std::string& name) {
+                     return Added(registry->AddUnsignedInt64(name));
+                   }),
+    Kind<bool>("bool",
+               [](Registry* registry, const std::string& name) {
+                 return Added(registry->AddBoolean(name));
+               }),
+    Kind<char>("char",
+               [](Registry* registry, const std::string& name) {
+                 return Added(registry->AddChar(
+                     name, TypeTrait<char>::default_value));
+               }),
+    Kind<float>("float",
+                [](Registry* registry, const std::string& name) {
+                  return Added(registry->AddFloat(name));
+                }),
+    Kind<double>("double",
+                 [](Registry* registry, const std::string& name) {
+                   return Added(registry->AddDouble(name));
+                 }),
+    ConfigValueKind{"string", TypeTrait<std::string>::type, 0, nullptr,
+                    [](Registry* registry, const std::string& name) {
+                      return Added(registry->AddString(
+                          name, TypeTrait<std::string>::default_value));
+                    },
+                    nullptr},
+};
+
+const ConfigValueKind* FindKind(std::string_view name) {
+  for (const ConfigValueKind& kind : kKinds) {
+    if (kind.name == name) {
+      return &kind;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+ConfigLoader::ConfigLoader(Registry* registry, ThreadPool* pool)
+    : registry_(registry), pool_(pool), error_line_(0) {}
+
+common::ErrorOr<std::size_t> ConfigLoader::LoadFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return common::Error::kNotFound;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    return common::Error::kNotFound;
+  }
+  const std::size_t size = status.st_size;
+  if (size == 0) {
+    close(fd);
+    return Load(std::string_view());
+  }
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return common::Error::kNotFound;
+  }
+  // The whole file is read front to back by the parsing threads. Advice
+  // values are not flags and are given one call each
+  madvise(memory, size, MADV_SEQUENTIAL);
+  madvise(memory, size, MADV_WILLNEED);
+  common::ErrorOr<std::size_t> loaded =
+      Load(std::string_view(static_cast<const char*>(memory), size));
+  munmap(memory, size);
+  return loaded;
+}
+
+common::ErrorOr<std::size_t> ConfigLoader::Load(std::string_view text) {
+  error_line_ = 0;
+  // Chunks end on line boundaries, a few per thread so that threads reaching
+  // denser runs of entries are relieved by the others
+  std::size_t chunk_count = 1;
+  if (pool_ != nullptr) {
+    chunk_count = std::max<std::size_t>(
+        1, std::min(pool_->size() * 4, text.size() / kMinChunkSize));
+  }
+  std::vector<Chunk> chunks(chunk_count);
+  std::size_t begin = 0;
+  for (std::size_t index = 0; index < chunk_count; ++index) {
+    std::size_t end = text.size() * (index + 1) / chunk_count;
+    if (end < text.size()) {
+      end = std::max(begin, end);
+      const std::size_t newline = text.find('\n', end);
+      end = newline == std::string_view::npos ? text.size() : newline + 1;
+    }
+    chunks[index].text = text.substr(begin, end - begin);
+    begin = end;
+  }
+  if (pool_ != nullptr) {
+    pool_->ParallelFor(chunk_count,
+                       [&chunks](std::size_t index) { Parse(&chunks[index]); });
+  } else {
+    Parse(&chunks[0]);
+  }
+
+  std::size_t first_line = 1;
+  for (const Chunk& chunk : chunks) {
+    if (chunk.error_line != 0) {
+      error_line_ = first_line + chunk.error_line - 1;
+      return common::Error::kUnavailable;
+    }
+    first_line += chunk.line_count;
+  }
+  return Insert(chunks);
+}
+
+void ConfigLoader::Parse(Chunk* chunk) {
+  std::string_view text = chunk->text;
+  while (!text.empty()) {
+    const std::size_t newline = text.find('\n');
+    const std::string_view line = text.substr(0, newline);
+    text = newline == std::string_view::npos ? std::string_view()
+                                             : text.substr(newline + 1);
+    if (!ParseLine(line, chunk)) {
+      chunk->error_line = chunk->line_count + 1;
+      return;
+    }
+    ++chunk->line_count;
+  }
+}
+
+bool ConfigLoader::ParseLine(std::string_view line, Chunk* chunk) {
+  line = TrimLeft(line);
+  if (line.empty() || line.front() == '#') {
+    return true;
+  }
+  std::string_view type = NextToken(&line);
+  std::size_t extent = 0;
+  const std::size_t bracket = type.find('[');
+  if (bracket != std::string_view::npos) {
+    const std::string_view size =
+        type.substr(bracket + 1, type.size() - bracket - 2);
+    if (type.back() != ']' ||
+        std::from_chars(size.data(), size.data() + size.size(), extent).ptr !=
+            size.data() + size.size() ||
+        extent == 0 || size.empty()) {
+      return false;
+    }
+    type = type.substr(0, bracket);
+  }
+  const ConfigValueKind* kind = FindKind(type);
+  const std::string_view path = NextToken(&line, '=');
+  if (kind == nullptr || (extent != 0 && kind->size == 0) ||
+      !IsValidPath(path) || line.empty() || line.front() != '=') {
+    return false;
+  }
+  const std::string_view value = Trim(line.substr(1));
+  // Every value of an array takes at least one character, which bounds the
+  // words reserved for the array by the length of the line
+  if (extent > value.size() || extent > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  Entry entry{kind, path, static_cast<uint32_t>(extent),
+              static_cast<uint32_t>(chunk->line_count), 0};
+  if (kind->size == 0) {
+    entry.value = chunk->strings.size();
+    chunk->strings.emplace_back();
+    if (!ParseString(value, &chunk->strings.back())) {
+      return false;
+    }
+    chunk->entries.push_back(entry);
+    return true;
+  }
+  const std::size_t count = extent != 0 ? extent : 1;
+  entry.value = chunk->words.size();
+  chunk->words.resize(entry.value + (count * kind->size + 7) / 8);
+  char* bytes = reinterpret_cast<char*>(chunk->words.data() + entry.value);
+  std::string_view values = value;
+  for (std::size_t index = 0; index < count; ++index) {
+    const std::string_view token =
+        extent != 0 ? NextToken(&values) : std::exchange(values, {});
+    if (token.empty() || !kind->parse(token, bytes + index * kind->size)) {
+      return false;
+    }
+  }
+  if (!values.empty()) {
+    return false;
+  }
+  chunk->entries.push_back(entry);
+  return true;
+}
+
+common::ErrorOr<std::size_t> ConfigLoader::Insert(
+    const std::vector<Chunk>& chunks) {
+  std::size_t entry_count = 0;
+  for (const Chunk& chunk : chunks) {
+    entry_count += chunk.entries.size();
+  }
+  registry_->ReserveTree(entry_count);
+
+  std::size_t loaded = 0;
+  std::size_t first_line = 1;
+  bool resolved = false;
+  std::string_view parent_path;
+  Registry* parent = nullptr;
+  std::string name;
+  for (const Chunk& chunk : chunks) {
+    for (auto entry = chunk.entries.begin(); entry != chunk.entries.end();
+         ++entry) {
+      const std::string_view entry_parent = ParentPath(entry->path);
+      if (!resolved || entry_parent != parent_path) {
+        // Size the tables of the registry for the run of entries it receives
+        std::size_t run = 1;
+        for (auto next = entry + 1; next != chunk.entries.end() &&
+                                    ParentPath(next->path) == entry_parent;
+             ++next) {
+          ++run;
+        }
+        parent = ResolveRegistry(entry_parent);
+        parent->Reserve(0, run);
+        parent_path = entry_parent;
+        resolved = true;
+      }
+
+      name.assign(entry->path.substr(
+          entry_parent.empty() ? 0 : entry_parent.size() + 1));
+      Registry::Element* element = nullptr;
+      common::ErrorOr<Registry::Element*> existing = parent->FindElement(name);
+      if (existing.HasValue()) {
+        element = existing.ValueOrDie();
+        if (element->type() != entry->kind->type ||
+            element->extent() != entry->extent) {
+          error_line_ = first_line + entry->line;
+          return common::Error::kUnavailable;
+        }
+      } else {
+        common::ErrorOr<Registry::Element*> added =
+            entry->extent != 0
+                ? entry->kind->add_array(parent, name, entry->extent)
+                : entry->kind->add(parent, name);
+        if (!added.HasValue()) {
+          error_line_ = first_line + entry->line;
+          return common::Error::kUnavailable;
+        }
+        element = added.ValueOrDie();
+      }
+      if (entry->kind->size == 0) {
+        element->Assign(chunk.strings[entry->value]);
+      } else {
+        element->AssignBytes(chunk.words.data() + entry->value);
+      }
+      ++loaded;
+    }
+    first_line += chunk.line_count;
+  }
+  return loaded;
+}
+
+Registry* ConfigLoader::ResolveRegistry(std::string_view path) {
+  Registry* registry = registry_;
+  while (!path.empty()) {
+    const std::size_t separator = path.find(internal::kNamespaceCharacter);
+    const std::string_view name = path.substr(0, separator);
+    common::ErrorOr<Registry*> child = registry->FindChildRegistry(name);
+    registry = child.HasValue()
+                   ? child.ValueOrDie()
+                   : registry->FindOrAddChildRegistry(std::string(name));
+    path = separator == std::string_view::npos ? std::string_view()
+                                               : path.substr(separator + 1);
+  }
+  return registry;
+}
+
+}  // namespace registry
@@ -0,0 +1,117 @@
+#ifndef REGISTRY_CONFIG_LOADER_H_
+#define REGISTRY_CONFIG_LOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/error_or.h"
+#include "registry/registry.h"
+#include "registry/thread_pool.h"
+
+namespace registry {
+
+namespace internal {
+
+struct ConfigValueKind;
+
+}  // namespace internal
+
+/// @class ConfigLoader
+/// Loads elements and their values from text holding one entry per line:
+///
+///   # Comments and blank lines are skipped
+///   double arm.joint1.gain = 1.5
+///   string arm.label = "left arm"
+///   double[3] arm.limits = -1.5 0 1.5
+///
+/// An entry gives the type of the element, its dotted path relative to the
+/// registry and its value. Types are int32, uint32, int64, uint64, bool,
+/// char, float, double and string. Arrays of any of them but string are
+/// written type[size], with their values separated by spaces. Booleans are
+/// true, false, 1 or 0. Strings are the rest of the line, or are quoted, in
+/// which case \", \\, \n and \t are unescaped.
+///
+/// The text is cut into runs of lines parsed concurrently. Entries are then
+/// added in order, so that handles follow the text, with the tables of every
+/// registry sized up front for the run of entries it receives. Elements
+/// already present are assigned the value of their entry
+class ConfigLoader {
+ public:
+  /// @param[in] registry registry the paths are relative to. Must outlive the
+  /// loader
+  /// @param[in] pool threads parsing the text, nullptr to parse it on the
+  /// calling thread
+  ConfigLoader(Registry* registry, ThreadPool* pool);
+
+  ConfigLoader(const ConfigLoader&) = delete;
+  ConfigLoader& operator=(const ConfigLoader&) = delete;
+
+  /// Memory maps a file and loads it, see Load()
+  /// @param[in] path path of the file
+  /// @return number of elements loaded, else kNotFound if the file cannot be
+  /// opened and mapped, or an error of Load()
+  common::ErrorOr<std::size_t> LoadFile(const std::string& path);
+
+  /// Parses every entry of text, then adds and assigns the elements. Nothing
+  /// is added when an entry is malformed, whereas entries preceding one that
+  /// conflicts with an existing element stay loaded
+  /// @param[in] text entries
+  /// @return number of elements loaded, else kUnavailable if an entry is
+  /// malformed or conflicts with the type of an existing element, see
+  /// error_line()
+  common::ErrorOr<std::size_t> Load(std::string_view text);
+
+  /// @return line, starting at 1, of the entry that failed the last load, 0
+  /// if it succeeded
+  std::size_t error_line() const { return error_line_; }
+
+ private:
+  // Smallest run of text parsed by one task
+  static constexpr std::size_t kMinChunkSize = 64 * 1024;
+
+  struct Entry {
+    const internal::ConfigValueKind* kind;
+    std::string_view path;
+    // Number of values of arrays, 0 otherwise
+    uint32_t extent;
+    // Line within the chunk, starting at 0
+    uint32_t line;
+    // Offset of the value within the words of the chunk, index within its
+    // strings for strings
+    std::size_t value;
+  };
+
+  // Entries parsed from a run of whole lines of the text
+  struct Chunk {
+    std::string_view text;
+    std::vector<Entry> entries;
+    // Values are stored at word boundaries, so that they are aligned
+    std::vector<uint64_t> words;
+    std::vector<std::string> strings;
+    std::size_t line_count = 0;
+    // Line of the first malformed entry within the chunk, starting at 1
+    std::size_t error_line = 0;
+  };
+
+  static void Parse(Chunk* chunk);
+
+  // @return false if line is neither an entry, a comment nor blank
+  static bool ParseLine(std::string_view line, Chunk* chunk);
+
+  // Adds and assigns the elements of every chunk, in order
+  common::ErrorOr<std::size_t> Insert(const std::vector<Chunk>& chunks);
+
+  // @return registry at a dotted path relative to registry_, added if needed
+  Registry* ResolveRegistry(std::string_view path);
+
+  Registry* const registry_;
+  ThreadPool* const pool_;
+  std::size_t error_line_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_CONFIG_LOADER_H_
@@ -0,0 +1,147 @@
+#include "registry/config_loader.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+class ConfigLoaderTest : public ::testing::Test {
+ public:
+  ConfigLoaderTest()
+      : path_(::testing::TempDir() + "config_loader_test_" +
+              std::to_string(getpid())),
+        registry_("robot") {}
+  ~ConfigLoaderTest() override { std::remove(path_.c_str()); }
+
+ protected:
+  void WriteFile(const std::string& text) {
+    FILE* file = std::fopen(path_.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+  }
+
+  const std::string path_;
+  Registry registry_;
+};
+
+TEST_F(ConfigLoaderTest, LoadsEveryType) {
+  ConfigLoader loader(&registry_, nullptr);
+  common::ErrorOr<std::size_t> loaded = loader.Load(
+      "# Arm parameters\n"
+      "\n"
+      "int32 arm.mode = -3\n"
+      "uint32 arm.id = 7\n"
+      "int64 arm.ticks = -10000000000\n"
+      "uint64 arm.count = 18446744073709551615\n"
+      "  bool arm.enabled = true\n"
+      "char arm.axis = z\n"
+      "float arm.joint1.gain = 0.5\n"
+      "double arm.joint1.offset=-1.25\r\n"
+      "string arm.name = left arm  \n"
+      "string arm.quoted = \"say \\\"hi\\\"\\n\"\n"
+      "double[3] arm.limits = -1.5 0 1.5\n"
+      "bool[2] arm.flags = 0 1\n"
+      "double rate = 100");
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 13u);
+  EXPECT_EQ(loader.error_line(), 0u);
+
+  Registry* arm = registry_.FindChildRegistry("arm").ValueOrDie();
+  EXPECT_EQ(arm->FindInt32("mode").ValueOrDie()->value(), -3);
+  EXPECT_EQ(arm->FindUnsignedInt32("id").ValueOrDie()->value(), 7u);
+  EXPECT_EQ(arm->FindInt64("ticks").ValueOrDie()->value(), -10000000000);
+  EXPECT_EQ(arm->FindUnsignedInt64("count").ValueOrDie()->value(),
+            18446744073709551615ull);
+  EXPECT_TRUE(arm->FindBoolean("enabled").ValueOrDie()->value());
+  EXPECT_EQ(arm->FindChar("axis").ValueOrDie()->value(), 'z');
+  EXPECT_EQ(registry_.FindElementByExtendedName("arm.joint1.gain")
+                .ValueOrDie()
+                ->FullName(),
+            "robot.arm.joint1.gain");
+  Registry* joint = arm->FindChildRegistry("joint1").ValueOrDie();
+  EXPECT_EQ(joint->FindFloat("gain").ValueOrDie()->value(), 0.5f);
+  EXPECT_EQ(joint->FindDouble("offset").ValueOrDie()->value(), -1.25);
+  EXPECT_EQ(arm->FindString("name").ValueOrDie()->value(), "left arm");
+  EXPECT_EQ(arm->FindString("quoted").ValueOrDie()->value(), "say \"hi\"\n");
+  Registry::DoubleArray* limits = arm->FindDoubleArray("limits").ValueOrDie();
+  EXPECT_EQ((*limits)[0], -1.5);
+  EXPECT_EQ((*limits)[2], 1.5);
+  EXPECT_TRUE((*arm->FindArray<bool>("flags").ValueOrDie())[1]);
+  EXPECT_EQ(registry_.FindDouble("rate").ValueOrDie()->value(), 100.0);
+
+  // Handles follow the order of the entries
+  EXPECT_EQ(arm->FindInt32("mode").ValueOrDie()->handle().id(), 0u);
+  EXPECT_EQ(registry_.FindDouble("rate").ValueOrDie()->handle().id(), 12u);
+}
+
+TEST_F(ConfigLoaderTest, AssignsExistingElements) {
+  Registry::Double* gain =
+      registry_.FindOrAddChildRegistry("arm")->AddDouble("gain").ValueOrDie();
+  ConfigLoader loader(&registry_, nullptr);
+  ASSERT_TRUE(loader.Load("double arm.gain = 2").HasValue());
+  EXPECT_EQ(gain->value(), 2.0);
+
+  // Conflicting types are reported with their line
+  EXPECT_FALSE(loader.Load("double arm.other = 1\nint32 arm.gain = 2\n")
+                   .HasValue());
+  EXPECT_EQ(loader.error_line(), 2u);
+  EXPECT_EQ(gain->value(), 2.0);
+}
+
+TEST_F(ConfigLoaderTest, RejectsMalformedEntries) {
+  ConfigLoader loader(&registry_, nullptr);
+  for (const char* text :
+       {"double gain 1.5", "real gain = 1.5", "double gain = one",
+        "double gain = 1.5 2.5", "int32 count = 3000000000", "bool on = yes",
+        "char axis = xy", "double arm..gain = 1", "double .gain = 1",
+        "double arm$.gain = 1", "double[0] gains = ", "double[2] gains = 1",
+        "double[2] gains = 1 2 3", "double[100000000000] gains = 1",
+        "double[4294967296] gains = 1", "string[2] names = a b",
+        "string name = \"open", "string name = \"bad\\q\""}) {
+    EXPECT_FALSE(loader.Load(std::string("# ok\n") + text).HasValue())
+        << text;
+    EXPECT_EQ(loader.error_line(), 2u) << text;
+  }
+  // Nothing is added from text holding a malformed entry
+  EXPECT_EQ(registry_.ElementCount(), 0u);
+}
+
+TEST_F(ConfigLoaderTest, LoadsLargeFilesInParallel) {
+  std::string text;
+  for (int child = 0; child < 200; ++child) {
+    for (int element = 0; element < 100; ++element) {
+      text += "double child" + std::to_string(child) + ".element" +
+              std::to_string(element) + " = " +
+              std::to_string(child * 100 + element) + "\n";
+    }
+  }
+  WriteFile(text);
+  ThreadPool pool(4);
+  ConfigLoader loader(&registry_, &pool);
+  common::ErrorOr<std::size_t> loaded = loader.LoadFile(path_);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 20000u);
+  for (int element = 0; element < 20000; element += 97) {
+    const std::string path = "robot.child" + std::to_string(element / 100) +
+                             ".element" + std::to_string(element % 100);
+    Registry::Element* found =
+        registry_.FindElementByFullName(path).ValueOrDie();
+    double value = 0.0;
+    ASSERT_TRUE(found->Extract(&value));
+    EXPECT_EQ(value, element);
+    EXPECT_EQ(found->handle().id(), static_cast<uint32_t>(element));
+  }
+
+  // Malformed lines are reported against the whole file
+  WriteFile(text + "double broken\n");
+  EXPECT_FALSE(loader.LoadFile(path_).HasValue());
+  EXPECT_EQ(loader.error_line(), 20001u);
+  EXPECT_FALSE(loader.LoadFile(path_ + "_missing").HasValue());
+}
+
+}  // namespace registry
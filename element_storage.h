@@ -0,0 +1,241 @@
+#ifndef REGISTRY_ELEMENT_STORAGE_H_
+#define REGISTRY_ELEMENT_STORAGE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "registry/arena.h"
+
+namespace registry {
+
+namespace internal {
+
+template <typename T, typename = void>
+struct IsLockFreeAtomic : std::false_type {};
+
+template <typename T>
+struct IsLockFreeAtomic<
+    T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+    : std::integral_constant<bool, std::atomic<T>::is_always_lock_free> {};
+
+/// @class AtomicStorage
+/// Value storage for types that fit in a lock-free std::atomic. Loads and
+/// stores compile down to plain moves on common architectures and are
+/// wait-free for both readers and writers.
+///
+/// The value normally lives inside the storage but may be relocated to
+/// external memory, such as a region shared with other processes. Lock-free
+/// atomics are address-free, so the relocated value may be accessed through
+/// any mapping of that memory
+template <typename T>
+class AtomicStorage {
+ public:
+  static constexpr bool kRelocatable = true;
+
+  explicit AtomicStorage(const T& value) : value_(value), location_(&value_) {}
+
+  T Load() const {
+    return location_.load(std::memory_order_acquire)
+        ->load(std::memory_order_acquire);
+  }
+  void LoadInto(T* value) const { *value = Load(); }
+  void Store(const T& value) {
+    location_.load(std::memory_order_acquire)
+        ->store(value, std::memory_order_release);
+  }
+
+  /// Moves the value to memory, or back inside the storage when memory is
+  /// nullptr. Stores racing with the move may be lost, loads are unaffected
+  /// @param[in] memory sizeof(T) bytes aligned for std::atomic<T>
+  void Relocate(void* memory) {
+    static_assert(sizeof(std::atomic<T>) == sizeof(T),
+                  "Relocated values must have the layout of their type");
+    const T value = Load();
+    std::atomic<T>* location = &value_;
+    if (memory != nullptr) {
+      location = new (memory) std::atomic<T>(value);
+    } else {
+      value_.store(value, std::memory_order_relaxed);
+    }
+    location_.store(location, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<T> value_;
+  std::atomic<std::atomic<T>*> location_;
+};
+
+/// @class LeftRight
+/// Synchronisation of the Left-Right algorithm of Ramalhete and Correia
+/// between two instances of a value. Readers are wait-free and always read
+/// an instance that no writer is touching, while writers are serialised and
+/// wait for readers to drain from an instance before overwriting it
+class LeftRight {
+ public:
+  LeftRight() : left_right_(0), version_index_(0), read_indicators_{{0}, {0}} {}
+
+  /// Calls read(instance) with the index of an instance safe to read
+  template <typename Function>
+  void Read(Function read) const {
+    const int version_index = version_index_.load();
+    read_indicators_[version_index].fetch_add(1);
+    read(left_right_.load());
+    read_indicators_[version_index].fetch_sub(1);
+  }
+
+  /// Calls write(instance) for both instances in turn, leaving them equal
+  /// when write makes the same change to both
+  template <typename Function>
+  void Write(Function write) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const int left_right = left_right_.load(std::memory_order_relaxed);
+    write(1 - left_right);
+    left_right_.store(1 - left_right);
+    // Once readers that may have seen the previous left_right_ are gone the
+    // old instance can be brought up to date
+    const int version_index = version_index_.load(std::memory_order_relaxed);
+    WaitForReaders(1 - version_index);
+    version_index_.store(1 - version_index);
+    WaitForReaders(version_index);
+    write(left_right);
+  }
+
+ private:
+  void WaitForReaders(int version_index) const {
+    while (read_indicators_[version_index].load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::atomic<int> left_right_;
+  std::atomic<int> version_index_;
+  mutable std::atomic<int> read_indicators_[2];
+  std::mutex writer_mutex_;
+};
+
+/// @class LeftRightStorage
+/// Value storage for types that cannot be updated atomically, such as
+/// std::string, keeping two copies of the value synchronised by LeftRight
+template <typename T>
+class LeftRightStorage {
+ public:
+  static constexpr bool kRelocatable = false;
+
+  explicit LeftRightStorage(const T& value) : instances_{value, value} {}
+
+  // The second instance takes over the storage of value
+  explicit LeftRightStorage(T&& value)
+      : instances_{value, std::move(value)} {}
+
+  T Load() const {
+    T value;
+    LoadInto(&value);
+    return value;
+  }
+
+  // Copy assigns into value, which lets callers reuse its storage
+  void LoadInto(T* value) const {
+    left_right_.Read(
+        [this, value](int instance) { *value = instances_[instance]; });
+  }
+
+  void Store(const T& value) {
+    left_right_.Write(
+        [this, &value](int instance) { instances_[instance] = value; });
+  }
+
+ private:
+  T instances_[2];
+  LeftRight left_right_;
+};
+
+/// @class LeftRightArrayStorage
+/// Storage for a fixed number of trivially copyable values updated together,
+/// such as the gains of every joint of an arm. Both copies of the values are
+/// contiguous and cache line aligned, and are read and written with memcpy
+/// under LeftRight, so that readers always see the values of a single write.
+/// Storage given an arena takes both copies from it
+template <typename T>
+class LeftRightArrayStorage {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Array values must be trivially copyable");
+
+ public:
+  static constexpr std::size_t kAlignment = 64;
+
+  /// @param[in] size number of values, all value initialised
+  /// @param[in] arena arena the values are allocated on, which then owns
+  /// them, nullptr to allocate them on the heap
+  LeftRightArrayStorage(std::size_t size, Arena* arena)
+      : size_(size),
+        stride_((size * sizeof(T) + kAlignment - 1) / kAlignment * kAlignment),
+        arena_owned_(arena != nullptr),
+        memory_(static_cast<char*>(
+            arena_owned_
+                ? arena->Allocate(std::max<std::size_t>(2 * stride_,
+                                                        kAlignment),
+                                  kAlignment)
+                : ::operator new(std::max<std::size_t>(2 * stride_, kAlignment),
+                                 std::align_val_t(kAlignment)))) {
+    for (int instance = 0; instance < 2; ++instance) {
+      std::uninitialized_value_construct_n(Instance(instance), size_);
+    }
+  }
+
+  ~LeftRightArrayStorage() {
+    if (!arena_owned_) {
+      ::operator delete(memory_, std::align_val_t(kAlignment));
+    }
+  }
+
+  LeftRightArrayStorage(const LeftRightArrayStorage&) = delete;
+  LeftRightArrayStorage& operator=(const LeftRightArrayStorage&) = delete;
+
+  std::size_t size() const { return size_; }
+
+  /// Copies count values starting at offset, which must lie within the array
+  void LoadInto(std::size_t offset, std::size_t count, T* values) const {
+    left_right_.Read([this, offset, count, values](int instance) {
+      std::memcpy(values, Instance(instance) + offset, count * sizeof(T));
+    });
+  }
+
+  /// Overwrites count values starting at offset, which must lie within the
+  /// array
+  void Store(std::size_t offset, std::size_t count, const T* values) {
+    left_right_.Write([this, offset, count, values](int instance) {
+      std::memcpy(Instance(instance) + offset, values, count * sizeof(T));
+    });
+  }
+
+ private:
+  T* Instance(int instance) const {
+    return reinterpret_cast<T*>(memory_ + instance * stride_);
+  }
+
+  const std::size_t size_;
+  // Bytes between the two instances
+  const std::size_t stride_;
+  const bool arena_owned_;
+  char* const memory_;
+  LeftRight left_right_;
+};
+
+template <typename T>
+using ElementStorage =
+    typename std::conditional<IsLockFreeAtomic<T>::value, AtomicStorage<T>,
+                              LeftRightStorage<T>>::type;
+
+}  // namespace internal
+
+}  // namespace registry
+
+#endif  // REGISTRY_ELEMENT_STORAGE_H_
@@ -0,0 +1,48 @@
+#include "registry/memory_barrier.h"
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace registry {
+
+namespace internal {
+
+namespace {
+
+#if defined(__linux__)
+int Membarrier(int command) {
+  return static_cast<int>(syscall(__NR_membarrier, command, 0));
+}
+
+bool EnableHeavyBarrier() {
+  const int commands = Membarrier(MEMBARRIER_CMD_QUERY);
+  return commands > 0 &&
+         (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0 &&
+         Membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+}
+#else
+bool EnableHeavyBarrier() { return false; }
+#endif
+
+}  // namespace
+
+std::atomic<bool> heavy_barrier_enabled(EnableHeavyBarrier());
+
+void HeavyBarrier() {
+  // Light barriers seeing heavy_barrier_enabled unset are full fences, so
+  // the fence below is enough until it is set
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+#if defined(__linux__)
+  if (heavy_barrier_enabled.load(std::memory_order_relaxed)) {
+    Membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+#endif
+}
+
+}  // namespace internal
+
+}  // namespace registry
@@ -0,0 +1,37 @@
+#ifndef REGISTRY_MEMORY_BARRIER_H_
+#define REGISTRY_MEMORY_BARRIER_H_
+
+#include <atomic>
+
+namespace registry {
+
+namespace internal {
+
+// Set once the process may issue heavy barriers through the kernel. Only ever
+// goes from false to true
+extern std::atomic<bool> heavy_barrier_enabled;
+
+/// Asymmetric barriers: a LightBarrier() on the frequent side of a
+/// synchronisation is ordered with a HeavyBarrier() on the rare side as if
+/// both were full memory fences. Where the kernel can interrupt every thread
+/// of the process with a fence (Linux membarrier), the light barrier only
+/// prevents compiler reordering and the heavy barrier costs a system call.
+/// Elsewhere both are plain sequentially consistent fences
+inline void LightBarrier() {
+  if (heavy_barrier_enabled.load(std::memory_order_relaxed)) {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+  } else {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+/// Once this returns, every memory access preceding a LightBarrier() in
+/// another thread is visible to the caller, or every access following it
+/// sees the accesses of the caller preceding this barrier
+void HeavyBarrier();
+
+}  // namespace internal
+
+}  // namespace registry
+
+#endif  // REGISTRY_MEMORY_BARRIER_H_
@@ -0,0 +1,96 @@
+#include "registry/name_index.h"
+
+#include "registry/registry.h"
+
+namespace registry {
+
+namespace internal {
+
+bool MatchesGlob(std::string_view pattern, std::string_view name) {
+  constexpr std::size_t kNone = std::string_view::npos;
+  // When the rest of the pattern fails, the last wildcard consumes one more
+  // character and matching resumes after it. Only the last '**' and the last
+  // '*' following it are kept: a later wildcard can absorb whatever an
+  // earlier one would, so matching takes O(pattern * name) steps at worst
+  std::size_t cross_pattern = kNone;
+  std::size_t cross_name = 0;
+  std::size_t star_pattern = kNone;
+  std::size_t star_name = 0;
+  std::size_t pattern_index = 0;
+  std::size_t name_index = 0;
+  while (name_index < name.size()) {
+    if (pattern_index < pattern.size() && pattern[pattern_index] == '*') {
+      if (pattern_index + 1 < pattern.size() &&
+          pattern[pattern_index + 1] == '*') {
+        pattern_index += 2;
+        cross_pattern = pattern_index;
+        cross_name = name_index;
+        star_pattern = kNone;
+      } else {
+        pattern_index += 1;
+        star_pattern = pattern_index;
+        star_name = name_index;
+      }
+      continue;
+    }
+    if (pattern_index < pattern.size() &&
+        pattern[pattern_index] == name[name_index]) {
+      if (name[name_index] == kNamespaceCharacter) {
+        // A '*' never reaches past a dot matched after it
+        star_pattern = kNone;
+      }
+      ++pattern_index;
+      ++name_index;
+      continue;
+    }
+    if (star_pattern != kNone && name[star_name] != kNamespaceCharacter) {
+      pattern_index = star_pattern;
+      name_index = ++star_name;
+      continue;
+    }
+    if (cross_pattern != kNone) {
+      star_pattern = kNone;
+      pattern_index = cross_pattern;
+      name_index = ++cross_name;
+      continue;
+    }
+    return false;
+  }
+  while (pattern_index < pattern.size() && pattern[pattern_index] == '*') {
+    ++pattern_index;
+  }
+  return pattern_index == pattern.size();
+}
+
+GlobMismatch FindGlobMismatch(std::string_view pattern,
+                              std::string_view name) {
+  std::size_t matched = 0;
+  for (;;) {
+    const std::size_t pattern_end = pattern.find(kNamespaceCharacter);
+    const std::string_view pattern_segment = pattern.substr(0, pattern_end);
+    const std::size_t name_end = name.find(kNamespaceCharacter, matched);
+    const std::string_view name_segment =
+        name.substr(matched, name_end == std::string_view::npos
+                                 ? std::string_view::npos
+                                 : name_end - matched);
+    if (!MatchesGlob(pattern_segment, name_segment)) {
+      return GlobMismatch{
+          GlobMismatch::kName, matched, GlobLiteralPrefix(pattern_segment),
+          name_end == std::string_view::npos ? name.size() : name_end + 1};
+    }
+    if (pattern_end == std::string_view::npos) {
+      return name_end == std::string_view::npos
+                 ? GlobMismatch{GlobMismatch::kMatch, name.size(), {}, 0}
+                 : GlobMismatch{GlobMismatch::kTooDeep, name_end + 1, {}, 0};
+    }
+    if (name_end == std::string_view::npos) {
+      return GlobMismatch{GlobMismatch::kTooShallow, name.size(), {}, 0};
+    }
+    pattern.remove_prefix(pattern_end + 1);
+    matched = name_end + 1;
+  }
+}
+
+}  // namespace internal
+
+}  // namespace registry
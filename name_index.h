@@ -0,0 +1,282 @@
+#ifndef REGISTRY_NAME_INDEX_H_
+#define REGISTRY_NAME_INDEX_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "registry/concurrent_containers.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Matches a dotted name against a glob pattern, where '*' matches any run
+/// of characters within a single name and '**' any run of characters, dots
+/// included. Every other character matches itself
+/// @param[in] pattern glob pattern
+/// @param[in] name dotted name to match
+/// @return true if the whole name matches the whole pattern
+bool MatchesGlob(std::string_view pattern, std::string_view name);
+
+/// @return the part of a glob pattern before its first wildcard, which
+/// every name matching the pattern starts with
+inline std::string_view GlobLiteralPrefix(std::string_view pattern) {
+  return pattern.substr(0, pattern.find('*'));
+}
+
+/// Where a dotted name stops matching a glob pattern without '**'
+struct GlobMismatch {
+  enum Kind {
+    kMatch,
+    // A name of the pattern is not matched
+    kName,
+    // The pattern ends before the name, as it does for every name extending
+    // the matched prefix
+    kTooDeep,
+    // The name ends before the pattern
+    kTooShallow,
+  };
+
+  Kind kind;
+  // Size of the prefix of the name matched by the pattern, made of whole
+  // names and their trailing separator
+  std::size_t matched;
+  // For kName, literal prefix of the name of the pattern that is not matched
+  std::string_view literal;
+  // For kName, size of the prefix of the name ending with the name that is
+  // not matched and its separator, the size of the whole name when that name
+  // is the last
+  std::size_t unmatched;
+};
+
+/// Matches a dotted name against a glob pattern one name at a time
+/// @param[in] pattern glob pattern, '**' excluded
+/// @param[in] name dotted name to match
+/// @return where the name stops matching, kMatch if it does not
+GlobMismatch FindGlobMismatch(std::string_view pattern, std::string_view name);
+
+/// @class SortedNameIndex
+/// Nodes of an append-only ConcurrentTable sorted by full name. The sorted
+/// copy is immutable and shared with the views reading it; it is brought up
+/// to date on demand by merging in the nodes appended since the previous
+/// call, so that a tree which stopped growing is never sorted again
+template <typename Node>
+class SortedNameIndex {
+ public:
+  using Nodes = std::vector<Node*>;
+
+  SortedNameIndex() : sorted_(std::make_shared<const Nodes>()), indexed_(0) {}
+
+  SortedNameIndex(const SortedNameIndex&) = delete;
+  SortedNameIndex& operator=(const SortedNameIndex&) = delete;
+
+  /// @param[in] table table holding every node, each with its full name set
+  /// before being published
+  /// @return every node of the table sorted by full name
+  std::shared_ptr<const Nodes> Sorted(const ConcurrentTable<Node*>& table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::size_t size = table.size();
+    if (size != indexed_) {
+      Nodes added;
+      added.reserve(size - indexed_);
+      for (std::size_t index = indexed_; index < size; ++index) {
+        added.push_back(table[index]);
+      }
+      std::sort(added.begin(), added.end(), &FullNameLess);
+      auto merged = std::make_shared<Nodes>();
+      merged->reserve(size);
+      std::merge(sorted_->begin(), sorted_->end(), added.begin(), added.end(),
+                 std::back_inserter(*merged), &FullNameLess);
+      sorted_ = std::move(merged);
+      indexed_ = size;
+    }
+    return sorted_;
+  }
+
+ private:
+  static bool FullNameLess(const Node* lhs, const Node* rhs) {
+    return lhs->FullName() < rhs->FullName();
+  }
+
+  std::mutex mutex_;
+  std::shared_ptr<const Nodes> sorted_;
+  // Number of nodes of the table merged into sorted_
+  std::size_t indexed_;
+};
+
+}  // namespace internal
+
+/// @class NameView
+/// Lazy range over the nodes of a tree, registries or elements, whose full
+/// names match a glob pattern, in order of full name. Nothing is copied up
+/// front: the range starts at the first name carrying the literal prefix of
+/// the pattern, found by binary search, and iterating tests each further
+/// name until one no longer carries the prefix. Views hold on to the sorted
+/// names they were created from, so nodes added afterwards are not listed
+template <typename Node>
+class NameView {
+ public:
+  using Nodes = typename internal::SortedNameIndex<Node>::Nodes;
+
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Node;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Node*;
+    using reference = Node&;
+
+    Iterator() : view_(nullptr), index_(0) {}
+
+    Node& operator*() const { return *(*view_->nodes_)[index_]; }
+    Node* operator->() const { return (*view_->nodes_)[index_]; }
+
+    Iterator& operator++() {
+      index_ = view_->NextMatch(index_ + 1);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    friend class NameView;
+
+    Iterator(const NameView* view, std::size_t index)
+        : view_(view), index_(index) {}
+
+    const NameView* view_;
+    std::size_t index_;
+  };
+
+  /// @param[in] nodes nodes sorted by full name
+  /// @param[in] pattern glob pattern matched against full names, see
+  /// internal::MatchesGlob()
+  NameView(std::shared_ptr<const Nodes> nodes, std::string pattern)
+      : nodes_(std::move(nodes)),
+        pattern_(std::move(pattern)),
+        crosses_names_(pattern_.find("**") != std::string::npos) {
+    const std::string_view prefix = internal::GlobLiteralPrefix(pattern_);
+    first_ = std::lower_bound(nodes_->begin(), nodes_->end(), prefix,
+                              [](const Node* node, std::string_view name) {
+                                return node->FullName() < name;
+                              }) -
+             nodes_->begin();
+    first_ = NextMatch(first_);
+  }
+
+  Iterator begin() const { return Iterator(this, first_); }
+  Iterator end() const { return Iterator(this, nodes_->size()); }
+
+  bool empty() const { return first_ == nodes_->size(); }
+
+  /// Counts the matching nodes, which walks the whole range
+  std::size_t size() const { return std::distance(begin(), end()); }
+
+ private:
+  // @return index of the first matching node at or after index, the number
+  // of nodes if there is none
+  std::size_t NextMatch(std::size_t index) const {
+    const std::string_view prefix = internal::GlobLiteralPrefix(pattern_);
+    while (index < nodes_->size()) {
+      const std::string_view name = (*nodes_)[index]->FullName();
+      if (name.substr(0, prefix.size()) != prefix) {
+        break;
+      }
+      if (crosses_names_) {
+        if (internal::MatchesGlob(pattern_, name)) {
+          return index;
+        }
+        ++index;
+        continue;
+      }
+      const std::size_t candidate = NextCandidate(index, name);
+      if (candidate == index) {
+        return index;
+      }
+      index = candidate;
+    }
+    return nodes_->size();
+  }
+
+  // Names sharing a prefix are contiguous, so once a name fails to match,
+  // every further name failing for the same reason is skipped by binary
+  // search. Without '**' a pattern is matched one name at a time
+  // @return index if its node matches, else index of the first node after it
+  // that may match
+  std::size_t NextCandidate(std::size_t index, std::string_view name) const {
+    const internal::GlobMismatch mismatch =
+        internal::FindGlobMismatch(pattern_, name);
+    switch (mismatch.kind) {
+      case internal::GlobMismatch::kMatch:
+        return index;
+      case internal::GlobMismatch::kTooShallow:
+        return index + 1;
+      case internal::GlobMismatch::kTooDeep:
+        return BlockEnd(index, name.substr(0, mismatch.matched));
+      case internal::GlobMismatch::kName:
+        break;
+    }
+    // The names extending the matched prefix are sorted by their remainder
+    const std::string_view matched = name.substr(0, mismatch.matched);
+    const std::string_view remainder = name.substr(mismatch.matched);
+    const std::string_view literal = mismatch.literal;
+    if (remainder < literal) {
+      // Jump to the first name whose remainder starts with the literal
+      return std::lower_bound(nodes_->begin() + index,
+                              nodes_->begin() + BlockEnd(index, matched),
+                              literal,
+                              [&matched](const Node* node,
+                                         std::string_view key) {
+                                return node->FullName().substr(
+                                           matched.size()) < key;
+                              }) -
+             nodes_->begin();
+    }
+    if (remainder.substr(0, literal.size()) != literal) {
+      // Every further remainder sorts after those starting with the literal
+      return BlockEnd(index, matched);
+    }
+    if (mismatch.unmatched == name.size()) {
+      return index + 1;
+    }
+    return BlockEnd(index, name.substr(0, mismatch.unmatched));
+  }
+
+  // @return index of the first node from index on whose full name does not
+  // start with prefix, given that the full name at index does
+  std::size_t BlockEnd(std::size_t index, std::string_view prefix) const {
+    return std::upper_bound(nodes_->begin() + index + 1, nodes_->end(),
+                            prefix,
+                            [](std::string_view key, const Node* node) {
+                              return key <
+                                     node->FullName().substr(0, key.size());
+                            }) -
+           nodes_->begin();
+  }
+
+  std::shared_ptr<const Nodes> nodes_;
+  std::string pattern_;
+  // Whether the pattern holds '**', whose matches cannot be skipped by block
+  bool crosses_names_;
+  std::size_t first_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_NAME_INDEX_H_
@@ -0,0 +1,867 @@
+#include "registry/parameter_server.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+
+namespace registry {
+
+namespace {
+
+using internal::ParameterFrameHeader;
+
+constexpr std::size_t kReadSize = 64 * 1024;
+// Requests of a connection are no longer read while more output than this is
+// waiting for the client to read it
+constexpr std::size_t kMaxPendingOutput = 4 * 1024 * 1024;
+constexpr int kMaxEvents = 64;
+
+template <typename T>
+void AppendPod(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Longer paths are cut, no element has such a path
+void AppendPath(std::string_view path, std::string* out) {
+  const uint16_t size = static_cast<uint16_t>(
+      std::min<std::size_t>(path.size(), std::numeric_limits<uint16_t>::max()));
+  AppendPod(size, out);
+  out->append(path.data(), size);
+}
+
+void AppendValueHeader(TypeEnum type, uint8_t value_size, uint32_t extent,
+                       std::string* out) {
+  AppendPod(static_cast<uint8_t>(type), out);
+  AppendPod(value_size, out);
+  AppendPod(extent, out);
+}
+
+// Appends a frame header whose size is set by EndFrame()
+// @return offset of the frame within out
+std::size_t BeginFrame(ParameterOpcode opcode, uint32_t sequence,
+                       std::size_t count, std::string* out) {
+  const std::size_t offset = out->size();
+  const ParameterFrameHeader header = {0, sequence,
+                                       static_cast<uint16_t>(opcode), 0,
+                                       static_cast<uint32_t>(count)};
+  AppendPod(header, out);
+  return offset;
+}
+
+void EndFrame(std::size_t offset, std::string* out) {
+  const uint32_t size = static_cast<uint32_t>(out->size() - offset -
+                                              sizeof(ParameterFrameHeader));
+  std::memcpy(&(*out)[offset], &size, sizeof(size));
+}
+
+// Reads the records of a frame, every read failing once past its end
+class RecordReader {
+ public:
+  explicit RecordReader(std::string_view records) : records_(records) {}
+
+  template <typename T>
+  bool ReadPod(T* value) {
+    if (records_.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, records_.data(), sizeof(T));
+    records_.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  bool ReadBytes(std::size_t size, std::string_view* bytes) {
+    if (records_.size() < size) {
+      return false;
+    }
+    *bytes = records_.substr(0, size);
+    records_.remove_prefix(size);
+    return true;
+  }
+
+  bool ReadPath(std::string_view* path) {
+    uint16_t size;
+    return ReadPod(&size) && ReadBytes(size, path);
+  }
+
+  // Reads the value of a value record, the raw bytes of its values or the
+  // characters of a string
+  bool ReadValue(uint8_t* type, uint8_t* value_size, uint32_t* extent,
+                 std::string_view* data) {
+    if (!ReadPod(type) || !ReadPod(value_size) || !ReadPod(extent)) {
+      return false;
+    }
+    if (*value_size == 0) {
+      uint32_t size;
+      return *extent == 0 && ReadPod(&size) && ReadBytes(size, data);
+    }
+    const std::size_t count = *extent != 0 ? *extent : 1;
+    return count <= records_.size() / *value_size &&
+           ReadBytes(count * *value_size, data);
+  }
+
+  bool AtEnd() const { return records_.empty(); }
+
+ private:
+  std::string_view records_;
+};
+
+// Buffer of words, aligned for any value, holding values copied in and out
+// of elements. Only used by the server thread
+std::vector<uint64_t>& ValueBuffer(std::size_t size) {
+  thread_local std::vector<uint64_t> buffer;
+  if (buffer.size() * sizeof(uint64_t) < size) {
+    buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  }
+  return buffer;
+}
+
+// Appends the value record of an element
+ParameterStatus AppendValue(const Registry::Element& element,
+                            std::string* out) {
+  const std::size_t size = element.value_size();
+  if (size == 0) {
+    thread_local std::string value;
+    if (!element.Extract(&value)) {
+      return ParameterStatus::kUnsupported;
+    }
+    AppendValueHeader(element.type(), 0, 0, out);
+    AppendPod(static_cast<uint32_t>(value.size()), out);
+    out->append(value);
+    return ParameterStatus::kOk;
+  }
+  const std::size_t extent = element.extent();
+  const std::size_t value_size = extent != 0 ? size / extent : size;
+  if (value_size > std::numeric_limits<uint8_t>::max()) {
+    return ParameterStatus::kUnsupported;
+  }
+  std::vector<uint64_t>& buffer = ValueBuffer(size);
+  element.ExtractBytes(buffer.data());
+  AppendValueHeader(element.type(), static_cast<uint8_t>(value_size),
+                    static_cast<uint32_t>(extent), out);
+  out->append(reinterpret_cast<const char*>(buffer.data()), size);
+  return ParameterStatus::kOk;
+}
+
+// Appends a status byte, followed by the path relative to registry when
+// with_path is set and by the value record of the element when it is found
+void AppendElement(const Registry& registry, const Registry::Element* element,
+                   bool with_path, std::string* out) {
+  if (element == nullptr) {
+    AppendPod(ParameterStatus::kNotFound, out);
+    return;
+  }
+  const std::size_t status_offset = out->size();
+  AppendPod(ParameterStatus::kOk, out);
+  if (with_path) {
+    AppendPath(element->FullName().substr(registry.FullName().size() + 1),
+               out);
+  }
+  const std::size_t value_offset = out->size();
+  const ParameterStatus status = AppendValue(*element, out);
+  if (status != ParameterStatus::kOk) {
+    out->resize(value_offset);
+    (*out)[status_offset] = static_cast<char>(status);
+  }
+}
+
+// Assigns the value of a value record to an element
+ParameterStatus AssignValue(uint8_t type, uint8_t value_size, uint32_t extent,
+                            std::string_view data, Registry::Element* element) {
+  if (type != static_cast<uint8_t>(element->type()) ||
+      extent != element->extent()) {
+    return ParameterStatus::kTypeMismatch;
+  }
+  if (value_size == 0) {
+    return element->Assign(std::string(data))
+               ? ParameterStatus::kOk
+               : ParameterStatus::kTypeMismatch;
+  }
+  if (data.size() != element->value_size()) {
+    return ParameterStatus::kTypeMismatch;
+  }
+  std::vector<uint64_t>& buffer = ValueBuffer(data.size());
+  std::memcpy(buffer.data(), data.data(), data.size());
+  return element->AssignBytes(buffer.data()) ? ParameterStatus::kOk
+                                             : ParameterStatus::kUnsupported;
+}
+
+Registry::Element* FindElement(Registry* registry, std::string_view path) {
+  common::ErrorOr<Registry::Element*> element =
+      registry->FindElementByExtendedName(path);
+  return element.HasValue() ? element.ValueOrDie() : nullptr;
+}
+
+bool ParseStatus(RecordReader* reader, ParameterValue* value) {
+  uint8_t status;
+  if (!reader->ReadPod(&status) ||
+      status > static_cast<uint8_t>(ParameterStatus::kUnsupported)) {
+    return false;
+  }
+  value->status = static_cast<ParameterStatus>(status);
+  return true;
+}
+
+bool ParseValue(RecordReader* reader, ParameterValue* value) {
+  uint8_t type;
+  std::string_view data;
+  if (!reader->ReadValue(&type, &value->value_size, &value->extent, &data)) {
+    return false;
+  }
+  value->type = static_cast<TypeEnum>(type);
+  value->data.assign(data);
+  return true;
+}
+
+// Parses a record of a response or an update
+bool ParseRecord(ParameterOpcode opcode, RecordReader* reader,
+                 ParameterValue* value) {
+  if (!ParseStatus(reader, value)) {
+    return false;
+  }
+  if (opcode == ParameterOpcode::kSet ||
+      opcode == ParameterOpcode::kSubscribe) {
+    return true;
+  }
+  if (opcode != ParameterOpcode::kGet) {
+    std::string_view path;
+    if (!reader->ReadPath(&path)) {
+      return false;
+    }
+    value->path.assign(path);
+  }
+  return value->status != ParameterStatus::kOk || ParseValue(reader, value);
+}
+
+bool MakeAddress(const std::string& path, sockaddr_un* address) {
+  if (path.size() >= sizeof(address->sun_path)) {
+    return false;
+  }
+  std::memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  std::memcpy(address->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+}  // namespace
+
+// Elements changed since the last update of a connection. Filled by the
+// subscription callbacks, on whichever thread dispatches the changes
+struct ParameterServer::UpdateQueue {
+  std::mutex mutex;
+  std::vector<Registry::Element*> elements;
+  // Set once the connection is closed, callbacks running late then leave
+  // the event fd alone
+  bool closed = false;
+  int event_fd = -1;
+};
+
+struct ParameterServer::Connection {
+  int fd;
+  std::string in;
+  std::string out;
+  std::size_t out_offset = 0;
+  // Events the socket is watched for
+  uint32_t events = EPOLLIN;
+  std::vector<uint64_t> subscriptions;
+  std::shared_ptr<UpdateQueue> updates;
+};
+
+ParameterServer::ParameterServer(Registry* registry,
+                                 std::chrono::milliseconds dispatch_period)
+    : registry_(registry),
+      dispatch_period_(dispatch_period),
+      listen_fd_(-1),
+      epoll_fd_(-1),
+      event_fd_(-1),
+      stopping_(false),
+      subscription_count_(0) {}
+
+ParameterServer::~ParameterServer() { Stop(); }
+
+bool ParameterServer::Start(const std::string& path) {
+  sockaddr_un address;
+  if (thread_.joinable() || !MakeAddress(path, &address)) {
+    return false;
+  }
+  unlink(path.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  epoll_event listen_event = {};
+  listen_event.events = EPOLLIN;
+  listen_event.data.fd = listen_fd_;
+  epoll_event wake_event = {};
+  wake_event.events = EPOLLIN;
+  wake_event.data.fd = event_fd_;
+  if (listen_fd_ < 0 || epoll_fd_ < 0 || event_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0 ||
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &listen_event) != 0 ||
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &wake_event) != 0) {
+    for (int* fd : {&listen_fd_, &epoll_fd_, &event_fd_}) {
+      if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+      }
+    }
+    return false;
+  }
+  path_ = path;
+  stopping_.store(false);
+  thread_ = std::thread(&ParameterServer::Run, this);
+  return true;
+}
+
+void ParameterServer::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  stopping_.store(true);
+  const uint64_t wake = 1;
+  (void)write(event_fd_, &wake, sizeof(wake));
+  thread_.join();
+  while (!connections_.empty()) {
+    Close(connections_.begin()->first);
+  }
+  close(listen_fd_);
+  close(epoll_fd_);
+  close(event_fd_);
+  listen_fd_ = epoll_fd_ = event_fd_ = -1;
+  unlink(path_.c_str());
+}
+
+void ParameterServer::Run() {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point next_dispatch = Clock::now() + dispatch_period_;
+  epoll_event events[kMaxEvents];
+  while (!stopping_.load()) {
+    const bool dispatching =
+        dispatch_period_.count() > 0 && subscription_count_ > 0;
+    int timeout = -1;
+    if (dispatching) {
+      timeout = static_cast<int>(std::max<int64_t>(
+          0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                 next_dispatch - Clock::now())
+                 .count()));
+    }
+    const int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout);
+    if (count < 0 && errno != EINTR) {
+      break;
+    }
+    bool wake = false;
+    for (int index = 0; index < count; ++index) {
+      const int fd = events[index].data.fd;
+      if (fd == listen_fd_) {
+        Accept();
+        continue;
+      }
+      if (fd == event_fd_) {
+        uint64_t value;
+        (void)read(event_fd_, &value, sizeof(value));
+        wake = true;
+        continue;
+      }
+      auto connection = connections_.find(fd);
+      if (connection == connections_.end()) {
+        continue;
+      }
+      const uint32_t flags = events[index].events;
+      bool open = true;
+      if (flags & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        open = Read(connection->second.get());
+      }
+      if (open && (flags & EPOLLOUT)) {
+        open = Write(connection->second.get());
+      }
+      if (!open) {
+        Close(fd);
+      }
+    }
+    if (dispatching && Clock::now() >= next_dispatch) {
+      // Callbacks run on this thread and fill the update queues
+      registry_->DispatchChanges();
+      next_dispatch = Clock::now() + dispatch_period_;
+      wake = true;
+    }
+    if (wake) {
+      SendUpdates();
+    }
+  }
+}
+
+void ParameterServer::Accept() {
+  for (;;) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      close(fd);
+      continue;
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->updates = std::make_shared<UpdateQueue>();
+    connection->updates->event_fd = event_fd_;
+    connections_[fd] = std::move(connection);
+  }
+}
+
+bool ParameterServer::Read(Connection* connection) {
+  // A single read per event bounds the requests buffered and answered at
+  // once, epoll reports the socket again while data is left in it
+  const std::size_t size = connection->in.size();
+  connection->in.resize(size + kReadSize);
+  ssize_t received;
+  do {
+    received = recv(connection->fd, &connection->in[size], kReadSize, 0);
+  } while (received < 0 && errno == EINTR);
+  connection->in.resize(size + std::max<ssize_t>(received, 0));
+  if (received == 0 ||
+      (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    return false;
+  }
+  // Every whole request received is answered before writing, so that
+  // pipelined requests are answered with as few writes as possible
+  return HandleFrames(connection) && Write(connection);
+}
+
+bool ParameterServer::Write(Connection* connection) {
+  while (connection->out_offset < connection->out.size()) {
+    const ssize_t sent =
+        send(connection->fd, connection->out.data() + connection->out_offset,
+             connection->out.size() - connection->out_offset, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      break;
+    }
+    connection->out_offset += sent;
+  }
+  if (connection->out_offset == connection->out.size()) {
+    connection->out.clear();
+    connection->out_offset = 0;
+  }
+  WatchEvents(connection);
+  return true;
+}
+
+void ParameterServer::WatchEvents(Connection* connection) {
+  const std::size_t pending = connection->out.size() - connection->out_offset;
+  uint32_t events = pending > kMaxPendingOutput ? 0 : EPOLLIN;
+  if (pending != 0) {
+    events |= EPOLLOUT;
+  }
+  if (events != connection->events) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = connection->fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+  }
+}
+
+void ParameterServer::Close(int fd) {
+  auto connection = connections_.find(fd);
+  for (uint64_t id : connection->second->subscriptions) {
+    registry_->Unsubscribe(id);
+  }
+  subscription_count_ -= connection->second->subscriptions.size();
+  {
+    std::lock_guard<std::mutex> lock(connection->second->updates->mutex);
+    connection->second->updates->closed = true;
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  connections_.erase(connection);
+}
+
+bool ParameterServer::HandleFrames(Connection* connection) {
+  std::size_t offset = 0;
+  const std::string& in = connection->in;
+  while (in.size() - offset >= sizeof(ParameterFrameHeader)) {
+    ParameterFrameHeader header;
+    std::memcpy(&header, in.data() + offset, sizeof(header));
+    if (header.size > kMaxFrameSize) {
+      return false;
+    }
+    if (in.size() - offset - sizeof(header) < header.size) {
+      break;
+    }
+    const std::string_view records(in.data() + offset + sizeof(header),
+                                   header.size);
+    if (!HandleFrame(header, records, connection)) {
+      return false;
+    }
+    offset += sizeof(header) + header.size;
+  }
+  connection->in.erase(0, offset);
+  return true;
+}
+
+bool ParameterServer::HandleFrame(const ParameterFrameHeader& header,
+                                  std::string_view records,
+                                  Connection* connection) {
+  const ParameterOpcode opcode = static_cast<ParameterOpcode>(header.opcode);
+  RecordReader reader(records);
+  std::string* out = &connection->out;
+  const std::size_t frame = out->size();
+  if (opcode == ParameterOpcode::kList) {
+    std::string_view pattern;
+    if (header.count != 1 || !reader.ReadPath(&pattern) || !reader.AtEnd()) {
+      return false;
+    }
+    BeginFrame(opcode, header.sequence, 0, out);
+    uint32_t count = 0;
+    for (const Registry::Element& element :
+         registry_->MatchElements(pattern)) {
+      AppendElement(*registry_, &element, true, out);
+      ++count;
+    }
+    std::memcpy(&(*out)[frame + offsetof(ParameterFrameHeader, count)],
+                &count, sizeof(count));
+    EndFrame(frame, out);
+    return true;
+  }
+  if (opcode != ParameterOpcode::kGet && opcode != ParameterOpcode::kSet &&
+      opcode != ParameterOpcode::kSubscribe) {
+    return false;
+  }
+  // Every record is parsed before the first one is handled, so that a
+  // malformed request changes nothing
+  RecordReader validator(records);
+  for (uint32_t record = 0; record < header.count; ++record) {
+    std::string_view path;
+    uint8_t type;
+    uint8_t value_size;
+    uint32_t extent;
+    std::string_view data;
+    if (!validator.ReadPath(&path) ||
+        (opcode == ParameterOpcode::kSet &&
+         !validator.ReadValue(&type, &value_size, &extent, &data))) {
+      return false;
+    }
+  }
+  if (!validator.AtEnd()) {
+    return false;
+  }
+
+  BeginFrame(opcode, header.sequence, header.count, out);
+  for (uint32_t record = 0; record < header.count; ++record) {
+    std::string_view path;
+    if (!reader.ReadPath(&path)) {
+      return false;
+    }
+    Registry::Element* element = FindElement(registry_, path);
+    switch (opcode) {
+      case ParameterOpcode::kGet:
+        AppendElement(*registry_, element, false, out);
+        break;
+      case ParameterOpcode::kSet: {
+        uint8_t type;
+        uint8_t value_size;
+        uint32_t extent;
+        std::string_view data;
+        if (!reader.ReadValue(&type, &value_size, &extent, &data)) {
+          return false;
+        }
+        AppendPod(element == nullptr ? ParameterStatus::kNotFound
+                                     : AssignValue(type, value_size, extent,
+                                                   data, element),
+                  out);
+        break;
+      }
+      case ParameterOpcode::kSubscribe: {
+        if (element == nullptr) {
+          AppendPod(ParameterStatus::kNotFound, out);
+          break;
+        }
+        std::shared_ptr<UpdateQueue> updates = connection->updates;
+        const uint64_t id =
+            registry_
+                ->Subscribe(
+                    element,
+                    [updates](const std::vector<Registry::Element*>& changed) {
+                      std::lock_guard<std::mutex> lock(updates->mutex);
+                      if (updates->closed) {
+                        return;
+                      }
+                      const bool wake = updates->elements.empty();
+                      updates->elements.insert(updates->elements.end(),
+                                               changed.begin(), changed.end());
+                      if (wake) {
+                        const uint64_t value = 1;
+                        (void)write(updates->event_fd, &value, sizeof(value));
+                      }
+                    })
+                .ValueOrDie();
+        connection->subscriptions.push_back(id);
+        ++subscription_count_;
+        AppendPod(ParameterStatus::kOk, out);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  EndFrame(frame, out);
+  return true;
+}
+
+void ParameterServer::SendUpdates() {
+  std::vector<int> failed;
+  std::vector<Registry::Element*> elements;
+  for (auto& entry : connections_) {
+    Connection* connection = entry.second.get();
+    {
+      std::lock_guard<std::mutex> lock(connection->updates->mutex);
+      elements.swap(connection->updates->elements);
+    }
+    if (elements.empty()) {
+      continue;
+    }
+    // Elements subscribed more than once are sent once
+    std::sort(elements.begin(), elements.end());
+    elements.erase(std::unique(elements.begin(), elements.end()),
+                   elements.end());
+    const std::size_t frame = BeginFrame(ParameterOpcode::kUpdate, 0,
+                                         elements.size(), &connection->out);
+    for (const Registry::Element* element : elements) {
+      AppendElement(*registry_, element, true, &connection->out);
+    }
+    EndFrame(frame, &connection->out);
+    elements.clear();
+    if (!Write(connection)) {
+      failed.push_back(entry.first);
+    }
+  }
+  for (int fd : failed) {
+    Close(fd);
+  }
+}
+
+ParameterClient::ParameterClient()
+    : fd_(-1), next_sequence_(1), frame_offset_(0), receive_offset_(0) {}
+
+ParameterClient::~ParameterClient() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool ParameterClient::Connect(const std::string& path) {
+  sockaddr_un address;
+  if (fd_ >= 0 || !MakeAddress(path, &address)) {
+    return false;
+  }
+  fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0 || connect(fd_, reinterpret_cast<const sockaddr*>(&address),
+                         sizeof(address)) != 0) {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+    return false;
+  }
+  return true;
+}
+
+uint32_t ParameterClient::BeginFrame(ParameterOpcode opcode,
+                                     std::size_t count) {
+  const uint32_t sequence = next_sequence_++;
+  // Sequence 0 marks updates
+  if (next_sequence_ == 0) {
+    next_sequence_ = 1;
+  }
+  frame_offset_ = registry::BeginFrame(opcode, sequence, count, &send_buffer_);
+  return sequence;
+}
+
+void ParameterClient::EndFrame() {
+  registry::EndFrame(frame_offset_, &send_buffer_);
+}
+
+uint32_t ParameterClient::SendGet(const std::vector<std::string>& paths) {
+  const uint32_t sequence = BeginFrame(ParameterOpcode::kGet, paths.size());
+  for (const std::string& path : paths) {
+    AppendPath(path, &send_buffer_);
+  }
+  EndFrame();
+  return sequence;
+}
+
+uint32_t ParameterClient::SendSet(const std::vector<ParameterValue>& values) {
+  const uint32_t sequence = BeginFrame(ParameterOpcode::kSet, values.size());
+  for (const ParameterValue& value : values) {
+    AppendPath(value.path, &send_buffer_);
+    AppendValueHeader(value.type, value.value_size, value.extent,
+                      &send_buffer_);
+    if (value.value_size == 0) {
+      AppendPod(static_cast<uint32_t>(value.data.size()), &send_buffer_);
+    }
+    send_buffer_.append(value.data);
+  }
+  EndFrame();
+  return sequence;
+}
+
+uint32_t ParameterClient::SendList(std::string_view pattern) {
+  const uint32_t sequence = BeginFrame(ParameterOpcode::kList, 1);
+  AppendPath(pattern, &send_buffer_);
+  EndFrame();
+  return sequence;
+}
+
+uint32_t ParameterClient::SendSubscribe(const std::vector<std::string>& paths) {
+  const uint32_t sequence =
+      BeginFrame(ParameterOpcode::kSubscribe, paths.size());
+  for (const std::string& path : paths) {
+    AppendPath(path, &send_buffer_);
+  }
+  EndFrame();
+  return sequence;
+}
+
+bool ParameterClient::Flush() {
+  std::size_t offset = 0;
+  while (offset < send_buffer_.size()) {
+    const ssize_t sent = send(fd_, send_buffer_.data() + offset,
+                              send_buffer_.size() - offset, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    offset += sent;
+  }
+  send_buffer_.clear();
+  return true;
+}
+
+common::ErrorOr<ParameterReply> ParameterClient::Receive() {
+  if (!updates_.empty()) {
+    ParameterReply update = std::move(updates_.front());
+    updates_.pop_front();
+    return update;
+  }
+  if (!Flush()) {
+    return common::Error::kUnavailable;
+  }
+  return ReadFrame();
+}
+
+bool ParameterClient::Fill(std::size_t size) {
+  while (receive_buffer_.size() - receive_offset_ < size) {
+    if (receive_offset_ != 0) {
+      receive_buffer_.erase(0, receive_offset_);
+      receive_offset_ = 0;
+    }
+    const std::size_t filled = receive_buffer_.size();
+    receive_buffer_.resize(std::max(filled + kReadSize, size));
+    const ssize_t received = recv(fd_, &receive_buffer_[filled],
+                                  receive_buffer_.size() - filled, 0);
+    receive_buffer_.resize(filled + std::max<ssize_t>(received, 0));
+    if (received == 0 || (received < 0 && errno != EINTR)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+common::ErrorOr<ParameterReply> ParameterClient::ReadFrame() {
+  if (fd_ < 0 || !Fill(sizeof(ParameterFrameHeader))) {
+    return common::Error::kUnavailable;
+  }
+  ParameterFrameHeader header;
+  std::memcpy(&header, receive_buffer_.data() + receive_offset_,
+              sizeof(header));
+  if (header.size > ParameterServer::kMaxFrameSize ||
+      !Fill(sizeof(header) + header.size)) {
+    return common::Error::kUnavailable;
+  }
+  RecordReader reader(std::string_view(
+      receive_buffer_.data() + receive_offset_ + sizeof(header), header.size));
+  receive_offset_ += sizeof(header) + header.size;
+
+  ParameterReply reply;
+  reply.opcode = static_cast<ParameterOpcode>(header.opcode);
+  reply.sequence = header.sequence;
+  if (header.count > header.size) {
+    return common::Error::kUnavailable;
+  }
+  reply.values.resize(header.count);
+  for (ParameterValue& value : reply.values) {
+    if (!ParseRecord(reply.opcode, &reader, &value)) {
+      return common::Error::kUnavailable;
+    }
+  }
+  if (!reader.AtEnd()) {
+    return common::Error::kUnavailable;
+  }
+  return reply;
+}
+
+common::ErrorOr<std::vector<ParameterValue>> ParameterClient::Await(
+    uint32_t sequence) {
+  if (!Flush()) {
+    return common::Error::kUnavailable;
+  }
+  for (;;) {
+    common::ErrorOr<ParameterReply> reply = ReadFrame();
+    if (!reply.HasValue()) {
+      return reply.ErrorOrDie();
+    }
+    if (reply.ValueOrDie().opcode == ParameterOpcode::kUpdate) {
+      updates_.push_back(std::move(reply.ValueOrDie()));
+    } else if (reply.ValueOrDie().sequence == sequence) {
+      return std::move(reply.ValueOrDie().values);
+    }
+  }
+}
+
+common::ErrorOr<std::vector<ParameterValue>> ParameterClient::Get(
+    const std::vector<std::string>& paths) {
+  common::ErrorOr<std::vector<ParameterValue>> values = Await(SendGet(paths));
+  if (values.HasValue()) {
+    for (std::size_t index = 0; index < paths.size(); ++index) {
+      values.ValueOrDie()[index].path = paths[index];
+    }
+  }
+  return values;
+}
+
+common::ErrorOr<std::vector<ParameterValue>> ParameterClient::Set(
+    const std::vector<ParameterValue>& values) {
+  return Await(SendSet(values));
+}
+
+common::ErrorOr<std::vector<ParameterValue>> ParameterClient::List(
+    std::string_view pattern) {
+  return Await(SendList(pattern));
+}
+
+common::ErrorOr<std::vector<ParameterValue>> ParameterClient::Subscribe(
+    const std::vector<std::string>& paths) {
+  return Await(SendSubscribe(paths));
+}
+
+}  // namespace registry
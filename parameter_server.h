@@ -0,0 +1,299 @@
+#ifndef REGISTRY_PARAMETER_SERVER_H_
+#define REGISTRY_PARAMETER_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "common/error_or.h"
+#include "common/type_traits.h"
+#include "registry/registry.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Every frame exchanged with a ParameterServer starts with this header,
+/// followed by size bytes holding count records. Data is in host byte order.
+///
+/// A path record is its size as a uint16_t followed by its characters. A
+/// value record holds the type tag of the element as in serialized dumps
+/// (uint8_t), the size of each value, 0 for strings (uint8_t), and the number
+/// of values of arrays, 0 otherwise (uint32_t). The bytes of the values
+/// follow, or the size of a string as a uint32_t and its characters.
+/// Requests and their records:
+///   kGet        paths                answered by a status byte and a value
+///   kSet        a path and a value   answered by a status byte
+///   kList       one glob pattern     answered by a path and a value
+///   kSubscribe  paths                answered by a status byte
+/// Responses carry the sequence and opcode of their request, and are sent in
+/// the order requests were received. Updates of subscribed elements are
+/// pushed as kUpdate frames of sequence 0, holding a path and a value
+struct ParameterFrameHeader {
+  uint32_t size;
+  uint32_t sequence;
+  uint16_t opcode;
+  uint16_t reserved;
+  uint32_t count;
+};
+static_assert(sizeof(ParameterFrameHeader) == 16,
+              "ParameterFrameHeader must not contain padding");
+
+}  // namespace internal
+
+enum class ParameterOpcode : uint16_t {
+  kGet = 1,
+  kSet = 2,
+  kList = 3,
+  kSubscribe = 4,
+  kUpdate = 5,
+};
+
+enum class ParameterStatus : uint8_t {
+  kOk = 0,
+  // No element at the path
+  kNotFound = 1,
+  // The value does not match the type, value size or extent of the element
+  kTypeMismatch = 2,
+  // The value of the element cannot be copied, such as some enums
+  kUnsupported = 3,
+};
+
+/// @struct ParameterValue
+/// Path, status and value of an element as exchanged with a ParameterServer
+struct ParameterValue {
+  /// @return value of path holding value, of a type supported by the registry
+  template <typename T>
+  static ParameterValue Of(std::string path, const T& value) {
+    ParameterValue parameter;
+    parameter.path = std::move(path);
+    parameter.type = TypeTrait<T>::type;
+    if constexpr (std::is_same<T, std::string>::value) {
+      parameter.data = value;
+    } else {
+      static_assert(std::is_trivially_copyable<T>::value,
+                    "Values are exchanged as raw bytes");
+      parameter.value_size = sizeof(T);
+      parameter.data.assign(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    return parameter;
+  }
+
+  /// @return value of path holding the values of an array element
+  template <typename T>
+  static ParameterValue OfArray(std::string path,
+                                const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Values are exchanged as raw bytes");
+    ParameterValue parameter;
+    parameter.path = std::move(path);
+    parameter.type = TypeTrait<T>::type;
+    parameter.value_size = sizeof(T);
+    parameter.extent = static_cast<uint32_t>(values.size());
+    parameter.data.assign(reinterpret_cast<const char*>(values.data()),
+                          values.size() * sizeof(T));
+    return parameter;
+  }
+
+  /// @param[out] value value held, when it is of type T
+  /// @return false if the value is missing or not of type T
+  template <typename T>
+  bool As(T* value) const {
+    if (status != ParameterStatus::kOk || type != TypeTrait<T>::type ||
+        extent != 0) {
+      return false;
+    }
+    if constexpr (std::is_same<T, std::string>::value) {
+      *value = data;
+    } else {
+      if (value_size != sizeof(T) || data.size() != sizeof(T)) {
+        return false;
+      }
+      std::memcpy(value, data.data(), sizeof(T));
+    }
+    return true;
+  }
+
+  /// @param[out] values values held, when they are those of an array of T
+  /// @return false if the values are missing or not an array of T
+  template <typename T>
+  bool AsArray(std::vector<T>* values) const {
+    if (status != ParameterStatus::kOk || type != TypeTrait<T>::type ||
+        extent == 0 || value_size != sizeof(T) ||
+        data.size() != extent * sizeof(T)) {
+      return false;
+    }
+    values->resize(extent);
+    std::memcpy(values->data(), data.data(), data.size());
+    return true;
+  }
+
+  ParameterStatus status = ParameterStatus::kOk;
+  std::string path;
+  TypeEnum type = TypeEnum{};
+  uint8_t value_size = 0;
+  uint32_t extent = 0;
+  // Raw bytes of the values, characters of strings
+  std::string data;
+};
+
+/// @struct ParameterReply
+/// Response to a request, or update of subscribed elements
+struct ParameterReply {
+  ParameterOpcode opcode;
+  uint32_t sequence;
+  // One per record. Responses to kSet and kSubscribe only carry a status,
+  // responses to kGet carry no path
+  std::vector<ParameterValue> values;
+};
+
+/// @class ParameterServer
+/// Serves the elements below a registry to other processes over a Unix
+/// domain socket, see internal::ParameterFrameHeader for the protocol. Every
+/// request is a batch of records, and clients may send any number of
+/// requests before reading the responses. A single thread serves every
+/// connection through epoll, and stops reading the requests of a client
+/// while megabytes of responses wait for it to read them. Malformed
+/// requests close their connection before any of their records is handled.
+///
+/// Paths are relative to the registry. Values are read and written through
+/// Element::ExtractBytes and AssignBytes, strings through Extract and Assign
+class ParameterServer {
+ public:
+  /// Largest frame accepted, connections sending larger ones are closed
+  static constexpr uint32_t kMaxFrameSize = 16 * 1024 * 1024;
+
+  /// @param[in] registry registry served, must outlive the server
+  /// @param[in] dispatch_period period at which the server thread calls
+  /// Registry::DispatchChanges() while elements are subscribed, 0 if the
+  /// application calls it itself
+  ParameterServer(Registry* registry,
+                  std::chrono::milliseconds dispatch_period);
+
+  /// Stops the server
+  ~ParameterServer();
+
+  ParameterServer(const ParameterServer&) = delete;
+  ParameterServer& operator=(const ParameterServer&) = delete;
+
+  /// Binds the socket, replacing any file at path, and starts serving it
+  /// @param[in] path path of the socket
+  /// @return false if the server is already running or the socket cannot be
+  /// bound
+  bool Start(const std::string& path);
+
+  /// Closes every connection and the socket, which is removed. Returns once
+  /// the server thread has exited
+  void Stop();
+
+ private:
+  struct UpdateQueue;
+  struct Connection;
+
+  void Run();
+  void Accept();
+  // @return false if the connection has to be closed
+  bool Read(Connection* connection);
+  bool Write(Connection* connection);
+  // Watches the socket for writability while output is pending, and for
+  // requests unless too much output is
+  void WatchEvents(Connection* connection);
+  void Close(int fd);
+  // Handles every whole frame received on the connection
+  // @return false if a frame is malformed
+  bool HandleFrames(Connection* connection);
+  bool HandleFrame(const internal::ParameterFrameHeader& header,
+                   std::string_view records, Connection* connection);
+  // Queues an update frame for every connection with changed elements
+  void SendUpdates();
+
+  Registry* const registry_;
+  const std::chrono::milliseconds dispatch_period_;
+  std::string path_;
+  int listen_fd_;
+  int epoll_fd_;
+  // Wakes the server thread up, to stop or to send updates
+  int event_fd_;
+  std::atomic<bool> stopping_;
+  std::thread thread_;
+  std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+  std::size_t subscription_count_;
+};
+
+/// @class ParameterClient
+/// Blocking client of a ParameterServer. Requests are queued by the Send
+/// methods and written by Flush(), so that several batches can be pipelined
+/// before their responses are read with Receive()
+class ParameterClient {
+ public:
+  ParameterClient();
+  ~ParameterClient();
+
+  ParameterClient(const ParameterClient&) = delete;
+  ParameterClient& operator=(const ParameterClient&) = delete;
+
+  /// @param[in] path path of the socket of the server
+  /// @return false if already connected or the server cannot be reached
+  bool Connect(const std::string& path);
+
+  /// Queues requests, each a batch of records
+  /// @return sequence of the request, carried by its response
+  uint32_t SendGet(const std::vector<std::string>& paths);
+  uint32_t SendSet(const std::vector<ParameterValue>& values);
+  uint32_t SendList(std::string_view pattern);
+  uint32_t SendSubscribe(const std::vector<std::string>& paths);
+
+  /// Writes every queued request
+  /// @return false if the connection failed
+  bool Flush();
+
+  /// Reads the next response or update, flushing queued requests first
+  /// @return the reply, else kUnavailable if the connection failed or the
+  /// server sent a malformed frame
+  common::ErrorOr<ParameterReply> Receive();
+
+  /// Sends a request and waits for its response. Updates received meanwhile
+  /// are kept for Receive()
+  /// @return values of the response, else kUnavailable if the connection
+  /// failed
+  common::ErrorOr<std::vector<ParameterValue>> Get(
+      const std::vector<std::string>& paths);
+  common::ErrorOr<std::vector<ParameterValue>> Set(
+      const std::vector<ParameterValue>& values);
+  common::ErrorOr<std::vector<ParameterValue>> List(std::string_view pattern);
+  common::ErrorOr<std::vector<ParameterValue>> Subscribe(
+      const std::vector<std::string>& paths);
+
+ private:
+  // Starts a frame of the send buffer, whose size is set by EndFrame()
+  uint32_t BeginFrame(ParameterOpcode opcode, std::size_t count);
+  void EndFrame();
+  // Reads until size bytes past the receive offset are buffered
+  bool Fill(std::size_t size);
+  common::ErrorOr<ParameterReply> ReadFrame();
+  common::ErrorOr<std::vector<ParameterValue>> Await(uint32_t sequence);
+
+  int fd_;
+  uint32_t next_sequence_;
+  std::string send_buffer_;
+  // Offset of the frame being queued in the send buffer
+  std::size_t frame_offset_;
+  std::string receive_buffer_;
+  std::size_t receive_offset_;
+  // Updates read while awaiting a response
+  std::deque<ParameterReply> updates_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_PARAMETER_SERVER_H_
@@ -0,0 +1,244 @@
+#include "registry/parameter_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+class ParameterServerTest : public ::testing::Test {
+ public:
+  ParameterServerTest()
+      : path_(::testing::TempDir() + "parameter_server_test_" +
+              std::to_string(getpid())),
+        registry_("robot"),
+        server_(&registry_, std::chrono::milliseconds(0)) {}
+
+ protected:
+  void SetUp() override {
+    arm_ = registry_.AddChildRegistry("arm").ValueOrDie();
+    *arm_->AddInt32("mode").ValueOrDie() = 3;
+    *arm_->AddDouble("gain").ValueOrDie() = 0.5;
+    arm_->AddBoolean("enabled").ValueOrDie();
+    arm_->AddString("name", "left").ValueOrDie();
+    arm_->AddArray<double>("limits", 3).ValueOrDie();
+    ASSERT_TRUE(server_.Start(path_));
+    ASSERT_TRUE(client_.Connect(path_));
+  }
+
+  // Sends a frame on a connection of its own
+  // @return true if the server closed the connection without answering
+  bool ClosesConnectionOn(internal::ParameterFrameHeader header,
+                          const std::string& records) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path_.c_str(),
+                 sizeof(address.sun_path) - 1);
+    const timeval timeout = {10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    header.size = header.size != 0 ? header.size : records.size();
+    std::string frame(reinterpret_cast<const char*>(&header), sizeof(header));
+    frame += records;
+    char byte;
+    const bool closed =
+        connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                sizeof(address)) == 0 &&
+        send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) ==
+            static_cast<ssize_t>(frame.size()) &&
+        recv(fd, &byte, 1, 0) == 0;
+    close(fd);
+    return closed;
+  }
+
+  const std::string path_;
+  Registry registry_;
+  Registry* arm_ = nullptr;
+  ParameterServer server_;
+  ParameterClient client_;
+};
+
+TEST_F(ParameterServerTest, GetsValues) {
+  common::ErrorOr<std::vector<ParameterValue>> values =
+      client_.Get({"arm.mode", "arm.gain", "arm.name", "arm.limits", "nope"});
+  ASSERT_TRUE(values.HasValue());
+  ASSERT_EQ(values.ValueOrDie().size(), 5u);
+  int32_t mode;
+  EXPECT_TRUE(values.ValueOrDie()[0].As(&mode));
+  EXPECT_EQ(mode, 3);
+  EXPECT_EQ(values.ValueOrDie()[0].path, "arm.mode");
+  double gain;
+  EXPECT_TRUE(values.ValueOrDie()[1].As(&gain));
+  EXPECT_EQ(gain, 0.5);
+  EXPECT_FALSE(values.ValueOrDie()[1].As(&mode));
+  std::string name;
+  EXPECT_TRUE(values.ValueOrDie()[2].As(&name));
+  EXPECT_EQ(name, "left");
+  std::vector<double> limits;
+  EXPECT_TRUE(values.ValueOrDie()[3].AsArray(&limits));
+  EXPECT_EQ(limits, std::vector<double>(3, 0.0));
+  EXPECT_EQ(values.ValueOrDie()[4].status, ParameterStatus::kNotFound);
+}
+
+TEST_F(ParameterServerTest, SetsValues) {
+  common::ErrorOr<std::vector<ParameterValue>> statuses = client_.Set(
+      {ParameterValue::Of<int32_t>("arm.mode", -7),
+       ParameterValue::Of<bool>("arm.enabled", true),
+       ParameterValue::Of<std::string>("arm.name", "right"),
+       ParameterValue::OfArray<double>("arm.limits", {-1.0, 0.0, 1.0}),
+       ParameterValue::Of<float>("arm.gain", 1.0f),
+       ParameterValue::OfArray<double>("arm.limits", {1.0}),
+       ParameterValue::Of<int32_t>("arm.missing", 1)});
+  ASSERT_TRUE(statuses.HasValue());
+  const std::vector<ParameterStatus> expected = {
+      ParameterStatus::kOk,           ParameterStatus::kOk,
+      ParameterStatus::kOk,           ParameterStatus::kOk,
+      ParameterStatus::kTypeMismatch, ParameterStatus::kTypeMismatch,
+      ParameterStatus::kNotFound};
+  ASSERT_EQ(statuses.ValueOrDie().size(), expected.size());
+  for (std::size_t index = 0; index < expected.size(); ++index) {
+    EXPECT_EQ(statuses.ValueOrDie()[index].status, expected[index]) << index;
+  }
+
+  EXPECT_EQ(arm_->FindInt32("mode").ValueOrDie()->value(), -7);
+  EXPECT_TRUE(arm_->FindBoolean("enabled").ValueOrDie()->value());
+  EXPECT_EQ(arm_->FindString("name").ValueOrDie()->value(), "right");
+  EXPECT_EQ(arm_->FindDouble("gain").ValueOrDie()->value(), 0.5);
+  double limits[3];
+  arm_->FindArray<double>("limits").ValueOrDie()->Get(0, 3, limits);
+  EXPECT_EQ(limits[0], -1.0);
+  EXPECT_EQ(limits[2], 1.0);
+}
+
+TEST_F(ParameterServerTest, AnswersPipelinedRequestsInOrder) {
+  std::vector<uint32_t> sequences;
+  for (int32_t mode = 0; mode < 100; ++mode) {
+    sequences.push_back(
+        client_.SendSet({ParameterValue::Of<int32_t>("arm.mode", mode)}));
+    sequences.push_back(client_.SendGet({"arm.mode"}));
+  }
+  ASSERT_TRUE(client_.Flush());
+  for (std::size_t index = 0; index < sequences.size(); ++index) {
+    common::ErrorOr<ParameterReply> reply = client_.Receive();
+    ASSERT_TRUE(reply.HasValue());
+    ASSERT_EQ(reply.ValueOrDie().sequence, sequences[index]);
+    ASSERT_EQ(reply.ValueOrDie().values.size(), 1u);
+    if (index % 2 == 1) {
+      int32_t mode;
+      ASSERT_TRUE(reply.ValueOrDie().values[0].As(&mode));
+      EXPECT_EQ(mode, static_cast<int32_t>(index / 2));
+    }
+  }
+}
+
+TEST_F(ParameterServerTest, ListsMatchingElements) {
+  common::ErrorOr<std::vector<ParameterValue>> values = client_.List("arm.*");
+  ASSERT_TRUE(values.HasValue());
+  EXPECT_EQ(values.ValueOrDie().size(), 5u);
+  bool found = false;
+  for (const ParameterValue& value : values.ValueOrDie()) {
+    EXPECT_EQ(value.status, ParameterStatus::kOk);
+    int32_t mode;
+    if (value.path == "arm.mode") {
+      EXPECT_TRUE(value.As(&mode));
+      EXPECT_EQ(mode, 3);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+  values = client_.List("leg.*");
+  ASSERT_TRUE(values.HasValue());
+  EXPECT_TRUE(values.ValueOrDie().empty());
+}
+
+TEST_F(ParameterServerTest, PushesUpdatesOfSubscribedElements) {
+  common::ErrorOr<std::vector<ParameterValue>> statuses =
+      client_.Subscribe({"arm.mode", "arm.gain", "arm.missing"});
+  ASSERT_TRUE(statuses.HasValue());
+  ASSERT_EQ(statuses.ValueOrDie().size(), 3u);
+  EXPECT_EQ(statuses.ValueOrDie()[0].status, ParameterStatus::kOk);
+  EXPECT_EQ(statuses.ValueOrDie()[2].status, ParameterStatus::kNotFound);
+
+  *arm_->FindInt32("mode").ValueOrDie() = 11;
+  *arm_->FindInt32("mode").ValueOrDie() = 12;
+  registry_.DispatchChanges();
+  common::ErrorOr<ParameterReply> update = client_.Receive();
+  ASSERT_TRUE(update.HasValue());
+  EXPECT_EQ(update.ValueOrDie().opcode, ParameterOpcode::kUpdate);
+  EXPECT_EQ(update.ValueOrDie().sequence, 0u);
+  ASSERT_EQ(update.ValueOrDie().values.size(), 1u);
+  EXPECT_EQ(update.ValueOrDie().values[0].path, "arm.mode");
+  int32_t mode;
+  EXPECT_TRUE(update.ValueOrDie().values[0].As(&mode));
+  EXPECT_EQ(mode, 12);
+
+  // Updates arriving while awaiting a response are kept for Receive()
+  *arm_->FindDouble("gain").ValueOrDie() = 2.0;
+  registry_.DispatchChanges();
+  client_.SendGet({"arm.gain"});
+  common::ErrorOr<std::vector<ParameterValue>> values =
+      client_.Get({"arm.gain"});
+  ASSERT_TRUE(values.HasValue());
+  update = client_.Receive();
+  ASSERT_TRUE(update.HasValue());
+  EXPECT_EQ(update.ValueOrDie().opcode, ParameterOpcode::kUpdate);
+  EXPECT_EQ(update.ValueOrDie().values[0].path, "arm.gain");
+}
+
+TEST_F(ParameterServerTest, ClosesConnectionsOnMalformedRequests) {
+  using internal::ParameterFrameHeader;
+  const uint16_t set = static_cast<uint16_t>(ParameterOpcode::kSet);
+  EXPECT_TRUE(ClosesConnectionOn(
+      ParameterFrameHeader{ParameterServer::kMaxFrameSize + 1, 1, set, 0, 0},
+      ""));
+  EXPECT_TRUE(ClosesConnectionOn(ParameterFrameHeader{0, 1, 99, 0, 0}, ""));
+  EXPECT_TRUE(ClosesConnectionOn(
+      ParameterFrameHeader{0, 1,
+                           static_cast<uint16_t>(ParameterOpcode::kUpdate), 0,
+                           0},
+      ""));
+
+  // The first record of a request is not applied when a later one is
+  // truncated
+  std::string records;
+  const std::string path = "arm.mode";
+  const uint16_t path_size = static_cast<uint16_t>(path.size());
+  const uint8_t type = static_cast<uint8_t>(TypeTrait<int32_t>::type);
+  const uint8_t value_size = sizeof(int32_t);
+  const uint32_t extent = 0;
+  const int32_t mode = 9;
+  records.append(reinterpret_cast<const char*>(&path_size), sizeof(path_size));
+  records += path;
+  records.append(reinterpret_cast<const char*>(&type), sizeof(type));
+  records.append(reinterpret_cast<const char*>(&value_size),
+                 sizeof(value_size));
+  records.append(reinterpret_cast<const char*>(&extent), sizeof(extent));
+  records.append(reinterpret_cast<const char*>(&mode), sizeof(mode));
+  const std::string truncated = records.substr(0, records.size() - 1);
+  EXPECT_TRUE(
+      ClosesConnectionOn(ParameterFrameHeader{0, 1, set, 0, 2},
+                         records + truncated));
+  EXPECT_EQ(arm_->FindInt32("mode").ValueOrDie()->value(), 3);
+
+  // Other connections are still served
+  common::ErrorOr<std::vector<ParameterValue>> values =
+      client_.Get({"arm.mode"});
+  ASSERT_TRUE(values.HasValue());
+  int32_t value;
+  EXPECT_TRUE(values.ValueOrDie()[0].As(&value));
+  EXPECT_EQ(value, 3);
+}
+
+TEST_F(ParameterServerTest, ClosesConnectionsOnStop) {
+  server_.Stop();
+  EXPECT_FALSE(client_.Get({"arm.mode"}).HasValue());
+  EXPECT_NE(access(path_.c_str(), F_OK), 0);
+}
+
+}  // namespace registry
@@ -0,0 +1,454 @@
+#include "registry/recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace registry {
+
+namespace {
+
+using internal::RecordingChunkHeader;
+using internal::RecordingColumn;
+using internal::RecordingHeader;
+
+// Chunks start on a cache line of their own in the file
+constexpr std::size_t kDataAlignment = 64;
+constexpr std::size_t kColumnAlignment = 8;
+
+// Time the background thread sleeps when it misses a wake up
+constexpr std::chrono::milliseconds kIdlePeriod(10);
+
+std::size_t AlignUp(std::size_t offset, std::size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Arrays are not recorded, their values would need a column each
+bool IsRecordable(const Registry::Element& element) {
+  const std::size_t size = element.value_size();
+  return element.extent() == 0 &&
+         (size == 1 || size == 2 || size == 4 || size == 8);
+}
+
+bool WriteAll(int fd, const char* data, std::size_t size, uint64_t offset) {
+  while (size != 0) {
+    const ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+// Copies a column of values out of consecutive rows
+template <typename Word>
+void TransposeColumn(const char* rows, std::size_t row_size, uint32_t count,
+                     std::size_t row_offset, char* column) {
+  Word* out = reinterpret_cast<Word*>(column);
+  rows += row_offset;
+  for (uint32_t row = 0; row < count; ++row, rows += row_size) {
+    std::memcpy(out + row, rows, sizeof(Word));
+  }
+}
+
+}  // namespace
+
+Recorder::Recorder(uint32_t rows_per_chunk, uint32_t ring_chunks)
+    : rows_per_chunk_(std::max<uint32_t>(rows_per_chunk, 1)),
+      ring_chunks_(std::max<uint32_t>(ring_chunks, 1)),
+      row_size_(0),
+      ring_chunk_size_(0),
+      chunk_size_(0),
+      data_offset_(0),
+      fd_(-1),
+      chunk_(nullptr),
+      row_(0),
+      rows_(0),
+      dropped_rows_(0),
+      published_(0),
+      written_(0),
+      failed_(false),
+      stop_(false) {}
+
+Recorder::~Recorder() {
+  if (fd_ >= 0) {
+    Close();
+  }
+}
+
+common::ErrorOr<uint32_t> Recorder::AddElement(
+    const Registry::Element& element) {
+  if (fd_ >= 0 || !element.handle().IsValid() || !IsRecordable(element)) {
+    return common::Error::kUnavailable;
+  }
+  columns_.push_back(&element);
+  return static_cast<uint32_t>(columns_.size() - 1);
+}
+
+std::size_t Recorder::AddSubtree(const Registry& registry) {
+  std::size_t added = 0;
+  registry.ForEachElement([this, &added](const Registry::Element& element) {
+    if (AddElement(element).HasValue()) {
+      ++added;
+    }
+  });
+  return added;
+}
+
+common::ErrorOr<std::size_t> Recorder::Open(const std::string& path) {
+  if (fd_ >= 0) {
+    return common::Error::kUnavailable;
+  }
+
+  // Lay out the rows of the ring, larger values first so that every value is
+  // naturally aligned, and the columns of a file chunk in the order the
+  // elements were added
+  std::vector<std::size_t> order(columns_.size());
+  for (std::size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [this](std::size_t lhs, std::size_t rhs) {
+                     return columns_[lhs]->value_size() >
+                            columns_[rhs]->value_size();
+                   });
+  std::vector<std::size_t> row_offsets(columns_.size());
+  std::size_t row_size = sizeof(int64_t);
+  for (std::size_t index : order) {
+    row_offsets[index] = row_size;
+    row_size += columns_[index]->value_size();
+  }
+  row_size_ = AlignUp(row_size, kColumnAlignment);
+  ring_chunk_size_ = sizeof(RecordingChunkHeader) + rows_per_chunk_ * row_size_;
+
+  for (std::vector<Slot>& group : groups_) {
+    group.clear();
+  }
+  layout_.clear();
+  std::vector<RecordingColumn> table;
+  table.reserve(columns_.size());
+  std::string names;
+  const std::size_t names_offset =
+      sizeof(RecordingHeader) + columns_.size() * sizeof(RecordingColumn);
+  std::size_t offset = sizeof(RecordingChunkHeader);
+  layout_.push_back(Column{0, offset, sizeof(int64_t)});
+  offset += std::size_t{rows_per_chunk_} * sizeof(int64_t);
+  for (std::size_t index = 0; index < columns_.size(); ++index) {
+    const Registry::Element* element = columns_[index];
+    const TypeEnum type = element->type();
+    Group group = kOther;
+    if (type == TypeTrait<int32_t>::type) {
+      group = kInt32;
+    } else if (type == TypeTrait<uint32_t>::type) {
+      group = kUnsignedInt32;
+    } else if (type == TypeTrait<int64_t>::type) {
+      group = kInt64;
+    } else if (type == TypeTrait<uint64_t>::type) {
+      group = kUnsignedInt64;
+    } else if (type == TypeTrait<bool>::type) {
+      group = kBool;
+    } else if (type == TypeTrait<char>::type) {
+      group = kChar;
+    } else if (type == TypeTrait<float>::type) {
+      group = kFloat;
+    } else if (type == TypeTrait<double>::type) {
+      group = kDouble;
+    }
+    groups_[group].push_back(Slot{element, row_offsets[index]});
+    layout_.push_back(
+        Column{row_offsets[index], offset, element->value_size()});
+    const std::string_view name = element->FullName();
+    table.push_back(RecordingColumn{
+        static_cast<uint32_t>(names_offset + names.size()),
+        static_cast<uint16_t>(name.size()), static_cast<uint8_t>(type),
+        static_cast<uint8_t>(element->value_size()), offset});
+    names.append(name);
+    offset += AlignUp(rows_per_chunk_ * element->value_size(),
+                      kColumnAlignment);
+  }
+  chunk_size_ = offset;
+  data_offset_ = AlignUp(names_offset + names.size(), kDataAlignment);
+
+  std::string head(data_offset_, '\0');
+  const RecordingHeader header{kMagic,           kVersion,
+                               static_cast<uint32_t>(columns_.size()),
+                               rows_per_chunk_,  chunk_size_,
+                               data_offset_};
+  std::memcpy(&head[0], &header, sizeof(header));
+  if (!table.empty()) {
+    std::memcpy(&head[sizeof(header)], table.data(),
+                table.size() * sizeof(RecordingColumn));
+  }
+  names.copy(&head[names_offset], names.size());
+
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return common::Error::kUnavailable;
+  }
+  if (!WriteAll(fd, head.data(), head.size(), 0)) {
+    close(fd);
+    return common::Error::kUnavailable;
+  }
+  fd_ = fd;
+  ring_.reset(new uint64_t[ring_chunks_ * ring_chunk_size_ / sizeof(uint64_t)]);
+  chunk_buffer_.reset(new uint64_t[chunk_size_ / sizeof(uint64_t)]());
+  chunk_ = nullptr;
+  row_ = 0;
+  rows_ = 0;
+  dropped_rows_ = 0;
+  published_.store(0, std::memory_order_relaxed);
+  written_.store(0, std::memory_order_relaxed);
+  failed_.store(false, std::memory_order_relaxed);
+  stop_ = false;
+  thread_ = std::thread(&Recorder::Run, this);
+  return columns_.size();
+}
+
+bool Recorder::Record() {
+  return Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+}
+
+template <typename T>
+void Recorder::RecordGroup(Group group, char* row) const {
+  for (const Slot& slot : groups_[group]) {
+    const T value =
+        static_cast<const Registry::ElementTemplate<T>*>(slot.element)->value();
+    std::memcpy(row + slot.offset, &value, sizeof(T));
+  }
+}
+
+bool Recorder::Record(int64_t timestamp) {
+  if (fd_ < 0) {
+    return false;
+  }
+  if (row_ == 0) {
+    // Starting a chunk, which must have been written out since its last use
+    const uint64_t published = published_.load(std::memory_order_relaxed);
+    if (published - written_.load(std::memory_order_acquire) >= ring_chunks_) {
+      ++dropped_rows_;
+      return false;
+    }
+    chunk_ = RingChunk(published);
+  }
+  char* row = chunk_ + sizeof(RecordingChunkHeader) + row_ * row_size_;
+  std::memcpy(row, &timestamp, sizeof(timestamp));
+  RecordGroup<int32_t>(kInt32, row);
+  RecordGroup<uint32_t>(kUnsignedInt32, row);
+  RecordGroup<int64_t>(kInt64, row);
+  RecordGroup<uint64_t>(kUnsignedInt64, row);
+  RecordGroup<bool>(kBool, row);
+  RecordGroup<char>(kChar, row);
+  RecordGroup<float>(kFloat, row);
+  RecordGroup<double>(kDouble, row);
+  for (const Slot& slot : groups_[kOther]) {
+    slot.element->ExtractBytes(row + slot.offset);
+  }
+  ++rows_;
+  if (++row_ == rows_per_chunk_) {
+    Publish();
+  }
+  return true;
+}
+
+void Recorder::Publish() {
+  const RecordingChunkHeader header{row_, 0, dropped_rows_};
+  std::memcpy(chunk_, &header, sizeof(header));
+  row_ = 0;
+  published_.store(published_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  // Notifying without the lock never blocks; a wake up missed by the
+  // background thread only delays the write by kIdlePeriod
+  wake_.notify_one();
+}
+
+void Recorder::Transpose(const char* rows, char* chunk) const {
+  RecordingChunkHeader header;
+  std::memcpy(&header, rows, sizeof(header));
+  std::memcpy(chunk, &header, sizeof(header));
+  rows += sizeof(header);
+  for (const Column& column : layout_) {
+    switch (column.value_size) {
+      case 1:
+        TransposeColumn<uint8_t>(rows, row_size_, header.row_count,
+                                 column.row_offset,
+                                 chunk + column.chunk_offset);
+        break;
+      case 2:
+        TransposeColumn<uint16_t>(rows, row_size_, header.row_count,
+                                  column.row_offset,
+                                  chunk + column.chunk_offset);
+        break;
+      case 4:
+        TransposeColumn<uint32_t>(rows, row_size_, header.row_count,
+                                  column.row_offset,
+                                  chunk + column.chunk_offset);
+        break;
+      default:
+        TransposeColumn<uint64_t>(rows, row_size_, header.row_count,
+                                  column.row_offset,
+                                  chunk + column.chunk_offset);
+        break;
+    }
+  }
+}
+
+void Recorder::Run() {
+  char* chunk = reinterpret_cast<char*>(chunk_buffer_.get());
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait_for(lock, kIdlePeriod, [this]() {
+      return stop_ || published_.load(std::memory_order_acquire) !=
+                          written_.load(std::memory_order_relaxed);
+    });
+    const bool stop = stop_;
+    lock.unlock();
+    const uint64_t published = published_.load(std::memory_order_acquire);
+    for (uint64_t written = written_.load(std::memory_order_relaxed);
+         written < published; ++written) {
+      Transpose(RingChunk(written), chunk);
+      // The ring chunk is free again once transposed
+      written_.store(written + 1, std::memory_order_release);
+      if (!WriteAll(fd_, chunk, chunk_size_,
+                    data_offset_ + written * chunk_size_)) {
+        failed_.store(true, std::memory_order_relaxed);
+      }
+    }
+    if (stop) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
+common::ErrorOr<uint64_t> Recorder::Close() {
+  if (fd_ < 0) {
+    return common::Error::kUnavailable;
+  }
+  if (row_ != 0) {
+    Publish();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  const bool failed =
+      failed_.load(std::memory_order_relaxed) || close(fd_) != 0;
+  fd_ = -1;
+  ring_.reset();
+  if (failed) {
+    return common::Error::kUnavailable;
+  }
+  return rows_;
+}
+
+RecordingReader::RecordingReader()
+    : memory_(nullptr),
+      size_(0),
+      data_(nullptr),
+      rows_(0),
+      dropped_rows_(0),
+      rows_per_chunk_(1),
+      chunk_size_(0) {}
+
+RecordingReader::~RecordingReader() {
+  if (memory_ != nullptr) {
+    munmap(const_cast<void*>(memory_), size_);
+  }
+}
+
+common::ErrorOr<uint64_t> RecordingReader::Open(const std::string& path) {
+  if (memory_ != nullptr) {
+    return common::Error::kUnavailable;
+  }
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return common::Error::kUnavailable;
+  }
+  struct stat status;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<std::size_t>(status.st_size) >= sizeof(RecordingHeader)) {
+    memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return common::Error::kUnavailable;
+  }
+  const std::size_t size = status.st_size;
+
+  // Validate the whole table before trusting any of it
+  const char* bytes = static_cast<const char*>(memory);
+  const RecordingHeader* header =
+      reinterpret_cast<const RecordingHeader*>(bytes);
+  const std::size_t table_end =
+      sizeof(RecordingHeader) +
+      std::size_t{header->column_count} * sizeof(RecordingColumn);
+  const std::size_t timestamps_end =
+      sizeof(RecordingChunkHeader) +
+      std::size_t{header->rows_per_chunk} * sizeof(int64_t);
+  bool valid = header->magic == Recorder::kMagic &&
+               header->version == Recorder::kVersion &&
+               header->rows_per_chunk != 0 &&
+               header->chunk_size >= timestamps_end &&
+               header->chunk_size % kColumnAlignment == 0 &&
+               header->data_offset % kDataAlignment == 0 &&
+               table_end <= header->data_offset && header->data_offset <= size;
+  const RecordingColumn* columns =
+      reinterpret_cast<const RecordingColumn*>(bytes + sizeof(RecordingHeader));
+  for (uint32_t index = 0; valid && index < header->column_count; ++index) {
+    const RecordingColumn& column = columns[index];
+    const std::size_t value_size = column.value_size;
+    valid = (value_size == 1 || value_size == 2 || value_size == 4 ||
+             value_size == 8) &&
+            column.offset % kColumnAlignment == 0 &&
+            column.offset >= timestamps_end &&
+            column.offset + header->rows_per_chunk * value_size <=
+                header->chunk_size &&
+            column.name_offset + std::size_t{column.name_size} <=
+                header->data_offset;
+    if (valid) {
+      columns_.emplace(
+          std::string_view(bytes + column.name_offset, column.name_size),
+          &column);
+    }
+  }
+  uint64_t rows = 0;
+  uint64_t dropped_rows = 0;
+  if (valid) {
+    const uint64_t chunks = (size - header->data_offset) / header->chunk_size;
+    if (chunks != 0) {
+      const RecordingChunkHeader* last =
+          reinterpret_cast<const RecordingChunkHeader*>(
+              bytes + header->data_offset + (chunks - 1) * header->chunk_size);
+      valid = last->row_count != 0 && last->row_count <= header->rows_per_chunk;
+      rows = (chunks - 1) * header->rows_per_chunk + last->row_count;
+      dropped_rows = last->dropped_rows;
+    }
+  }
+  if (!valid) {
+    columns_.clear();
+    munmap(memory, size);
+    return common::Error::kUnavailable;
+  }
+  memory_ = memory;
+  size_ = size;
+  data_ = bytes + header->data_offset;
+  rows_ = rows;
+  dropped_rows_ = dropped_rows;
+  rows_per_chunk_ = header->rows_per_chunk;
+  chunk_size_ = header->chunk_size;
+  return rows_;
+}
+
+}  // namespace registry
@@ -0,0 +1,308 @@
+#ifndef REGISTRY_RECORDER_H_
+#define REGISTRY_RECORDER_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/error_or.h"
+#include "registry/registry.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Layout of a recording: the header, a table describing every column, the
+/// dotted paths of the recorded elements, then fixed size chunks starting at
+/// data_offset. A chunk holds up to rows_per_chunk rows stored column by
+/// column: the chunk header, the timestamps, then the values of every
+/// element, each column starting on 8 bytes
+struct RecordingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t column_count;
+  uint32_t rows_per_chunk;
+  uint64_t chunk_size;
+  uint64_t data_offset;
+};
+
+struct RecordingColumn {
+  uint32_t name_offset;
+  uint16_t name_size;
+  uint8_t type;
+  uint8_t value_size;
+  // Offset of the column within every chunk
+  uint64_t offset;
+};
+
+struct RecordingChunkHeader {
+  uint32_t row_count;
+  uint32_t reserved;
+  // Rows dropped since the start of the recording
+  uint64_t dropped_rows;
+};
+
+}  // namespace internal
+
+/// @class Recorder
+/// Records the values of a set of elements to a file at a high rate, one
+/// column per element and one row per call to Record().
+///
+/// Rows are packed one after the other into chunks of a ring buffer
+/// preallocated by Open(). A background thread turns full chunks into
+/// columns and writes them to the file. Recording copies values only, so it
+/// never blocks or allocates: when the file cannot keep up and the ring is
+/// full, rows are dropped and counted instead. Strings and arrays are not
+/// recorded
+class Recorder {
+ public:
+  static constexpr uint32_t kMagic = 0x4c474552;  // "REGL"
+  static constexpr uint32_t kVersion = 1;
+
+  /// @param[in] rows_per_chunk rows held by every chunk of the file
+  /// @param[in] ring_chunks chunks buffered between the recording thread and
+  /// the file
+  explicit Recorder(uint32_t rows_per_chunk = 256, uint32_t ring_chunks = 4);
+
+  /// Closes the recording
+  ~Recorder();
+
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  /// Adds a column recording the values of an element, which must outlive
+  /// the recorder
+  /// @param[in] element element held by a registry
+  /// @return index of the column, else kUnavailable if the recording is open
+  /// or the values of the element cannot be recorded
+  common::ErrorOr<uint32_t> AddElement(const Registry::Element& element);
+
+  /// Adds a column for every element currently held by registry or any of
+  /// its descendants whose values can be recorded
+  /// @return number of columns added
+  std::size_t AddSubtree(const Registry& registry);
+
+  /// Creates or truncates the file at path, writes the table of the columns
+  /// and starts the background thread
+  /// @param[in] path path of the recording file
+  /// @return number of columns, else kUnavailable if the recording is
+  /// already open or the file cannot be written
+  common::ErrorOr<std::size_t> Open(const std::string& path);
+
+  /// Appends a row holding the current value of every column, timestamped
+  /// with the steady clock in nanoseconds. Must not be called concurrently
+  /// with itself
+  /// @return false if the recording is not open or the row was dropped
+  bool Record();
+
+  /// Same as Record() with a timestamp given by the caller
+  bool Record(int64_t timestamp);
+
+  /// Writes the rows recorded so far, stops the background thread and closes
+  /// the file. The recording may then be opened again
+  /// @return number of rows recorded, else kUnavailable if the recording is
+  /// not open or a write to the file failed
+  common::ErrorOr<uint64_t> Close();
+
+  std::size_t column_count() const { return columns_.size(); }
+
+  /// @return rows dropped by the recording currently or last open
+  uint64_t dropped_rows() const { return dropped_rows_; }
+
+ private:
+  // Columns grouped by value type so that every group is copied by a tight,
+  // fully typed loop, as for snapshots. Enums go through ExtractBytes
+  enum Group {
+    kInt32,
+    kUnsignedInt32,
+    kInt64,
+    kUnsignedInt64,
+    kBool,
+    kChar,
+    kFloat,
+    kDouble,
+    kOther,
+    kGroupCount,
+  };
+
+  struct Slot {
+    const Registry::Element* element;
+    // Offset of the value within a row
+    std::size_t offset;
+  };
+
+  // Where a column is taken from in a row and written to in a file chunk
+  struct Column {
+    std::size_t row_offset;
+    std::size_t chunk_offset;
+    std::size_t value_size;
+  };
+
+  template <typename T>
+  void RecordGroup(Group group, char* row) const;
+
+  // Hands the chunk being filled over to the background thread
+  void Publish();
+
+  void Run();
+
+  // Turns a chunk of the ring into a chunk of the file
+  void Transpose(const char* rows, char* chunk) const;
+
+  char* RingChunk(uint64_t index) const {
+    return reinterpret_cast<char*>(ring_.get()) +
+           (index % ring_chunks_) * ring_chunk_size_;
+  }
+
+  const uint32_t rows_per_chunk_;
+  const uint32_t ring_chunks_;
+  std::vector<const Registry::Element*> columns_;
+  std::array<std::vector<Slot>, kGroupCount> groups_;
+  // The timestamps followed by the columns of the elements
+  std::vector<Column> layout_;
+  std::size_t row_size_;
+  std::size_t ring_chunk_size_;
+  std::size_t chunk_size_;
+  uint64_t data_offset_;
+
+  int fd_;
+  std::unique_ptr<uint64_t[]> ring_;
+  // Chunk of the file being assembled by the background thread
+  std::unique_ptr<uint64_t[]> chunk_buffer_;
+  // Chunk of the ring filled by the recording thread and its next row
+  char* chunk_;
+  uint32_t row_;
+  uint64_t rows_;
+  uint64_t dropped_rows_;
+
+  // Chunks handed over by the recording thread, and written to the file
+  std::atomic<uint64_t> published_;
+  std::atomic<uint64_t> written_;
+  std::atomic<bool> failed_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  std::thread thread_;
+};
+
+/// @class RecordedColumn
+/// Read-only view of the values of one column of a recording, read straight
+/// from the mapped file
+template <typename T>
+class RecordedColumn {
+ public:
+  /// @return number of rows
+  uint64_t size() const { return rows_; }
+
+  T operator[](uint64_t row) const {
+    T value;
+    std::memcpy(&value,
+                data_ + (row / rows_per_chunk_) * chunk_size_ + offset_ +
+                    (row % rows_per_chunk_) * sizeof(T),
+                sizeof(T));
+    return value;
+  }
+
+  /// Calls function(values, count) for every chunk in order, where values
+  /// points to the count values of the column held by the chunk
+  template <typename Function>
+  void ForEachChunk(Function function) const {
+    const char* chunk = data_;
+    for (uint64_t row = 0; row < rows_; row += rows_per_chunk_) {
+      const internal::RecordingChunkHeader* header =
+          reinterpret_cast<const internal::RecordingChunkHeader*>(chunk);
+      function(reinterpret_cast<const T*>(chunk + offset_),
+               static_cast<std::size_t>(header->row_count));
+      chunk += chunk_size_;
+    }
+  }
+
+ private:
+  friend class RecordingReader;
+
+  RecordedColumn(const char* data, uint64_t rows, uint32_t rows_per_chunk,
+                 std::size_t chunk_size, std::size_t offset)
+      : data_(data),
+        rows_(rows),
+        rows_per_chunk_(rows_per_chunk),
+        chunk_size_(chunk_size),
+        offset_(offset) {}
+
+  const char* data_;
+  uint64_t rows_;
+  uint32_t rows_per_chunk_;
+  std::size_t chunk_size_;
+  std::size_t offset_;
+};
+
+/// @class RecordingReader
+/// Read-only mapping of a file written by a Recorder. Columns are read in
+/// place, so reading one column touches none of the others. A file still
+/// being recorded is read up to its last chunk written when it was opened
+class RecordingReader {
+ public:
+  RecordingReader();
+  ~RecordingReader();
+
+  RecordingReader(const RecordingReader&) = delete;
+  RecordingReader& operator=(const RecordingReader&) = delete;
+
+  /// Maps the file at path read-only
+  /// @param[in] path path of the recording
+  /// @return number of rows, else kUnavailable if already open, or if the
+  /// file cannot be mapped or does not hold a valid recording
+  common::ErrorOr<uint64_t> Open(const std::string& path);
+
+  uint64_t row_count() const { return rows_; }
+  std::size_t column_count() const { return columns_.size(); }
+
+  /// @return rows dropped by the recorder before the last row read
+  uint64_t dropped_rows() const { return dropped_rows_; }
+
+  /// @return timestamps of the rows
+  RecordedColumn<int64_t> Timestamps() const {
+    return RecordedColumn<int64_t>(data_, rows_, rows_per_chunk_, chunk_size_,
+                                   sizeof(internal::RecordingChunkHeader));
+  }
+
+  /// Search for the column of an element
+  /// @param[in] path dotted path of the element starting at its root registry
+  /// @return view of the column if found and of type T, else kNotFound
+  template <typename T>
+  common::ErrorOr<RecordedColumn<T>> Find(std::string_view path) const {
+    auto column = columns_.find(path);
+    if (column == columns_.end() ||
+        column->second->type != static_cast<uint8_t>(TypeTrait<T>::type) ||
+        column->second->value_size != sizeof(T)) {
+      return common::Error::kNotFound;
+    }
+    return RecordedColumn<T>(data_, rows_, rows_per_chunk_, chunk_size_,
+                             column->second->offset);
+  }
+
+ private:
+  const void* memory_;
+  std::size_t size_;
+  // First chunk of the recording
+  const char* data_;
+  uint64_t rows_;
+  uint64_t dropped_rows_;
+  uint32_t rows_per_chunk_;
+  std::size_t chunk_size_;
+  std::unordered_map<std::string_view, const internal::RecordingColumn*>
+      columns_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_RECORDER_H_
@@ -0,0 +1,150 @@
+#include "registry/recorder.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/enum_traits.h"
+
+namespace registry {
+
+enum class RecorderEnum : uint8_t { kFirst, kSecond };
+
+}  // namespace registry
+
+namespace common {
+
+template <>
+constexpr registry::RecorderEnum
+EnumTrait<registry::RecorderEnum>::default_value() {
+  return registry::RecorderEnum::kFirst;
+}
+
+}  // namespace common
+
+namespace registry {
+
+class RecorderTest : public ::testing::Test {
+ public:
+  RecorderTest()
+      : path_(::testing::TempDir() + "recorder_test_" +
+              std::to_string(getpid())) {}
+  ~RecorderTest() override { std::remove(path_.c_str()); }
+
+ protected:
+  const std::string path_;
+};
+
+TEST_F(RecorderTest, RecordsAndReadsColumns) {
+  Registry root("root");
+  Registry* child = root.AddChildRegistry("child").ValueOrDie();
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  Registry::Int32* count = child->AddInt32("count").ValueOrDie();
+  Registry::Bool* flag = child->AddBoolean("flag").ValueOrDie();
+  Registry::Enum<RecorderEnum>* mode =
+      child->AddEnum<RecorderEnum>("mode").ValueOrDie();
+  Registry::String* label = child->AddString("label", "text").ValueOrDie();
+
+  // Enough buffered chunks that no row is dropped
+  constexpr int kRows = 1000;
+  Recorder recorder(16, kRows / 16 + 1);
+  EXPECT_FALSE(recorder.AddElement(*label).HasValue());
+  EXPECT_EQ(recorder.AddElement(*value).ValueOrDie(), 0u);
+  EXPECT_EQ(recorder.AddSubtree(*child), 3u);
+  EXPECT_FALSE(recorder.Record(0));
+  ASSERT_EQ(recorder.Open(path_).ValueOrDie(), 4u);
+  EXPECT_FALSE(recorder.Open(path_).HasValue());
+  EXPECT_FALSE(recorder.AddElement(*value).HasValue());
+
+  for (int row = 0; row < kRows; ++row) {
+    *value = row * 0.5;
+    *count = -row;
+    *flag = row % 3 == 0;
+    *mode = row % 2 == 0 ? RecorderEnum::kFirst : RecorderEnum::kSecond;
+    ASSERT_TRUE(recorder.Record(1000 + row));
+  }
+  EXPECT_EQ(recorder.Close().ValueOrDie(), static_cast<uint64_t>(kRows));
+  EXPECT_EQ(recorder.dropped_rows(), 0u);
+
+  RecordingReader reader;
+  ASSERT_EQ(reader.Open(path_).ValueOrDie(), static_cast<uint64_t>(kRows));
+  EXPECT_EQ(reader.column_count(), 4u);
+  EXPECT_EQ(reader.dropped_rows(), 0u);
+  RecordedColumn<int64_t> timestamps = reader.Timestamps();
+  RecordedColumn<double> values =
+      reader.Find<double>("root.value").ValueOrDie();
+  RecordedColumn<int32_t> counts =
+      reader.Find<int32_t>("root.child.count").ValueOrDie();
+  RecordedColumn<bool> flags =
+      reader.Find<bool>("root.child.flag").ValueOrDie();
+  RecordedColumn<RecorderEnum> modes =
+      reader.Find<RecorderEnum>("root.child.mode").ValueOrDie();
+  ASSERT_EQ(values.size(), static_cast<uint64_t>(kRows));
+  for (int row = 0; row < kRows; ++row) {
+    EXPECT_EQ(timestamps[row], 1000 + row);
+    EXPECT_EQ(values[row], row * 0.5);
+    EXPECT_EQ(counts[row], -row);
+    EXPECT_EQ(flags[row], row % 3 == 0);
+    EXPECT_EQ(modes[row],
+              row % 2 == 0 ? RecorderEnum::kFirst : RecorderEnum::kSecond);
+  }
+
+  // Whole chunks of a column are contiguous, the last one partially filled
+  int64_t row = 0;
+  values.ForEachChunk([&row](const double* chunk, std::size_t size) {
+    for (std::size_t index = 0; index < size; ++index, ++row) {
+      EXPECT_EQ(chunk[index], row * 0.5);
+    }
+  });
+  EXPECT_EQ(row, kRows);
+
+  // Lookups are type checked
+  EXPECT_FALSE(reader.Find<int64_t>("root.value").HasValue());
+  EXPECT_FALSE(reader.Find<std::string>("root.child.label").HasValue());
+  EXPECT_FALSE(reader.Find<double>("root.missing").HasValue());
+}
+
+// Rows that do not fit in the ring are dropped rather than waited for, and
+// every other row reaches the file
+TEST_F(RecorderTest, DropsRowsWhenRingIsFull) {
+  Registry root("root");
+  Registry::Int64* counter = root.AddInt64("counter").ValueOrDie();
+  Recorder recorder(1, 1);
+  recorder.AddSubtree(root);
+  ASSERT_TRUE(recorder.Open(path_).HasValue());
+  constexpr int kRows = 10000;
+  uint64_t recorded = 0;
+  for (int row = 0; row < kRows; ++row) {
+    *counter = row;
+    recorded += recorder.Record() ? 1 : 0;
+  }
+  EXPECT_EQ(recorder.Close().ValueOrDie(), recorded);
+  EXPECT_EQ(recorded + recorder.dropped_rows(), static_cast<uint64_t>(kRows));
+
+  RecordingReader reader;
+  ASSERT_EQ(reader.Open(path_).ValueOrDie(), recorded);
+  RecordedColumn<int64_t> counters =
+      reader.Find<int64_t>("root.counter").ValueOrDie();
+  RecordedColumn<int64_t> timestamps = reader.Timestamps();
+  for (uint64_t row = 1; row < recorded; ++row) {
+    EXPECT_LT(counters[row - 1], counters[row]);
+    EXPECT_LE(timestamps[row - 1], timestamps[row]);
+  }
+}
+
+TEST_F(RecorderTest, RejectsInvalidFiles) {
+  RecordingReader reader;
+  EXPECT_FALSE(reader.Open(path_).HasValue());
+
+  FILE* file = std::fopen(path_.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  const std::string garbage(256, 'x');
+  std::fwrite(garbage.data(), 1, garbage.size(), file);
+  std::fclose(file);
+  EXPECT_FALSE(reader.Open(path_).HasValue());
+}
+
+}  // namespace registry
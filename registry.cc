@@ -1,122 +1,315 @@
 #include "registry/registry.h"
 
 #include <algorithm>
+#include <array>
 #include <memory>
 
 namespace registry {
 
 namespace internal {
 
-constexpr char kNamespaceCharacter = '.';
-
-std::string RemoveReservedCharacters(const std::string& name,
-                                     const char* reserved_chars) {
+// Epoch of elements that do not belong to a tree yet
+const std::atomic<uint64_t> kDetachedEpoch(0);
+
+// Interns name with its reserved characters removed. Names are only copied
+// when they hold reserved characters
+Symbol InternName(const std::string& name) {
+  const bool clean = std::none_of(name.begin(), name.end(), [](char character) {
+    return kReservedCharacterTable[static_cast<unsigned char>(character)];
+  });
+  if (clean) {
+    return GlobalSymbolTable().Intern(name);
+  }
   std::string corrected_name(name);
   corrected_name.erase(
-      std::remove_if(
-          corrected_name.begin(), corrected_name.end(),
-          [&reserved_chars](char string_char) {
-            return std::find(reserved_chars,
-                             reserved_chars +
-                                 std::char_traits<char>::length(reserved_chars),
-                             string_char) !=
-                   (reserved_chars +
-                    std::char_traits<char>::length(reserved_chars));
-          }),
+      std::remove_if(corrected_name.begin(), corrected_name.end(),
+                     [](char string_char) {
+                       const unsigned char index = string_char;
+                       return kReservedCharacterTable[index];
+                     }),
       corrected_name.end());
   // TODO handle cases where the name is empty
-  return corrected_name;
+  return GlobalSymbolTable().Intern(corrected_name);
 }
 
 }  // namespace internal
 
+namespace {
+
+// Spreads every bit of hash over the whole word, as the finaliser of
+// SplitMix64 does
+uint64_t MixHash(uint64_t hash) {
+  hash = (hash ^ (hash >> 31)) * 0x7fb5d329728ea185ull;
+  hash = (hash ^ (hash >> 27)) * 0x81dadef4bc2dd44dull;
+  return hash ^ (hash >> 33);
+}
+
+// Hashes the name, type, size and value of an element. Values are hashed
+// bit for bit, strings by content, as Diff() compares them
+uint64_t HashElement(const Registry::Element& element) {
+  const uint64_t type = static_cast<uint32_t>(element.type());
+  uint64_t hash = internal::HashName(element.name());
+  hash = MixHash(hash ^ (type << 32 | element.extent()));
+  uint64_t value = 0;
+  if (element.value_size() != 0) {
+    // Kept per thread so that hashing does not allocate once grown
+    thread_local std::vector<uint64_t> words;
+    const std::size_t count = (element.value_size() + 7) / 8;
+    if (words.size() < count) {
+      words.resize(count);
+    }
+    element.ExtractBytes(words.data());
+    value = internal::HashName(std::string_view(
+        reinterpret_cast<const char*>(words.data()), element.value_size()));
+  } else {
+    thread_local std::string text;
+    if (element.Extract(&text)) {
+      value = internal::HashName(text);
+    }
+  }
+  return MixHash(hash ^ value);
+}
+
+}  // namespace
+
 Registry::Element::Element(const std::string& name, TypeEnum type)
-    : name_(internal::RemoveReservedCharacters(
-          name, internal::kRegistryReservedChars)),
-      type_(type),
-      registry_(nullptr) {}
+    : Element(name, type, 0) {}
+
+Registry::Element::Element(const std::string& name, TypeEnum type,
+                           std::size_t value_size, std::size_t extent)
+    : type_(type),
+      value_size_(value_size),
+      extent_(extent),
+      registry_(nullptr),
+      stats_id_(internal::kInstrumented ? internal::NextStatsId() : 0),
+      tree_epoch_(&internal::kDetachedEpoch),
+      version_(0),
+      watchers_(0),
+      changed_(false),
+      next_changed_(nullptr),
+      name_(internal::InternName(name)) {
+  full_name_.Reference(internal::GlobalSymbolTable().text(name_));
+}
 
 Registry::Element::~Element() {}
 
-std::string Registry::Element::FullName() const {
-  if (registry_ == nullptr) {
-    return name();
+void Registry::Element::QueueChange() {
+  if (changed_.exchange(true, std::memory_order_acq_rel)) {
+    return;
   }
-  return registry_->FullName() + "." + name();
+  std::atomic<Element*>& changed_elements = registry_->root_->changed_elements_;
+  Element* head = changed_elements.load(std::memory_order_relaxed);
+  do {
+    next_changed_ = head;
+  } while (!changed_elements.compare_exchange_weak(
+      head, this, std::memory_order_release, std::memory_order_relaxed));
 }
 
-Registry::Registry(const std::string& name)
-    : name_(internal::RemoveReservedCharacters(
-          name, internal::kRegistryReservedChars)),
-      parent_(nullptr) {}
+Registry::Registry(const std::string& name) : Registry(name, nullptr) {}
+
+Registry::Registry(const std::string& name, Arena* arena)
+    : parent_(nullptr),
+      root_(this),
+      arena_(arena),
+      name_(internal::InternName(name)),
+      stats_id_(internal::kInstrumented ? internal::NextStatsId() : 0),
+      epoch_(1),
+      content_changed_(true),
+      content_hash_(0),
+      subtree_watchers_(0),
+      next_subscription_id_(1),
+      changed_elements_(nullptr) {
+  full_name_.Reference(internal::GlobalSymbolTable().text(name_));
+}
 
-std::string Registry::FullName() const {
-  if (parent_ == nullptr) {
-    return name();
+bool Registry::Contains(const Element& element) const {
+  for (Registry const* registry = element.registry(); registry != nullptr;
+       registry = registry->parent_) {
+    if (registry == this) {
+      return true;
+    }
   }
-  return parent_->FullName() + "." + name();
+  return false;
 }
 
-common::ErrorOr<Registry*> Registry::FindChildRegistry(
-    const std::string& name) {
-  ChildMap::iterator it = child_registries_.find(name);
-  if (it != child_registries_.end()) {
-    return it->second.get();
+void Registry::CollectElementRuns(std::vector<ElementRun>* runs) const {
+  const std::size_t size = element_list_.size();
+  for (std::size_t begin = 0; begin < size; begin += kElementRunSize) {
+    runs->push_back(
+        ElementRun{this, begin, std::min(size, begin + kElementRunSize)});
+  }
+  child_registries_.ForEach(
+      [runs](const Registry& child) { child.CollectElementRuns(runs); });
+}
+
+common::ErrorOr<Registry*> Registry::FindChildRegistry(std::string_view name) {
+  internal::LookupRecorder<> recorder(LookupKind::kName, stats_id_);
+  if (Registry* child = FindChild(name)) {
+    recorder.Found(child->stats_id_);
+    return child;
   }
   return common::Error::kNotFound;
 }
 
+Registry* Registry::FindChild(std::string_view name) const {
+  const internal::Symbol symbol = internal::GlobalSymbolTable().Find(name);
+  if (symbol == internal::kInvalidSymbol) {
+    return nullptr;
+  }
+  return child_registries_.Find(symbol);
+}
+
 common::ErrorOr<Registry*> Registry::AddChildRegistry(const std::string& name) {
-  auto child = std::make_unique<Registry>(name);
-  std::pair<ChildMap::iterator, bool> ref =
-      child_registries_.emplace(child->name(), std::move(child));
+  std::pair<Registry*, bool> ref =
+      InsertChildRegistry(CreateNode<Registry>(name));
   if (ref.second) {
-    ref.first->second->parent_ = this;
-    return ref.first->second.get();
+    return ref.first;
   }
   return common::Error::kUnavailable;
 }
 
 common::ErrorOr<Registry::Element*> Registry::FindElement(
-    const std::string& name) {
-  ElementMap::iterator it = elements_.find(name);
-  if (it != elements_.end()) {
-    return it->second.get();
+    std::string_view name) {
+  internal::LookupRecorder<> recorder(LookupKind::kName, stats_id_);
+  if (Element* element = FindOwnElement(name)) {
+    recorder.Found(element->stats_id_);
+    return element;
   }
   return common::Error::kNotFound;
 }
 
+Registry::Element* Registry::FindOwnElement(std::string_view name) const {
+  const internal::Symbol symbol = internal::GlobalSymbolTable().Find(name);
+  if (symbol == internal::kInvalidSymbol) {
+    return nullptr;
+  }
+  return elements_.Find(symbol);
+}
+
 common::ErrorOr<Registry::Element*> Registry::FindElementByExtendedName(
-    const std::string& search_name) {
-  // Break up the string using the namespace separator (periods)
-  auto it = std::find(search_name.cbegin(), search_name.cend(),
-                      internal::kNamespaceCharacter);
-  if (it == search_name.cend()) {
-    return FindElement(search_name);
-  }
-  std::string registry_name(search_name.cbegin(), it);
-  if (registry_name == name()) {
-    return FindElementByExtendedName(std::string(++it, search_name.cend()));
-  }
-  common::ErrorOr<Registry*> child_registry = FindChildRegistry(registry_name);
-  if (!child_registry.HasValue()) {
-    return common::Error::kNotFound;
+    std::string_view search_name) {
+  internal::LookupRecorder<> recorder(LookupKind::kExtendedName, stats_id_);
+  // Full names resolve with a single lookup in the flat path index
+  if (root_ == this) {
+    if (Element* element = path_index_.Find(search_name)) {
+      recorder.Found(element->stats_id_);
+      return element;
+    }
+  }
+  // Walk down the tree one namespace separator (period) at a time. Segments
+  // are views into search_name so no strings are built along the way
+  Registry* registry = this;
+  std::string_view::size_type separator =
+      search_name.find(internal::kNamespaceCharacter);
+  while (separator != std::string_view::npos) {
+    std::string_view registry_name = search_name.substr(0, separator);
+    search_name.remove_prefix(separator + 1);
+    if (registry_name != registry->name()) {
+      registry = registry->FindChild(registry_name);
+      if (registry == nullptr) {
+        return common::Error::kNotFound;
+      }
+    }
+    separator = search_name.find(internal::kNamespaceCharacter);
+  }
+  if (Element* element = registry->FindOwnElement(search_name)) {
+    recorder.Found(element->stats_id_);
+    return element;
   }
-  return child_registry.ValueOrDie()->FindElementByExtendedName(
-      std::string(++it, search_name.cend()));
+  return common::Error::kNotFound;
+}
+
+common::ErrorOr<Registry::Element*> Registry::FindElementByFullName(
+    std::string_view full_name) {
+  internal::LookupRecorder<> recorder(LookupKind::kFullName, stats_id_);
+  if (Element* element = root_->path_index_.Find(full_name)) {
+    recorder.Found(element->stats_id_);
+    return element;
+  }
+  return common::Error::kNotFound;
+}
+
+common::ErrorOr<Registry::Element*> Registry::FindElementByFullName(
+    std::string_view full_name, uint64_t hash) {
+  internal::LookupRecorder<> recorder(LookupKind::kFullName, stats_id_);
+  if (Element* element = root_->path_index_.Find(full_name, hash)) {
+    recorder.Found(element->stats_id_);
+    return element;
+  }
+  return common::Error::kNotFound;
+}
+
+common::ErrorOr<Registry::ElementHandle> Registry::FindElementHandle(
+    std::string_view name) {
+  common::ErrorOr<Element*> maybe_element = FindElementByExtendedName(name);
+  if (!maybe_element.HasValue()) {
+    return maybe_element.ErrorOrDie();
+  }
+  return maybe_element.ValueOrDie()->handle();
+}
+
+std::pair<Registry*, bool> Registry::InsertChildRegistry(
+    internal::NodePtr<Registry> child) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Registry* existing = child_registries_.Find(child->name_)) {
+    return std::make_pair(existing, false);
+  }
+  child->parent_ = this;
+  child->root_ = root_;
+  child->full_name_.Join(FullName(), internal::kNamespaceCharacter,
+                         child->name(), root_->arena_);
+  Registry* registry = child.get();
+  owned_child_registries_.push_back(std::move(child));
+  child_registries_.Insert(registry);
+  {
+    std::lock_guard<std::mutex> index_lock(root_->index_mutex_);
+    root_->registry_table_.PushBack(registry);
+  }
+  MarkContentChanged();
+  return std::make_pair(registry, true);
+}
+
+Registry::Element* Registry::InsertElement(
+    internal::NodePtr<Element> element) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (elements_.Find(element->name_) != nullptr) {
+    return nullptr;
+  }
+  element->registry_ = this;
+  element->full_name_.Join(FullName(), internal::kNamespaceCharacter,
+                           element->name(), root_->arena_);
+  Element* inserted = element.get();
+  owned_elements_.push_back(std::move(element));
+  {
+    // The element table and path index are shared by the whole tree. The
+    // element is fully set up before being published in any of the maps
+    std::lock_guard<std::mutex> index_lock(root_->index_mutex_);
+    uint32_t watchers = 0;
+    for (Registry const* registry = this; registry != nullptr;
+         registry = registry->parent_) {
+      watchers += registry->subtree_watchers_;
+    }
+    inserted->watchers_.store(watchers, std::memory_order_relaxed);
+    inserted->tree_epoch_ = &root_->epoch_;
+    inserted->version_.store(root_->epoch_.load());
+    inserted->handle_ = ElementHandle(
+        static_cast<uint32_t>(root_->element_table_.PushBack(inserted)));
+    root_->path_index_.Insert(inserted);
+  }
+  elements_.Insert(inserted);
+  element_list_.PushBack(inserted);
+  MarkContentChanged();
+  return inserted;
 }
 
 Registry* Registry::FindOrAddChildRegistry(const std::string& name) {
-  ChildMap::iterator it = child_registries_.find(name);
-  if (it != child_registries_.end()) {
-    return it->second.get();
+  if (Registry* child = FindChild(name)) {
+    return child;
   }
-  std::pair<ChildMap::iterator, bool> ref =
-      child_registries_.emplace(name, std::make_unique<Registry>(name));
-  return ref.first->second.get();
+  return InsertChildRegistry(CreateNode<Registry>(name)).first;
 }
 
-common::ErrorOr<Registry::Int32*> Registry::FindInt32(const std::string& name) {
+common::ErrorOr<Registry::Int32*> Registry::FindInt32(std::string_view name) {
   return FindElementType<Int32>(name);
 }
 
@@ -125,7 +318,7 @@ common::ErrorOr<Registry::Int32*> Registry::AddInt32(const std::string& name) {
 }
 
 common::ErrorOr<Registry::UnsignedInt32*> Registry::FindUnsignedInt32(
-    const std::string& name) {
+    std::string_view name) {
   return FindElementType<UnsignedInt32>(name);
 }
 
@@ -134,7 +327,7 @@ common::ErrorOr<Registry::UnsignedInt32*> Registry::AddUnsignedInt32(
   return AddElementType<UnsignedInt32>(name);
 }
 
-common::ErrorOr<Registry::Int64*> Registry::FindInt64(const std::string& name) {
+common::ErrorOr<Registry::Int64*> Registry::FindInt64(std::string_view name) {
   return FindElementType<Int64>(name);
 }
 
@@ -143,7 +336,7 @@ common::ErrorOr<Registry::Int64*> Registry::AddInt64(const std::string& name) {
 }
 
 common::ErrorOr<Registry::UnsignedInt64*> Registry::FindUnsignedInt64(
-    const std::string& name) {
+    std::string_view name) {
   return FindElementType<UnsignedInt64>(name);
 }
 
@@ -152,8 +345,7 @@ common::ErrorOr<Registry::UnsignedInt64*> Registry::AddUnsignedInt64(
   return AddElementType<UnsignedInt64>(name);
 }
 
-common::ErrorOr<Registry::Bool*> Registry::FindBoolean(
-    const std::string& name) {
+common::ErrorOr<Registry::Bool*> Registry::FindBoolean(std::string_view name) {
   return FindElementType<Bool>(name);
 }
 
@@ -161,7 +353,7 @@ common::ErrorOr<Registry::Bool*> Registry::AddBoolean(const std::string& name) {
   return AddElementType<Bool>(name);
 }
 
-common::ErrorOr<Registry::Char*> Registry::FindChar(const std::string& name) {
+common::ErrorOr<Registry::Char*> Registry::FindChar(std::string_view name) {
   return FindElementType<Char>(name);
 }
 
@@ -170,8 +362,7 @@ common::ErrorOr<Registry::Char*> Registry::AddChar(const std::string& name,
   return AddElementType<Char>(name, value);
 }
 
-common::ErrorOr<Registry::String*> Registry::FindString(
-    const std::string& name) {
+common::ErrorOr<Registry::String*> Registry::FindString(std::string_view name) {
   return FindElementType<String>(name);
 }
 
@@ -180,7 +371,12 @@ common::ErrorOr<Registry::String*> Registry::AddString(
   return AddElementType<String>(name, value);
 }
 
-common::ErrorOr<Registry::Float*> Registry::FindFloat(const std::string& name) {
+common::ErrorOr<Registry::String*> Registry::AddString(const std::string& name,
+                                                       std::string&& value) {
+  return AddElementType<String>(name, std::move(value));
+}
+
+common::ErrorOr<Registry::Float*> Registry::FindFloat(std::string_view name) {
   return FindElementType<Float>(name);
 }
 
@@ -188,8 +384,7 @@ common::ErrorOr<Registry::Float*> Registry::AddFloat(const std::string& name) {
   return AddElementType<Float>(name);
 }
 
-common::ErrorOr<Registry::Double*> Registry::FindDouble(
-    const std::string& name) {
+common::ErrorOr<Registry::Double*> Registry::FindDouble(std::string_view name) {
   return FindElementType<Double>(name);
 }
 
@@ -198,12 +393,246 @@ common::ErrorOr<Registry::Double*> Registry::AddDouble(
   return AddElementType<Double>(name);
 }
 
+common::ErrorOr<Registry::DoubleArray*> Registry::FindDoubleArray(
+    std::string_view name) {
+  return FindElementType<DoubleArray>(name);
+}
+
+common::ErrorOr<Registry::DoubleArray*> Registry::AddDoubleArray(
+    const std::string& name, std::size_t size) {
+  return AddElementType<DoubleArray>(name, size);
+}
+
+void Registry::Reserve(std::size_t child_registries, std::size_t elements) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  child_registries_.Reserve(child_registries_.size() + child_registries);
+  elements_.Reserve(elements_.size() + elements);
+}
+
+void Registry::ReserveTree(std::size_t elements) {
+  std::lock_guard<std::mutex> lock(root_->index_mutex_);
+  root_->path_index_.Reserve(root_->path_index_.size() + elements);
+}
+
 std::set<std::string> Registry::GetChildRegistryNames() const {
   std::set<std::string> child_registry_names;
-  for (const auto& child_entry : child_registries_) {
-    child_registry_names.insert(child_entry.first);
+  for (const Registry& child : ChildRegistries()) {
+    child_registry_names.emplace_hint(child_registry_names.end(),
+                                      child.name());
   }
   return child_registry_names;
 }
 
+Registry::ElementView Registry::MatchElements(
+    std::string_view pattern) const {
+  std::string full_pattern(FullName());
+  full_pattern += internal::kNamespaceCharacter;
+  full_pattern += pattern;
+  return ElementView(root_->sorted_elements_.Sorted(root_->element_table_),
+                     std::move(full_pattern));
+}
+
+Registry::RegistryView Registry::MatchRegistries(
+    std::string_view pattern) const {
+  std::string full_pattern(FullName());
+  full_pattern += internal::kNamespaceCharacter;
+  full_pattern += pattern;
+  return RegistryView(
+      root_->sorted_registries_.Sorted(root_->registry_table_),
+      std::move(full_pattern));
+}
+
+Registry::ElementView Registry::FindElementsByPrefix(
+    std::string_view prefix) const {
+  std::string pattern(prefix);
+  pattern += "**";
+  return MatchElements(pattern);
+}
+
+common::ErrorOr<uint64_t> Registry::Subscribe(Element* element,
+                                              ChangeCallback callback) {
+  if (element == nullptr || element->registry_ == nullptr ||
+      element->registry_->root_ != root_) {
+    return common::Error::kNotFound;
+  }
+  std::lock_guard<std::mutex> lock(root_->subscription_mutex_);
+  const uint64_t id = root_->next_subscription_id_++;
+  auto subscription = std::make_shared<Subscription>(
+      Subscription{element, nullptr, std::move(callback), {}});
+  root_->subscriptions_.emplace(id, subscription);
+  root_->subscriptions_by_target_[element].push_back(subscription);
+  element->watchers_.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+uint64_t Registry::SubscribeSubtree(ChangeCallback callback) {
+  std::lock_guard<std::mutex> lock(root_->subscription_mutex_);
+  const uint64_t id = root_->next_subscription_id_++;
+  auto subscription = std::make_shared<Subscription>(
+      Subscription{nullptr, this, std::move(callback), {}});
+  root_->subscriptions_.emplace(id, subscription);
+  root_->subscriptions_by_target_[this].push_back(subscription);
+  WatchSubtree(1);
+  return id;
+}
+
+bool Registry::Unsubscribe(uint64_t id) {
+  std::lock_guard<std::mutex> lock(root_->subscription_mutex_);
+  auto found = root_->subscriptions_.find(id);
+  if (found == root_->subscriptions_.end()) {
+    return false;
+  }
+  const std::shared_ptr<Subscription> subscription = std::move(found->second);
+  root_->subscriptions_.erase(found);
+  const void* target = subscription->element != nullptr
+                           ? static_cast<const void*>(subscription->element)
+                           : subscription->registry;
+  auto by_target = root_->subscriptions_by_target_.find(target);
+  std::vector<std::shared_ptr<Subscription>>& subscriptions = by_target->second;
+  subscriptions.erase(
+      std::find(subscriptions.begin(), subscriptions.end(), subscription));
+  if (subscriptions.empty()) {
+    root_->subscriptions_by_target_.erase(by_target);
+  }
+  if (subscription->element != nullptr) {
+    subscription->element->watchers_.fetch_sub(1, std::memory_order_relaxed);
+  } else {
+    subscription->registry->WatchSubtree(-1);
+  }
+  return true;
+}
+
+void Registry::WatchSubtree(int delta) {
+  std::lock_guard<std::mutex> index_lock(root_->index_mutex_);
+  subtree_watchers_ += delta;
+  // Walks the element table rather than ForEachElement(): elements enter the
+  // table under the index lock, but their registry only after it is released
+  const std::size_t count = root_->element_table_.size();
+  for (std::size_t id = 0; id < count; ++id) {
+    Element* element = root_->element_table_[id];
+    if (Contains(*element)) {
+      element->watchers_.fetch_add(static_cast<uint32_t>(delta),
+                                   std::memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t Registry::AdvanceEpoch() const {
+  const uint64_t epoch = root_->epoch_.fetch_add(1) + 1;
+  // Writes racing the increment have either stored their value and stamp
+  // where this thread sees them, or will see the new epoch and restamp
+  internal::HeavyBarrier();
+  return epoch;
+}
+
+uint64_t Registry::ContentHash() const {
+  std::lock_guard<std::mutex> lock(root_->content_hash_mutex_);
+  std::vector<Registry const*> changed;
+  CollectContentChanged(&changed);
+  if (changed.empty()) {
+    return content_hash_;
+  }
+  // Writes that found their registry still marked have stored their value
+  // where this thread sees it, the others mark it again
+  internal::HeavyBarrier();
+  // Children are hashed before their parents
+  for (auto registry = changed.rbegin(); registry != changed.rend();
+       ++registry) {
+    (*registry)->UpdateContentHash();
+  }
+  return content_hash_;
+}
+
+void Registry::MarkContentChanged() const {
+  // A registry is marked before its parent, and the marks are cleared
+  // parents first: a parent found already marked is hashed again along with
+  // this registry
+  for (Registry const* registry = this; registry != nullptr;
+       registry = registry->parent_) {
+    if (registry->content_changed_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+}
+
+void Registry::CollectContentChanged(
+    std::vector<Registry const*>* changed) const {
+  if (!content_changed_.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  changed->push_back(this);
+  child_registries_.ForEach([changed](const Registry& child) {
+    child.CollectContentChanged(changed);
+  });
+}
+
+void Registry::UpdateContentHash() const {
+  // Sums are independent of the order in which nodes were added
+  uint64_t elements = 0;
+  element_list_.ForEach(
+      [&elements](Element* element) { elements += HashElement(*element); });
+  uint64_t children = 0;
+  child_registries_.ForEach([&children](const Registry& child) {
+    children += MixHash(internal::HashName(child.name()) ^
+                        MixHash(child.content_hash_));
+  });
+  content_hash_ = MixHash(MixHash(elements) + children);
+}
+
+std::size_t Registry::DispatchChanges() {
+  Registry* root = root_;
+  std::lock_guard<std::mutex> dispatch_lock(root->dispatch_mutex_);
+  Element* element =
+      root->changed_elements_.exchange(nullptr, std::memory_order_acquire);
+  if (element == nullptr) {
+    return 0;
+  }
+  // Once its flag is cleared an element is queued again by its next write,
+  // so its link has to be read first. Clearing through an exchange makes the
+  // writes that found the flag still set visible to the callbacks
+  std::vector<Element*>& changed = root->dispatched_elements_;
+  while (element != nullptr) {
+    Element* next = element->next_changed_;
+    element->changed_.exchange(false, std::memory_order_acq_rel);
+    changed.push_back(element);
+    element = next;
+  }
+  std::reverse(changed.begin(), changed.end());
+
+  std::vector<std::shared_ptr<Subscription>>& ready =
+      root->dispatched_subscriptions_;
+  {
+    std::lock_guard<std::mutex> lock(root->subscription_mutex_);
+    auto collect = [root, &ready](const void* target, Element* element) {
+      auto found = root->subscriptions_by_target_.find(target);
+      if (found == root->subscriptions_by_target_.end()) {
+        return;
+      }
+      for (const std::shared_ptr<Subscription>& subscription : found->second) {
+        if (subscription->batch.empty()) {
+          ready.push_back(subscription);
+        }
+        subscription->batch.push_back(element);
+      }
+    };
+    for (Element* changed_element : changed) {
+      collect(changed_element, changed_element);
+      for (Registry const* registry = changed_element->registry_;
+           registry != nullptr; registry = registry->parent_) {
+        collect(registry, changed_element);
+      }
+    }
+  }
+  // Callbacks run without the subscription lock so that they may subscribe
+  // and unsubscribe
+  for (const std::shared_ptr<Subscription>& subscription : ready) {
+    subscription->callback(subscription->batch);
+    subscription->batch.clear();
+  }
+  ready.clear();
+  const std::size_t count = changed.size();
+  changed.clear();
+  return count;
+}
+
 }  // namespace registry
@@ -2,12 +2,32 @@
 #define REGISTRY_REGISTRY_H_
 
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "common/error_or.h"
 #include "common/type_traits.h"
+#include "registry/access_counters.h"
+#include "registry/arena.h"
+#include "registry/concurrent_containers.h"
+#include "registry/element_storage.h"
+#include "registry/memory_barrier.h"
+#include "registry/name_index.h"
+#include "registry/symbol_table.h"
+#include "registry/thread_pool.h"
+#include "registry/value_history.h"
 
 namespace registry {
 
@@ -18,11 +38,94 @@ namespace internal {
 // house-keeping functions
 constexpr char kRegistryReservedChars[] = "<>(){}[]#$!@%^&|~`;:.,/*-+= ";
 
+// Separates the names of registries and elements in dotted paths
+constexpr char kNamespaceCharacter = '.';
+
+/// @return true if character is one of kRegistryReservedChars. Usable in
+/// constant expressions to validate names at compile time
+constexpr bool IsReservedCharacter(char character) {
+  for (const char* reserved = kRegistryReservedChars; *reserved != '\0';
+       ++reserved) {
+    if (*reserved == character) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// IsReservedCharacter() of every character, so that names are cleaned and
+// checked with a single table lookup per character
+inline constexpr std::array<bool, 256> kReservedCharacterTable = [] {
+  std::array<bool, 256> table{};
+  for (int character = 0; character < 256; ++character) {
+    table[character] = IsReservedCharacter(static_cast<char>(character));
+  }
+  return table;
+}();
+
+// Deleter for the nodes of a registry tree. Nodes allocated on an Arena are
+// owned and torn down by the arena, so deleting them is a no-op
+struct NodeDeleter {
+  template <typename T>
+  void operator()(T* node) const {
+    if (!arena_owned) {
+      delete node;
+    }
+  }
+
+  bool arena_owned = false;
+};
+
+template <typename T>
+using NodePtr = std::unique_ptr<T, NodeDeleter>;
+
+// Whether the nodes of type T are array elements
+template <typename T, typename = void>
+struct IsElementArray : std::false_type {};
+
+template <typename T>
+struct IsElementArray<T, std::void_t<decltype(T::kIsArray)>>
+    : std::integral_constant<bool, T::kIsArray> {};
+
 }  // namespace internal
 
+template <typename T, std::size_t kSize>
+class RegistryPath;
+
 /// @class Registry
+/// Registries and elements may be added and looked up concurrently from any
+/// number of threads. Lookups are lock-free and never wait for insertions;
+/// insertions into the same registry are serialised
 class Registry {
  public:
+  /// @class ElementHandle
+  /// Dense integer identifier of an element within the tree it was added to.
+  /// Handles are trivially copyable and remain valid for the lifetime of the
+  /// tree, so hot code can resolve a path once and then dereference the handle
+  /// in O(1) without any hashing
+  class ElementHandle {
+   public:
+    ElementHandle() : id_(kInvalidId) {}
+    explicit ElementHandle(uint32_t id) : id_(id) {}
+
+    bool IsValid() const { return id_ != kInvalidId; }
+    uint32_t id() const { return id_; }
+
+    bool operator==(const ElementHandle& other) const {
+      return id_ == other.id_;
+    }
+    bool operator!=(const ElementHandle& other) const {
+      return id_ != other.id_;
+    }
+
+   private:
+    friend class Registry;
+
+    static constexpr uint32_t kInvalidId = std::numeric_limits<uint32_t>::max();
+
+    uint32_t id_;
+  };
+
   /// @class Element
   /// Interface for types held by the registry. Defines API that the Registry
   /// needs for its housekeeping, data logging and parameter server functions
@@ -36,12 +139,43 @@ class Registry {
 
     TypeEnum type() const { return type_; }
 
-    const std::string& name() const { return name_; }
-    std::string FullName() const;
+    /// @return size in bytes of the value of the element, 0 when the value
+    /// is not trivially copyable and so cannot be handled as raw bytes. The
+    /// value of an array element is all of its values
+    std::size_t value_size() const { return value_size_; }
+
+    /// @return number of values of an array element, each of type type(), 0
+    /// for elements holding a single value
+    std::size_t extent() const { return extent_; }
+
+    /// @return handle of the element within its tree, invalid until the
+    /// element has been added to a registry
+    ElementHandle handle() const { return handle_; }
+
+    std::string_view name() const {
+      return internal::GlobalSymbolTable().text(name_);
+    }
+
+    /// @return dotted path of the element starting at the root registry. The
+    /// name is computed once when the element is added to a registry
+    std::string_view FullName() const { return full_name_.view(); }
+
+    /// @return registry holding the element, nullptr if it was never added
+    Registry const* registry() const { return registry_; }
+
+    /// @return epoch of the tree when the element was last written or added,
+    /// see Registry::epoch()
+    uint64_t version() const {
+      return version_.load(std::memory_order_acquire);
+    }
+
+    /// @return identifier of the element in access statistics, 0 unless
+    /// built with instrumentation, see access_stats.h
+    internal::StatsId stats_id() const { return stats_id_; }
 
     template <typename T>
     bool Assign(const T& other) {
-      if (TypeTrait<T>::type != type_) {
+      if (TypeTrait<T>::type != type_ || extent_ != 0) {
         return false;
       }
       Assign(static_cast<void const*>(&other));
@@ -50,23 +184,130 @@ class Registry {
 
     template <typename T>
     bool Extract(T* other) const {
-      if (TypeTrait<T>::type != type_) {
+      if (TypeTrait<T>::type != type_ || extent_ != 0) {
+        return false;
+      }
+      Extract(static_cast<void*>(other));
+      return true;
+    }
+
+    /// Copies the value of the element as raw bytes, which lets values of
+    /// any trivially copyable type, enums included, be handled generically
+    /// @param[out] bytes value_size() bytes of memory aligned for the value
+    /// @return false if the value is not trivially copyable
+    bool ExtractBytes(void* bytes) const {
+      if (value_size_ == 0) {
+        return false;
+      }
+      Extract(bytes);
+      return true;
+    }
+
+    /// Counterpart of ExtractBytes() taking the value from raw bytes
+    /// @param[in] bytes value_size() bytes holding a value of the element type
+    /// @return false if the value is not trivially copyable
+    bool AssignBytes(void const* bytes) {
+      if (value_size_ == 0) {
         return false;
       }
-      *other = *(reinterpret_cast<T const*>(Extract()));
+      Assign(bytes);
       return true;
     }
 
+    /// Sets the value back to the default of its type: TypeTrait<T>::
+    /// default_value for elements holding a single value, value initialised
+    /// values for arrays. Counts as a write of the element
+    virtual void Reset() = 0;
+
+    /// Moves the value of the element out to external memory, such as a
+    /// region shared with other processes, or back inside the element. Only
+    /// values held in lock-free atomics can be moved. Must not be called
+    /// concurrently with writes to the element
+    /// @param[in] memory value_size() bytes aligned to value_size(), or
+    /// nullptr to move the value back inside the element
+    /// @return false if the value cannot be moved
+    virtual bool RelocateValue(void* memory) = 0;
+
    protected:
+    Element(const std::string& name, TypeEnum type, std::size_t value_size,
+            std::size_t extent = 0);
+
     virtual void Assign(void const* other) = 0;
-    virtual void const* Extract() const = 0;
+    virtual void Extract(void* other) const = 0;
+
+    /// Counts a read of the value in instrumented builds
+    void RecordRead() const {
+      if constexpr (internal::kInstrumented) {
+        internal::LocalAccessCounters().CountRead(stats_id_);
+      }
+    }
+
+    /// Records a write to the value, once the value has been stored. Stamps
+    /// the element with the epoch of its tree, and queues it for
+    /// Registry::DispatchChanges() when it is watched, which otherwise costs
+    /// a single relaxed load, and marks its registry for
+    /// Registry::ContentHash() unless it is already marked. Also counts the
+    /// write in instrumented builds
+    void RecordWrite() {
+      if constexpr (internal::kInstrumented) {
+        internal::LocalAccessCounters().CountWrite(stats_id_);
+      }
+      // The stamp is taken after the value is stored and retaken if the epoch
+      // moved meanwhile. AdvanceEpoch() pairs its heavy barrier with the
+      // light ones here, so a delta export that missed this write is
+      // guaranteed to see a stamp of its new epoch
+      internal::LightBarrier();
+      uint64_t epoch = tree_epoch_->load(std::memory_order_relaxed);
+      for (;;) {
+        if (version_.load(std::memory_order_relaxed) != epoch) {
+          version_.store(epoch, std::memory_order_relaxed);
+        }
+        internal::LightBarrier();
+        const uint64_t current = tree_epoch_->load(std::memory_order_relaxed);
+        if (current == epoch) {
+          break;
+        }
+        epoch = current;
+      }
+      if (watchers_.load(std::memory_order_relaxed) != 0) {
+        QueueChange();
+      }
+      // Ordered after the value by the light barriers above, which pair with
+      // the heavy barrier of ContentHash()
+      if (registry_ != nullptr &&
+          !registry_->content_changed_.load(std::memory_order_relaxed)) {
+        registry_->MarkContentChanged();
+      }
+    }
 
    private:
     friend class Registry;
 
-    const std::string name_;
+    // Pushes the element on the changed list of its tree unless it is there
+    void QueueChange();
+
     const TypeEnum type_;
+    const std::size_t value_size_;
+    const std::size_t extent_;
     Registry const* registry_;
+    ElementHandle handle_;
+    // Fills padding, so that elements are no larger when not instrumented
+    const internal::StatsId stats_id_;
+
+    // Epoch of the tree the element belongs to, and epoch at its last write
+    const std::atomic<uint64_t>* tree_epoch_;
+    std::atomic<uint64_t> version_;
+
+    // Number of subscriptions covering the element, and its link in the
+    // changed list of the tree while changed_ is set
+    std::atomic<uint32_t> watchers_;
+    std::atomic<bool> changed_;
+    Element* next_changed_;
+
+    // The name is interned, the full name is computed once the element is
+    // added and views the name until then
+    internal::CompactName full_name_;
+    internal::Symbol name_;
   };
 
   template <typename T>
@@ -77,28 +318,99 @@ class Registry {
 
    public:
     using ValueType = T;
+    static constexpr bool kIsArray = false;
 
     ElementTemplate(const std::string& name, const T& initial_value)
-        : Element(name, TypeTrait<T>::type), value_(initial_value) {}
+        : Element(name, TypeTrait<T>::type, kValueSize),
+          value_(initial_value),
+          history_(nullptr) {}
+
+    ElementTemplate(const std::string& name, T&& initial_value)
+        : Element(name, TypeTrait<T>::type, kValueSize),
+          value_(std::move(initial_value)),
+          history_(nullptr) {}
 
     ElementTemplate(const std::string& name)
-        : Element(name, TypeTrait<T>::type),
-          value_(TypeTrait<T>::default_value) {}
+        : Element(name, TypeTrait<T>::type, kValueSize),
+          value_(TypeTrait<T>::default_value),
+          history_(nullptr) {}
 
-    ~ElementTemplate() override {}
+    ~ElementTemplate() override {
+      // Elements of arena backed trees keeping a history hold trivially
+      // destructible values and are never destroyed, see
+      // ArenaDestructorSkippable below, so the history is always on the heap
+      if constexpr (kHistorySupported) {
+        delete history_.load(std::memory_order_relaxed);
+      }
+    }
 
     // At the specific template level we allow direct assignment to and from the
     // underlying type, this allows for all the methods / operators defined for
     // the underlying type to be available to the Registry::ElementTemplate
-    inline const T& value() const { return value_; }
+    // Values may be read and written concurrently from any number of threads.
+    // Reads are wait-free; see element_storage.h for the guarantees per type
+    inline T value() const {
+      RecordRead();
+      return value_.Load();
+    }
 
     inline const T& operator=(const T& other) {
-      value_ = other;
+      value_.Store(other);
+      RecordHistory(other);
+      RecordWrite();
       return other;
     }
 
     operator T() const { return value(); }
 
+    void Reset() override { *this = TypeTrait<T>::default_value; }
+
+    /// Starts keeping the most recent values written to the element, with
+    /// the time of their write, see ValueHistory. The history is allocated
+    /// here, on the arena of the tree if it has one, and lives as long as
+    /// the element, recording never allocates.
+    /// While it is enabled writes must come from one thread at a time, and
+    /// values written to relocated memory by other processes are missed
+    /// @param[in] capacity number of values kept
+    /// @return false if the history is already enabled or values are not
+    /// trivially copyable
+    bool EnableHistory(std::size_t capacity) {
+      if constexpr (kHistorySupported) {
+        Arena* arena = registry() != nullptr ? registry()->root_->arena_
+                                             : nullptr;
+        if (arena != nullptr) {
+          // Released with the arena, which runs the destructor of the
+          // history. A history losing the race is released the same way
+          ValueHistory<T>* history = arena->Create<ValueHistory<T>>(capacity);
+          ValueHistory<T>* expected = nullptr;
+          return history_.compare_exchange_strong(expected, history,
+                                                  std::memory_order_release);
+        }
+        auto history = std::make_unique<ValueHistory<T>>(capacity);
+        ValueHistory<T>* expected = nullptr;
+        if (history_.compare_exchange_strong(expected, history.get(),
+                                             std::memory_order_release)) {
+          history.release();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// @return history of the element, nullptr unless enabled
+    const ValueHistory<T>* history() const {
+      return history_.load(std::memory_order_acquire);
+    }
+
+    bool RelocateValue(void* memory) override {
+      if constexpr (internal::ElementStorage<T>::kRelocatable) {
+        value_.Relocate(memory);
+        return true;
+      } else {
+        return false;
+      }
+    }
+
    protected:
     /// An unsafe assignment function that updates the internal value of the
     /// element using the data at the specified memory location
@@ -107,20 +419,128 @@ class Registry {
     /// @param other pointer to the memory location that the Element should take
     /// on the value of
     void Assign(void const* other) override {
-      value_ = *(reinterpret_cast<T const*>(other));
+      value_.Store(*(reinterpret_cast<T const*>(other)));
+      RecordHistory(*(reinterpret_cast<T const*>(other)));
+      RecordWrite();
     }
 
     /// An unsafe getter function
     /// Note: This is extremely unsafe to use directly and is only
     /// designed to be used via the Element class which ensures type safety
-    /// @return  pointer to the memory location that the Element is using to
-    /// store its curernt value
-    void const* Extract() const override {
-      return reinterpret_cast<void const*>(&value_);
+    /// @param other pointer to the memory location that the current value of
+    /// the Element is copied to
+    void Extract(void* other) const override {
+      RecordRead();
+      value_.LoadInto(reinterpret_cast<T*>(other));
+    }
+
+   private:
+    static constexpr std::size_t kValueSize =
+        std::is_trivially_copyable<T>::value ? sizeof(T) : 0;
+    static constexpr bool kHistorySupported =
+        std::is_trivially_copyable<T>::value;
+
+    void RecordHistory(const T& value) {
+      if constexpr (kHistorySupported) {
+        if (ValueHistory<T>* history =
+                history_.load(std::memory_order_acquire)) {
+          history->Record(value);
+        }
+      }
+    }
+
+    internal::ElementStorage<T> value_;
+    std::atomic<ValueHistory<T>*> history_;
+  };
+
+  /// @class ElementArray
+  /// Element holding a fixed number of values of type T, such as the gains
+  /// of every joint of an arm. The values are stored contiguously and read
+  /// or written in bulk with a single copy instead of one call per value.
+  /// Readers see bulk writes as a whole, and every bulk write counts as a
+  /// single write of the element. Unlike scalar elements, arrays keep no
+  /// value history, see ElementTemplate::EnableHistory()
+  template <typename T>
+  class ElementArray : public Element {
+   public:
+    using ValueType = T;
+    static constexpr bool kIsArray = true;
+
+    /// @param[in] size number of values, which start value initialised
+    /// @param[in] arena arena of the tree the values are allocated on,
+    /// nullptr to allocate them on the heap
+    ElementArray(const std::string& name, std::size_t size,
+                 Arena* arena = nullptr)
+        : Element(name, TypeTrait<T>::type, size * sizeof(T), size),
+          values_(size, arena) {}
+
+    ~ElementArray() override {}
+
+    std::size_t size() const { return values_.size(); }
+
+    /// @param[in] index index of the value, below size()
+    /// @return value at index
+    T operator[](std::size_t index) const {
+      T value;
+      RecordRead();
+      values_.LoadInto(index, 1, &value);
+      return value;
+    }
+
+    /// Copies count values starting at offset
+    /// @param[in] offset index of the first value
+    /// @param[in] count number of values
+    /// @param[out] values count values
+    /// @return false if the range does not lie within the array
+    bool Get(std::size_t offset, std::size_t count, T* values) const {
+      if (offset > size() || count > size() - offset) {
+        return false;
+      }
+      RecordRead();
+      values_.LoadInto(offset, count, values);
+      return true;
+    }
+
+    /// Overwrites count values starting at offset
+    /// @param[in] offset index of the first value
+    /// @param[in] count number of values
+    /// @param[in] values count values
+    /// @return false if the range does not lie within the array
+    bool Set(std::size_t offset, std::size_t count, const T* values) {
+      if (offset > size() || count > size() - offset) {
+        return false;
+      }
+      values_.Store(offset, count, values);
+      RecordWrite();
+      return true;
+    }
+
+    bool Set(std::size_t index, const T& value) {
+      return Set(index, 1, &value);
+    }
+
+    void Reset() override {
+      const std::unique_ptr<T[]> values(new T[size()]());
+      Set(0, size(), values.get());
+    }
+
+    bool RelocateValue(void*) override { return false; }
+
+   protected:
+    /// Type erased access to every value of the array at once, see
+    /// ElementTemplate::Assign
+    void Assign(void const* other) override {
+      values_.Store(0, size(), static_cast<const T*>(other));
+      RecordWrite();
+    }
+
+    void Extract(void* other) const override {
+      RecordRead();
+      values_.LoadInto(0, size(), static_cast<T*>(other));
     }
 
    private:
-    T value_;
+    internal::LeftRightArrayStorage<T> values_;
   };
 
   using Int32 = ElementTemplate<int32_t>;
@@ -135,19 +555,55 @@ class Registry {
   template <typename T,
             typename = typename std::enable_if<std::is_enum<T>::value>::type>
   using Enum = ElementTemplate<T>;
+  using Int32Array = ElementArray<int32_t>;
+  using Int64Array = ElementArray<int64_t>;
+  using FloatArray = ElementArray<float>;
+  using DoubleArray = ElementArray<double>;
+
+  /// Lazy, sorted listings of the elements and registries of a tree
+  using ElementView = NameView<Element>;
+  using RegistryView = NameView<Registry>;
+
+  /// Receives the elements written since the previous dispatch, each listed
+  /// once in the order of their first write
+  using ChangeCallback = std::function<void(const std::vector<Element*>&)>;
 
   Registry(const std::string& name);
 
+  /// Creates the root of a tree whose child registries, elements and names
+  /// are all allocated on the given arena. Elements holding trivially
+  /// destructible values are released with the arena without running their
+  /// destructors
+  /// @param[in] name name of the root registry
+  /// @param[in] arena arena owning the tree, must outlive the registry
+  Registry(const std::string& name, Arena* arena);
+
   Registry(const Registry&) = delete;
   Registry& operator=(const Registry&) = delete;
 
-  const std::string& name() const { return name_; }
-  std::string FullName() const;
+  std::string_view name() const {
+    return internal::GlobalSymbolTable().text(name_);
+  }
+
+  /// @return dotted path of the registry starting at the root registry. The
+  /// name is computed once when the registry is attached to its parent
+  std::string_view FullName() const { return full_name_.view(); }
+
+  /// @return parent registry, nullptr for the root of a tree
+  Registry const* parent() const { return parent_; }
+
+  /// @return identifier of the registry in access statistics, 0 unless built
+  /// with instrumentation, see access_stats.h
+  internal::StatsId stats_id() const { return stats_id_; }
+
+  /// @return true if the element is held by this registry or by one of its
+  /// descendants
+  bool Contains(const Element& element) const;
 
   /// Search for a child registry by its name
   /// @param[in] name unique string identifier for the child registry
   /// @return pointer to the registry if found, else an error code
-  common::ErrorOr<Registry*> FindChildRegistry(const std::string& name);
+  common::ErrorOr<Registry*> FindChildRegistry(std::string_view name);
 
   /// Adds a child registry
   /// @param[in] name unique child identifier
@@ -161,39 +617,216 @@ class Registry {
   /// @return pointer to the child registry
   Registry* FindOrAddChildRegistry(const std::string& name);
 
-  common::ErrorOr<Element*> FindElement(const std::string& name);
-  common::ErrorOr<Element*> FindElementByExtendedName(const std::string& name);
+  common::ErrorOr<Element*> FindElement(std::string_view name);
+
+  /// Search for an element using its dotted path relative to this registry,
+  /// e.g. "child1.grandchild1.element". A leading segment matching the name of
+  /// the registry being searched is skipped. The search does not allocate
+  /// @param[in] name dotted path to the element
+  /// @return pointer to the element if found, else an error code
+  common::ErrorOr<Element*> FindElementByExtendedName(std::string_view name);
+
+  /// Search for an element using its full name, as returned by
+  /// Element::FullName(). Resolved with a single lookup in the path index of
+  /// the root registry, regardless of the depth of the element
+  /// @param[in] full_name dotted path to the element starting at the root
+  /// @return pointer to the element if found, else an error code
+  common::ErrorOr<Element*> FindElementByFullName(std::string_view full_name);
+
+  /// Same as FindElementByFullName() for a full name whose hash, as returned
+  /// by internal::HashName(), is already known
+  common::ErrorOr<Element*> FindElementByFullName(std::string_view full_name,
+                                                  uint64_t hash);
+
+  /// Search for an element using a path declared at compile time, see
+  /// registry_path.h. The hash of the path is computed at compile time, so
+  /// the lookup costs a single probe of the path index
+  /// @param[in] path full path to the element
+  /// @return pointer to the element if found and of type T, else an error
+  /// code
+  template <typename T, std::size_t kSize>
+  common::ErrorOr<ElementTemplate<T>*> Find(
+      const RegistryPath<T, kSize>& path) {
+    if (!path.IsValid()) {
+      return common::Error::kNotFound;
+    }
+    common::ErrorOr<Element*> maybe_element =
+        FindElementByFullName(path.full_name(), path.hash());
+    if (!maybe_element.HasValue()) {
+      return maybe_element.ErrorOrDie();
+    }
+    Element* element = maybe_element.ValueOrDie();
+    if (element->type() != TypeTrait<T>::type || element->extent() != 0) {
+      return common::Error::kNotFound;
+    }
+    return static_cast<ElementTemplate<T>*>(element);
+  }
+
+  /// Resolves a dotted path relative to this registry into a handle that can
+  /// later be dereferenced in O(1) through GetElement()
+  /// @param[in] name dotted path to the element
+  /// @return handle of the element if found, else an error code
+  common::ErrorOr<ElementHandle> FindElementHandle(std::string_view name);
 
-  common::ErrorOr<Int32*> FindInt32(const std::string& name);
+  /// Dereferences a handle obtained from any registry of the same tree
+  /// @param[in] handle valid handle of an element of this tree
+  /// @return pointer to the element
+  Element* GetElement(ElementHandle handle) const {
+    return root_->element_table_[handle.id_];
+  }
+
+  /// @return number of elements in the whole tree. Handles of the tree have
+  /// ids in [0, ElementCount())
+  std::size_t ElementCount() const { return root_->element_table_.size(); }
+
+  /// Calls function(Element&) with every element of this registry and of its
+  /// descendants, depth-first: the elements of a registry in the order they
+  /// were added, then the subtree of each child registry. Lock-free, elements
+  /// added concurrently may or may not be visited
+  template <typename Function>
+  void ForEachElement(Function function) const {
+    WalkElements(function);
+  }
+
+  /// Same as ForEachElement() restricted to the elements held by this
+  /// registry itself. Unlike MatchElements("*"), which lists them from the
+  /// sorted names of the whole tree, costs nothing beyond the elements walked
+  template <typename Function>
+  void ForEachOwnElement(Function function) const {
+    element_list_.ForEach(
+        [&function](Element* element) { function(*element); });
+  }
+
+  /// Calls function(Registry&) with every child registry, in no particular
+  /// order. Lock-free, children added concurrently may or may not be visited
+  template <typename Function>
+  void ForEachChildRegistry(Function function) const {
+    child_registries_.ForEach(
+        [&function](Registry& child) { function(child); });
+  }
+
+  /// Same as ForEachElement() with every element passed as its concrete
+  /// class: ElementTemplate<T>& for scalars and ElementArray<T>& for arrays,
+  /// with T any of the built-in value types. Enum elements, whose value type
+  /// is not known here, are passed as Element&. The class is resolved once
+  /// per element from its type, so the visitor reads and writes values
+  /// without virtual calls. Typically a generic lambda:
+  ///
+  ///   registry.Visit([](auto& element) {
+  ///     using ElementType = std::decay_t<decltype(element)>;
+  ///     if constexpr (!std::is_same_v<ElementType, Registry::Element>) {
+  ///       Log(element.FullName(), element.value());
+  ///     }
+  ///   });
+  template <typename Visitor>
+  void Visit(Visitor visitor) const {
+    auto visit = [&visitor](Element& element) {
+      VisitElement(element, visitor);
+    };
+    WalkElements(visit);
+  }
+
+  /// Same as ForEachElement() restricted to scalar elements holding values
+  /// of type T, passed as ElementTemplate<T>&
+  template <typename T, typename Function>
+  void ForEachElementOfType(Function function) const {
+    static_assert(!std::is_enum<T>::value,
+                  "Enum elements all share the same type and cannot be told "
+                  "apart");
+    auto visit = [&function](Element& element) {
+      if (element.type() == TypeTrait<T>::type && element.extent() == 0) {
+        function(static_cast<ElementTemplate<T>&>(element));
+      }
+    };
+    WalkElements(visit);
+  }
+
+  /// Same as ForEachElement() with the elements spread over the threads of
+  /// pool. The subtree is cut into runs of the elements of a single registry,
+  /// which the pool balances between its threads, so function is called
+  /// concurrently and in no particular order
+  template <typename Function>
+  void ParallelForEachElement(ThreadPool* pool, Function function) const {
+    std::vector<ElementRun> runs;
+    CollectElementRuns(&runs);
+    pool->ParallelFor(runs.size(), [&runs, &function](std::size_t index) {
+      const ElementRun& run = runs[index];
+      for (std::size_t element = run.begin; element < run.end; ++element) {
+        function(*run.registry->element_list_[element]);
+      }
+    });
+  }
+
+  /// Same as Visit() with the elements spread over the threads of pool, see
+  /// ParallelForEachElement()
+  template <typename Visitor>
+  void ParallelVisit(ThreadPool* pool, Visitor visitor) const {
+    ParallelForEachElement(pool, [&visitor](Element& element) {
+      VisitElement(element, visitor);
+    });
+  }
+
+  /// Calls visitor with an element passed as its concrete class, see Visit()
+  template <typename Visitor>
+  static void VisitElement(Element& element, Visitor& visitor) {
+    if (element.extent() != 0) {
+      VisitAs<ElementArray, int32_t, uint32_t, int64_t, uint64_t, bool, char,
+              float, double>(element, visitor);
+    } else {
+      VisitAs<ElementTemplate, int32_t, uint32_t, int64_t, uint64_t, bool,
+              char, float, double, std::string>(element, visitor);
+    }
+  }
+
+  common::ErrorOr<Int32*> FindInt32(std::string_view name);
   common::ErrorOr<Int32*> AddInt32(const std::string& name);
 
-  common::ErrorOr<UnsignedInt32*> FindUnsignedInt32(const std::string& name);
+  common::ErrorOr<UnsignedInt32*> FindUnsignedInt32(std::string_view name);
   common::ErrorOr<UnsignedInt32*> AddUnsignedInt32(const std::string& name);
 
-  common::ErrorOr<Int64*> FindInt64(const std::string& name);
+  common::ErrorOr<Int64*> FindInt64(std::string_view name);
   common::ErrorOr<Int64*> AddInt64(const std::string& name);
 
-  common::ErrorOr<UnsignedInt64*> FindUnsignedInt64(const std::string& name);
+  common::ErrorOr<UnsignedInt64*> FindUnsignedInt64(std::string_view name);
   common::ErrorOr<UnsignedInt64*> AddUnsignedInt64(const std::string& name);
 
-  common::ErrorOr<Bool*> FindBoolean(const std::string& name);
+  common::ErrorOr<Bool*> FindBoolean(std::string_view name);
   common::ErrorOr<Bool*> AddBoolean(const std::string& name);
 
-  common::ErrorOr<Char*> FindChar(const std::string& name);
+  common::ErrorOr<Char*> FindChar(std::string_view name);
   common::ErrorOr<Char*> AddChar(const std::string& name, char value);
 
-  common::ErrorOr<String*> FindString(const std::string& name);
+  common::ErrorOr<String*> FindString(std::string_view name);
   common::ErrorOr<String*> AddString(const std::string& name,
                                      const std::string& value);
+  /// Same as above, moving value into the element
+  common::ErrorOr<String*> AddString(const std::string& name,
+                                     std::string&& value);
 
-  common::ErrorOr<Float*> FindFloat(const std::string& name);
+  common::ErrorOr<Float*> FindFloat(std::string_view name);
   common::ErrorOr<Float*> AddFloat(const std::string& name);
 
-  common::ErrorOr<Double*> FindDouble(const std::string& name);
+  common::ErrorOr<Double*> FindDouble(std::string_view name);
   common::ErrorOr<Double*> AddDouble(const std::string& name);
 
+  common::ErrorOr<DoubleArray*> FindDoubleArray(std::string_view name);
+  /// Adds an array element of size values
+  common::ErrorOr<DoubleArray*> AddDoubleArray(const std::string& name,
+                                               std::size_t size);
+
+  template <typename T>
+  common::ErrorOr<ElementArray<T>*> FindArray(std::string_view name) {
+    return FindElementType<ElementArray<T>>(name);
+  }
+
+  template <typename T>
+  common::ErrorOr<ElementArray<T>*> AddArray(const std::string& name,
+                                             std::size_t size) {
+    return AddElementType<ElementArray<T>>(name, size);
+  }
+
   template <typename T>
-  common::ErrorOr<Enum<T>*> FindEnum(const std::string& name) {
+  common::ErrorOr<Enum<T>*> FindEnum(std::string_view name) {
     return FindElementType<Enum<T>>(name);
   }
 
@@ -202,44 +835,394 @@ class Registry {
     return AddElementType<Enum<T>>(name);
   }
 
+  /// @struct Declaration
+  /// Element of type ElementType to be added by AddElements(), along with the
+  /// arguments passed to its constructor after its name
+  template <typename ElementType, typename... Args>
+  struct Declaration {
+    using Type = ElementType;
+
+    std::string name;
+    std::tuple<Args...> args;
+  };
+
+  /// @return declaration of an element holding TypeTrait<T>::default_value
+  template <typename T>
+  static Declaration<ElementTemplate<T>> Declare(std::string name) {
+    return {std::move(name), {}};
+  }
+
+  /// @return declaration of an element holding initial_value, which is
+  /// converted to T once and then moved into the element
+  template <typename T, typename Value>
+  static Declaration<ElementTemplate<T>, T> Declare(std::string name,
+                                                    Value&& initial_value) {
+    return {std::move(name), std::tuple<T>(std::forward<Value>(initial_value))};
+  }
+
+  /// @return declaration of an array element of size values
+  template <typename T>
+  static Declaration<ElementArray<T>, std::size_t> DeclareArray(
+      std::string name, std::size_t size) {
+    return {std::move(name), std::tuple<std::size_t>(size)};
+  }
+
+  /// Adds every declared element, sizing the tables of this registry and the
+  /// path index of the tree for all of them at once. Meant for modules
+  /// declaring their parameters together:
+  ///   auto elements = arm->AddElements(
+  ///       Registry::Declare<int32_t>("mode"),
+  ///       Registry::Declare<std::string>("label", "left arm"),
+  ///       Registry::DeclareArray<double>("limits", 6));
+  ///   auto [mode, label, limits] = elements.ValueOrDie();
+  /// @return the elements in order of declaration, else kUnavailable if any
+  /// name is already in use, in which case the other elements are still added
+  template <typename... Declared>
+  common::ErrorOr<std::tuple<typename std::decay_t<Declared>::Type*...>>
+  AddElements(Declared&&... declarations) {
+    Reserve(0, sizeof...(Declared));
+    ReserveTree(sizeof...(Declared));
+    // Braced initialisers are evaluated in order, and so are the additions
+    std::tuple<typename std::decay_t<Declared>::Type*...> elements{
+        AddDeclared(std::forward<Declared>(declarations))...};
+    const bool failed = std::apply(
+        [](auto*... added) { return ((added == nullptr) || ...); }, elements);
+    if (failed) {
+      return common::Error::kUnavailable;
+    }
+    return elements;
+  }
+
+  /// Same as above for any number of elements of the same type, such as
+  /// parameters whose names are generated
+  /// @return the elements in order of declaration, else kUnavailable if any
+  /// name is already in use, in which case the other elements are still added
+  template <typename ElementType, typename... Args>
+  common::ErrorOr<std::vector<ElementType*>> AddElements(
+      std::vector<Declaration<ElementType, Args...>> declarations) {
+    Reserve(0, declarations.size());
+    ReserveTree(declarations.size());
+    std::vector<ElementType*> elements;
+    elements.reserve(declarations.size());
+    bool failed = false;
+    for (Declaration<ElementType, Args...>& declaration : declarations) {
+      elements.push_back(AddDeclared(std::move(declaration)));
+      failed = failed || elements.back() == nullptr;
+    }
+    if (failed) {
+      return common::Error::kUnavailable;
+    }
+    return elements;
+  }
+
+  /// Sizes the tables of this registry so that the given numbers of child
+  /// registries and elements can be added to it without growing them
+  void Reserve(std::size_t child_registries, std::size_t elements);
+
+  /// Sizes the path index of the tree so that the given number of elements
+  /// can be added anywhere in the tree without growing it
+  void ReserveTree(std::size_t elements);
+
+  /// Copies the names of the child registries. ChildRegistries() lists them
+  /// without copying
   std::set<std::string> GetChildRegistryNames() const;
 
+  /// @return lazy view of the child registries, in order of name
+  RegistryView ChildRegistries() const { return MatchRegistries("*"); }
+
+  /// Lists the elements below this registry whose dotted path relative to it
+  /// matches a glob pattern, in order of full name. '*' matches any run of
+  /// characters within a name and '**' any run of characters across names,
+  /// as in "arm.*.torque" or "arm.**". The names of the tree are kept sorted
+  /// by the root, only elements added since the previous query are sorted
+  /// @param[in] pattern glob pattern
+  /// @return lazy view of the matching elements
+  ElementView MatchElements(std::string_view pattern) const;
+
+  /// Same as MatchElements() for the registries below this registry
+  RegistryView MatchRegistries(std::string_view pattern) const;
+
+  /// @param[in] prefix start of the dotted paths relative to this registry
+  /// @return lazy view of the elements below this registry whose path
+  /// starts with prefix, in order of full name
+  ElementView FindElementsByPrefix(std::string_view prefix) const;
+
+  /// @return hash of the content of the subtree: the names, types, sizes and
+  /// values of the elements below this registry and the names of the
+  /// registries below it. The name of the registry itself is left out and
+  /// the order in which nodes were added does not matter, so that subtrees
+  /// of different trees can be compared, see Diff() in bulk_operations.h.
+  ///
+  /// Every registry caches the hash of its subtree. Writes and additions
+  /// mark the registry holding the node along with its ancestors, which
+  /// costs a single relaxed load once the registry is marked, and only
+  /// marked registries are hashed again: the elements of the registries
+  /// written to and the children of their ancestors. Writes concurrent with
+  /// the call may or may not be reflected, they are by the next call. Calls
+  /// are serialised per tree
+  uint64_t ContentHash() const;
+
+  /// @return current epoch of the tree. Every write stamps the element with
+  /// the epoch in effect once the value is stored, see Element::version()
+  uint64_t epoch() const { return root_->epoch_.load(); }
+
+  /// Starts a new epoch for the whole tree. Elements written from then on,
+  /// including by writes still in progress, have a version of at least the
+  /// returned epoch
+  /// @return the new epoch
+  uint64_t AdvanceEpoch() const;
+
+  /// Subscribes to writes to an element of this tree. Writes are recorded
+  /// and delivered in batches by DispatchChanges()
+  /// @param[in] element element to watch
+  /// @param[in] callback called with the changed elements on dispatch
+  /// @return id of the subscription if the element belongs to this tree, else
+  /// an error code
+  common::ErrorOr<uint64_t> Subscribe(Element* element,
+                                      ChangeCallback callback);
+
+  /// Subscribes to writes to every element of this registry and its
+  /// descendants, including elements added later on
+  /// @param[in] callback called with the changed elements on dispatch
+  /// @return id of the subscription
+  uint64_t SubscribeSubtree(ChangeCallback callback);
+
+  /// Cancels a subscription made on any registry of this tree. A dispatch
+  /// running concurrently on another thread may still deliver one batch
+  /// @param[in] id id returned when subscribing
+  /// @return false if there is no such subscription
+  bool Unsubscribe(uint64_t id);
+
+  /// Delivers the elements written since the previous call to the callbacks
+  /// of the subscriptions covering them, each callback being called at most
+  /// once. Handles the whole tree, whichever registry it is called on. Calls
+  /// are serialised; callbacks must not call DispatchChanges() themselves
+  /// @return number of changed elements
+  std::size_t DispatchChanges();
+
  private:
-  using ChildMap = std::unordered_map<std::string, std::unique_ptr<Registry>>;
-  using ElementMap = std::unordered_map<std::string, std::unique_ptr<Element>>;
+  struct SymbolOf {
+    template <typename Node>
+    internal::Symbol operator()(const Node& node) const {
+      return node.name_;
+    }
+  };
+
+  struct FullNameOf {
+    std::string_view operator()(const Element& element) const {
+      return element.FullName();
+    }
+  };
+
+  // Children are keyed by the symbol of their name. Lookups by name resolve
+  // the symbol first, names that were never interned are not looked up at all
+  using ChildMap = internal::ConcurrentSymbolMap<Registry, SymbolOf>;
+  using ElementMap = internal::ConcurrentSymbolMap<Element, SymbolOf>;
+  using PathIndex = internal::ConcurrentNameMap<Element, FullNameOf>;
 
   template <typename ElementType>
-  common::ErrorOr<ElementType*> FindElementType(const std::string& name) {
+  common::ErrorOr<ElementType*> FindElementType(std::string_view name) {
     common::ErrorOr<Element*> maybe_element = FindElement(name);
     if (!maybe_element.HasValue()) {
       return maybe_element.ErrorOrDie();
     }
     Element* element = maybe_element.ValueOrDie();
-    if (element->type() != TypeTrait<typename ElementType::ValueType>::type) {
+    if (element->type() != TypeTrait<typename ElementType::ValueType>::type ||
+        (element->extent() != 0) != ElementType::kIsArray) {
       return common::Error::kNotFound;
     }
     return static_cast<ElementType*>(element);
   }
 
+  // Elements [begin, end) of the element list of a registry
+  struct ElementRun {
+    Registry const* registry;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  // Largest number of elements handled by one task of a parallel walk
+  static constexpr std::size_t kElementRunSize = 256;
+
+  // Cuts the elements of the subtree into runs of at most kElementRunSize
+  void CollectElementRuns(std::vector<ElementRun>* runs) const;
+
+  template <typename Function>
+  void WalkElements(Function& function) const {
+    element_list_.ForEach(
+        [&function](Element* element) { function(*element); });
+    child_registries_.ForEach(
+        [&function](const Registry& child) { child.WalkElements(function); });
+  }
+
+  // Passes element to visitor as ElementType<T>& for the first of the value
+  // types T it holds, else as Element&
+  template <template <typename> class ElementType, typename... Ts,
+            typename Visitor>
+  static void VisitAs(Element& element, Visitor& visitor) {
+    const TypeEnum type = element.type();
+    const bool visited =
+        ((type == TypeTrait<Ts>::type &&
+          (visitor(static_cast<ElementType<Ts>&>(element)), true)) ||
+         ...);
+    if (!visited) {
+      visitor(element);
+    }
+  }
+
   template <typename ElementType, typename... Args>
-  common::ErrorOr<ElementType*> AddElementType(Args... args) {
-    auto element = std::make_unique<ElementType>(std::forward<Args>(args)...);
-    std::pair<ElementMap::iterator, bool> ref =
-        elements_.emplace(element->name(), std::move(element));
-    if (ref.second) {
-      ref.first->second->registry_ = this;
-      return static_cast<ElementType*>(ref.first->second.get());
+  common::ErrorOr<ElementType*> AddElementType(Args&&... args) {
+    Element* element =
+        InsertElement(CreateNode<ElementType>(std::forward<Args>(args)...));
+    if (element == nullptr) {
+      return common::Error::kUnavailable;
     }
-    return common::Error::kUnavailable;
+    return static_cast<ElementType*>(element);
+  }
+
+  // Adds the element of a declaration, moving its arguments into it
+  // @return the element, nullptr if its name is already in use
+  template <typename Declared>
+  typename std::decay_t<Declared>::Type* AddDeclared(Declared&& declaration) {
+    using ElementType = typename std::decay_t<Declared>::Type;
+    Element* element = std::apply(
+        [this, &declaration](auto&&... args) {
+          return InsertElement(CreateNode<ElementType>(
+              declaration.name, std::forward<decltype(args)>(args)...));
+        },
+        std::forward<Declared>(declaration).args);
+    return static_cast<ElementType*>(element);
   }
 
-  const std::string name_;
+  // Allocates a node on the arena of the tree if it has one, else on the heap
+  template <typename T, typename... Args>
+  internal::NodePtr<T> CreateNode(Args&&... args) {
+    Arena* arena = root_->arena_;
+    if (arena != nullptr) {
+      if constexpr (internal::IsElementArray<T>::value) {
+        // Arrays take their values from the arena as well
+        return internal::NodePtr<T>(
+            arena->Create<T>(std::forward<Args>(args)..., arena),
+            internal::NodeDeleter{true});
+      } else {
+        return internal::NodePtr<T>(
+            arena->Create<T>(std::forward<Args>(args)...),
+            internal::NodeDeleter{true});
+      }
+    }
+    return internal::NodePtr<T>(new T(std::forward<Args>(args)...));
+  }
+
+  // @return child registry of the given name, nullptr if there is none
+  Registry* FindChild(std::string_view name) const;
+
+  // @return element of the given name held by this registry, nullptr if
+  // there is none. Not counted by access instrumentation
+  Element* FindOwnElement(std::string_view name) const;
+
+  // Inserts a child registry created by CreateNode, returning the existing
+  // child if one with the same name is already present
+  std::pair<Registry*, bool> InsertChildRegistry(
+      internal::NodePtr<Registry> child);
+
+  // Watches either an element or the subtree of a registry
+  struct Subscription {
+    Element* element;
+    Registry* registry;
+    ChangeCallback callback;
+    // Elements collected for the callback during a dispatch
+    std::vector<Element*> batch;
+  };
+
+  // Adds delta to the watcher count of every element of the subtree
+  void WatchSubtree(int delta);
+
+  // Marks the registry and its ancestors as changed since their content hash
+  // was computed, up to the first one already marked
+  void MarkContentChanged() const;
+
+  // Appends the marked registries of the subtree, parents first, clearing
+  // their marks
+  void CollectContentChanged(std::vector<Registry const*>* changed) const;
+
+  // Hashes the elements of the registry and combines them with the cached
+  // hashes of its children
+  void UpdateContentHash() const;
+
+  // Makes the element a member of this registry, caching its full name,
+  // assigning its handle and recording it in the path index of the root
+  // @return the element, nullptr if the name is already in use
+  Element* InsertElement(internal::NodePtr<Element> element);
+
   Registry const* parent_;
+  Registry* root_;
+  Arena* arena_;
+
+  // The name is interned, the full name is computed once the registry is
+  // attached and views the name until then, as it does for the root
+  internal::CompactName full_name_;
+  internal::Symbol name_;
+  const internal::StatsId stats_id_;
 
+  // Serialises insertions into this registry, lookups never take it
+  std::mutex mutex_;
   ChildMap child_registries_;
   ElementMap elements_;
+  // Elements in the order they were added, walked by ForEachElement()
+  internal::ConcurrentTable<Element*> element_list_;
+  std::vector<internal::NodePtr<Registry>> owned_child_registries_;
+  std::vector<internal::NodePtr<Element>> owned_elements_;
+
+  // Only populated on the root registry and guarded by index_mutex_. The index
+  // is keyed by views of the full names cached on the elements
+  std::mutex index_mutex_;
+  PathIndex path_index_;
+  internal::ConcurrentTable<Element*> element_table_;
+  // Every registry of the tree but the root, in the order they were added
+  internal::ConcurrentTable<Registry*> registry_table_;
+  mutable internal::SortedNameIndex<Element> sorted_elements_;
+  mutable internal::SortedNameIndex<Registry> sorted_registries_;
+
+  // Only used on the root registry, starts at 1
+  std::atomic<uint64_t> epoch_;
+
+  // Set while the content of the subtree may differ from content_hash_.
+  // Hashes of every registry of the tree are guarded by the
+  // content_hash_mutex_ of the root, marks are only cleared under it
+  mutable std::atomic<bool> content_changed_;
+  mutable uint64_t content_hash_;
+  mutable std::mutex content_hash_mutex_;
+
+  // Number of subtree subscriptions made on this registry, guarded by the
+  // index_mutex_ of the root so that added elements pick it up consistently
+  uint32_t subtree_watchers_;
+
+  // Only used on the root registry. Subscriptions are indexed by the element
+  // or registry they watch. Changed elements form a lock-free intrusive stack
+  // that DispatchChanges() takes whole
+  std::mutex subscription_mutex_;
+  uint64_t next_subscription_id_;
+  std::unordered_map<uint64_t, std::shared_ptr<Subscription>> subscriptions_;
+  std::unordered_map<const void*, std::vector<std::shared_ptr<Subscription>>>
+      subscriptions_by_target_;
+  std::atomic<Element*> changed_elements_;
+  std::mutex dispatch_mutex_;
+  std::vector<Element*> dispatched_elements_;
+  std::vector<std::shared_ptr<Subscription>> dispatched_subscriptions_;
 };
 
+// Elements of arena backed trees keep their names inline, in the symbol table
+// or in the arena, and their value history in the arena, so those with
+// trivially destructible values can be released without running their
+// destructor
+template <typename T>
+struct ArenaDestructorSkippable<Registry::ElementTemplate<T>>
+    : std::is_trivially_destructible<T> {};
+
+// Arrays of arena backed trees also take their values from the arena
+template <typename T>
+struct ArenaDestructorSkippable<Registry::ElementArray<T>> : std::true_type {};
+
 }  // namespace registry
 
 #endif  // REGISTRY_REGISTRY_H_
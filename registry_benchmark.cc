@@ -0,0 +1,1057 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "registry/arena.h"
+#include "registry/bulk_operations.h"
+#include "registry/config_loader.h"
+#include "registry/parameter_server.h"
+#include "registry/recorder.h"
+#include "registry/registry.h"
+#include "registry/registry_path.h"
+#include "registry/serializer.h"
+#include "registry/snapshot.h"
+#include "registry/thread_pool.h"
+
+namespace {
+
+std::atomic<int64_t> allocation_count(0);
+
+}  // namespace
+
+// Count every heap allocation made by the process so that benchmarks can
+// report allocations per operation alongside the timing
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace registry {
+namespace {
+
+// Builds a chain of registries "root.level1...levelN" with a single double
+// element at the bottom and returns the dotted path to that element
+std::string BuildChain(Registry* root, int depth) {
+  std::string path(root->name());
+  Registry* registry = root;
+  for (int level = 1; level <= depth; ++level) {
+    std::string name = "level" + std::to_string(level);
+    registry = registry->FindOrAddChildRegistry(name);
+    path += "." + name;
+  }
+  registry->AddDouble("value");
+  return path + ".value";
+}
+
+// Populates root with 100 child registries each holding elements_per_child
+// double elements
+void BuildWideTree(Registry* root, int elements_per_child) {
+  for (int child = 0; child < 100; ++child) {
+    Registry* registry =
+        root->FindOrAddChildRegistry("child" + std::to_string(child));
+    for (int element = 0; element < elements_per_child; ++element) {
+      registry->AddDouble("element" + std::to_string(element));
+    }
+  }
+}
+
+void ReportAllocations(benchmark::State& state, int64_t start_count) {
+  state.counters["allocs/op"] = benchmark::Counter(
+      static_cast<double>(allocation_count.load() - start_count),
+      benchmark::Counter::kAvgIterations);
+}
+
+void BM_FindElementByExtendedName(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, state.range(0));
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.FindElementByExtendedName(path));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindElementByExtendedName)->Arg(1)->Arg(4)->Arg(16);
+
+void BM_FindElementByLiteral(benchmark::State& state) {
+  Registry root("robot");
+  root.FindOrAddChildRegistry("arm")
+      ->FindOrAddChildRegistry("joint3")
+      ->AddDouble("torque");
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        root.FindElementByExtendedName("robot.arm.joint3.torque"));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindElementByLiteral);
+
+void BM_FindElementByFullName(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, state.range(0));
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.FindElementByFullName(path));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindElementByFullName)->Arg(1)->Arg(4)->Arg(16);
+
+void BM_GetElementByHandle(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, state.range(0));
+  const Registry::ElementHandle handle =
+      root.FindElementHandle(path).ValueOrDie();
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.GetElement(handle));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_GetElementByHandle)->Arg(1)->Arg(16);
+
+std::vector<std::string> ElementNames(int count) {
+  std::vector<std::string> names;
+  for (int index = 0; index < count; ++index) {
+    names.push_back("element" + std::to_string(index));
+  }
+  return names;
+}
+
+// Adds range(1) doubles to an empty registry range(0) levels deep. Only the
+// additions are timed, the tree is built and torn down with timing paused
+void BM_AddElements(benchmark::State& state) {
+  const std::vector<std::string> names = ElementNames(state.range(1));
+  int64_t allocations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto root = std::make_unique<Registry>("root");
+    BuildChain(root.get(), state.range(0));
+    Registry* registry = root.get();
+    for (int level = 1; level <= state.range(0); ++level) {
+      registry = registry->FindChildRegistry("level" + std::to_string(level))
+                     .ValueOrDie();
+    }
+    const int64_t start_count = allocation_count.load();
+    state.ResumeTiming();
+    for (const std::string& name : names) {
+      benchmark::DoNotOptimize(registry->AddDouble(name));
+    }
+    state.PauseTiming();
+    allocations += allocation_count.load() - start_count;
+    root.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+  state.counters["allocs/element"] = static_cast<double>(allocations) /
+                                     (state.iterations() * names.size());
+}
+BENCHMARK(BM_AddElements)
+    ->Args({1, 16})
+    ->Args({1, 1024})
+    ->Args({8, 16})
+    ->Args({8, 1024});
+
+// Adds range(0) doubles with generated names to an empty registry, one at a
+// time against a single AddElements(). Tearing the tree down is not timed
+void BM_DeclareGeneratedOneByOne(benchmark::State& state) {
+  const std::vector<std::string> names = ElementNames(state.range(0));
+  for (auto _ : state) {
+    auto root = std::make_unique<Registry>("root");
+    for (const std::string& name : names) {
+      *root->AddDouble(name).ValueOrDie() = 0.5;
+    }
+    state.PauseTiming();
+    root.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_DeclareGeneratedOneByOne)->Arg(64)->Arg(4096);
+
+void BM_DeclareGeneratedInBulk(benchmark::State& state) {
+  const std::vector<std::string> names = ElementNames(state.range(0));
+  for (auto _ : state) {
+    auto root = std::make_unique<Registry>("root");
+    std::vector<Registry::Declaration<Registry::Double, double>> declarations;
+    declarations.reserve(names.size());
+    for (const std::string& name : names) {
+      declarations.push_back(Registry::Declare<double>(name, 0.5));
+    }
+    benchmark::DoNotOptimize(root->AddElements(std::move(declarations)));
+    state.PauseTiming();
+    root.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_DeclareGeneratedInBulk)->Arg(64)->Arg(4096);
+
+// Finds each of the range(0) elements of a registry by name in turn
+void BM_FindElement(benchmark::State& state) {
+  Registry root("root");
+  const std::vector<std::string> names = ElementNames(state.range(0));
+  for (const std::string& name : names) {
+    root.AddDouble(name);
+  }
+  const int64_t start_count = allocation_count.load();
+  std::size_t index = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.FindElement(names[index]));
+    index = index + 1 == names.size() ? 0 : index + 1;
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindElement)->Arg(16)->Arg(1024)->Arg(65536);
+
+// Reference implementation of FullName() that rebuilds the path on every
+// call, as the registry did before full names were cached
+std::string UncachedFullName(const Registry* registry) {
+  if (registry->parent() == nullptr) {
+    return std::string(registry->name());
+  }
+  return UncachedFullName(registry->parent()) + "." +
+         std::string(registry->name());
+}
+
+std::string UncachedFullName(const Registry::Element* element) {
+  return UncachedFullName(element->registry()) + "." +
+         std::string(element->name());
+}
+
+void BM_FullNameCached(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, state.range(0));
+  const Registry::Element* element =
+      root.FindElementByFullName(path).ValueOrDie();
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(element->FullName().size());
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FullNameCached)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_FullNameUncached(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, state.range(0));
+  const Registry::Element* element =
+      root.FindElementByFullName(path).ValueOrDie();
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(UncachedFullName(element).size());
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FullNameUncached)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_BuildAndTeardownHeap(benchmark::State& state) {
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    Registry root("root");
+    BuildWideTree(&root, state.range(0));
+  }
+  state.SetItemsProcessed(state.iterations() * 100 * state.range(0));
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_BuildAndTeardownHeap)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_BuildAndTeardownArena(benchmark::State& state) {
+  std::size_t space_allocated = 0;
+  for (auto _ : state) {
+    Arena arena;
+    Registry root("root", &arena);
+    BuildWideTree(&root, state.range(0));
+    space_allocated = arena.SpaceAllocated();
+  }
+  state.SetItemsProcessed(state.iterations() * 100 * state.range(0));
+  // Names repeated across child registries are interned once, outside of
+  // the arena
+  state.counters["bytes/element"] = static_cast<double>(space_allocated) /
+                                    (100.0 * state.range(0));
+}
+BENCHMARK(BM_BuildAndTeardownArena)->Arg(10)->Arg(100)->Arg(1000);
+
+// Reads every element of a 10k element tree through its handle, the access
+// pattern of a logger sampling the whole tree each cycle
+void WalkElements(benchmark::State& state, Registry* root) {
+  BuildWideTree(root, 100);
+  std::vector<Registry::ElementHandle> handles;
+  for (int child = 0; child < 100; ++child) {
+    for (int element = 0; element < 100; ++element) {
+      const std::string path = "child" + std::to_string(child) + ".element" +
+                               std::to_string(element);
+      handles.push_back(root->FindElementHandle(path).ValueOrDie());
+    }
+  }
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (Registry::ElementHandle handle : handles) {
+      double value;
+      root->GetElement(handle)->Extract(&value);
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * handles.size());
+}
+
+void BM_WalkHeap(benchmark::State& state) {
+  Registry root("root");
+  WalkElements(state, &root);
+}
+BENCHMARK(BM_WalkHeap);
+
+void BM_WalkArena(benchmark::State& state) {
+  Arena arena;
+  Registry root("root", &arena);
+  WalkElements(state, &root);
+}
+BENCHMARK(BM_WalkArena);
+
+// Sums the 10k doubles of a tree through a typed visitor, the fast path for
+// whole tree operations, against reading each through the type checked
+// Extract of the element
+void BM_VisitElements(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, 100);
+  for (auto _ : state) {
+    double sum = 0.0;
+    root.ForEachElementOfType<double>(
+        [&sum](const Registry::Double& element) { sum += element.value(); });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * root.ElementCount());
+}
+BENCHMARK(BM_VisitElements);
+
+void BM_ForEachElementExtract(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, 100);
+  for (auto _ : state) {
+    double sum = 0.0;
+    root.ForEachElement([&sum](const Registry::Element& element) {
+      double value;
+      element.Extract(&value);
+      sum += value;
+    });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * root.ElementCount());
+}
+BENCHMARK(BM_ForEachElementExtract);
+
+// Baseline for the concurrent element benchmarks: a value guarded by a mutex,
+// as done by users wrapping the whole registry in a lock
+template <typename T>
+class MutexGuarded {
+ public:
+  explicit MutexGuarded(const T& value) : value_(value) {}
+
+  T value() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return value_;
+  }
+
+  void operator=(const T& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = value;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  T value_;
+};
+
+// Thread 0 writes the value continuously while every other thread reads it
+template <typename Holder, typename T>
+void ReadWhileWriting(benchmark::State& state, Holder* holder, const T& a,
+                      const T& b) {
+  if (state.thread_index() == 0) {
+    bool toggle = false;
+    for (auto _ : state) {
+      *holder = toggle ? a : b;
+      toggle = !toggle;
+    }
+  } else {
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(holder->value());
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ConcurrentDoubleElement(benchmark::State& state) {
+  static Registry::Double element("value", 0.0);
+  ReadWhileWriting(state, &element, 1.0, 2.0);
+}
+BENCHMARK(BM_ConcurrentDoubleElement)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_ConcurrentDoubleMutex(benchmark::State& state) {
+  static MutexGuarded<double> element(0.0);
+  ReadWhileWriting(state, &element, 1.0, 2.0);
+}
+BENCHMARK(BM_ConcurrentDoubleMutex)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_ConcurrentStringElement(benchmark::State& state) {
+  static Registry::String element("value", "");
+  ReadWhileWriting(state, &element, std::string("idle"),
+                   std::string("running"));
+}
+BENCHMARK(BM_ConcurrentStringElement)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_ConcurrentStringMutex(benchmark::State& state) {
+  static MutexGuarded<std::string> element("");
+  ReadWhileWriting(state, &element, std::string("idle"),
+                   std::string("running"));
+}
+BENCHMARK(BM_ConcurrentStringMutex)->ThreadRange(1, 8)->UseRealTime();
+
+// Every thread registers 1000 elements into a module of its own while
+// resolving paths into the modules of the other threads
+void BM_ParallelRegistration(benchmark::State& state) {
+  static Registry* root = nullptr;
+  if (state.thread_index() == 0) {
+    root = new Registry("root");
+  }
+  const std::string module = "module" + std::to_string(state.thread_index());
+  for (auto _ : state) {
+    state.PauseTiming();
+    Registry* registry = root->FindOrAddChildRegistry(module);
+    state.ResumeTiming();
+    for (int element = 0; element < 1000; ++element) {
+      registry->AddDouble(module + "_" + std::to_string(element));
+      benchmark::DoNotOptimize(
+          root->FindElementByExtendedName("module0.module0_0"));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 1000);
+  if (state.thread_index() == 0) {
+    delete root;
+  }
+}
+BENCHMARK(BM_ParallelRegistration)->ThreadRange(1, 8)->Iterations(1);
+
+void BM_FindDouble(benchmark::State& state) {
+  Registry root("root");
+  root.AddDouble("value");
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.FindDouble("value"));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindDouble);
+
+// Resolves the full path of an element range(0) registries deep, from a
+// runtime string or from a path hashed at compile time
+void BM_FindByFullName(benchmark::State& state) {
+  Registry root("root");
+  const std::string path = BuildChain(&root, 3);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.FindElementByFullName(path));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindByFullName);
+
+void BM_FindByRegistryPath(benchmark::State& state) {
+  static constexpr auto kPath =
+      MakeRegistryPath<double>("root", "level1", "level2", "level3", "value");
+  Registry root("root");
+  BuildChain(&root, 3);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.Find(kPath));
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_FindByRegistryPath);
+
+// Captures 100 * range(0) double elements and hands the capture over to the
+// reading side
+void BM_SnapshotCapture(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  Snapshot snapshot(root);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    snapshot.Capture();
+    benchmark::DoNotOptimize(snapshot.Acquire());
+  }
+  ReportAllocations(state, start_count);
+  state.SetBytesProcessed(state.iterations() * snapshot.size());
+}
+BENCHMARK(BM_SnapshotCapture)->Arg(1)->Arg(100);
+
+// Dumps 100 * range(0) double elements, with the schema when range(1) is set
+void BM_Serialize(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  Serializer serializer(&root);
+  std::string dump;
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    if (state.range(1)) {
+      serializer.Serialize(&dump);
+    } else {
+      serializer.SerializeValues(&dump);
+    }
+    benchmark::DoNotOptimize(dump.data());
+  }
+  ReportAllocations(state, start_count);
+  state.SetItemsProcessed(state.iterations() * 100 * state.range(0));
+}
+BENCHMARK(BM_Serialize)->Args({10, 0})->Args({10, 1})->Args({100, 0});
+
+void BM_DeserializeValues(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  Serializer serializer(&root);
+  std::string dump;
+  serializer.SerializeValues(&dump);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(serializer.Deserialize(dump));
+  }
+  ReportAllocations(state, start_count);
+  state.SetItemsProcessed(state.iterations() * 100 * state.range(0));
+}
+BENCHMARK(BM_DeserializeValues)->Arg(10)->Arg(100);
+
+// Loads a full dump into an empty tree, creating every element
+void BM_DeserializeSchema(benchmark::State& state) {
+  Registry source("root");
+  BuildWideTree(&source, state.range(0));
+  std::string dump;
+  Serializer(&source).Serialize(&dump);
+  for (auto _ : state) {
+    Registry root("root");
+    Serializer serializer(&root);
+    benchmark::DoNotOptimize(serializer.Deserialize(dump));
+  }
+  state.SetItemsProcessed(state.iterations() * 100 * state.range(0));
+}
+BENCHMARK(BM_DeserializeSchema)->Arg(10);
+
+// Cost of a write with and without a subscription watching the element
+void BM_WriteDouble(benchmark::State& state) {
+  Registry root("root");
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  if (state.range(0)) {
+    root.SubscribeSubtree([](const std::vector<Registry::Element*>&) {});
+  }
+  double written = 0.0;
+  for (auto _ : state) {
+    *value = written;
+    written += 1.0;
+  }
+  root.DispatchChanges();
+}
+BENCHMARK(BM_WriteDouble)->Arg(0)->Arg(1);
+
+// Writes to a double keeping a history of range(0) values, 0 for none, while
+// a reader copies the last 64 values when range(1) is set
+void BM_WriteDoubleWithHistory(benchmark::State& state) {
+  Registry root("root");
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  if (state.range(0) != 0) {
+    value->EnableHistory(state.range(0));
+  }
+  std::atomic<bool> done(false);
+  std::thread reader;
+  if (state.range(1) != 0) {
+    reader = std::thread([value, &done]() {
+      std::vector<ValueHistory<double>::Sample> samples;
+      samples.reserve(64);
+      while (!done.load(std::memory_order_relaxed)) {
+        value->history()->CopyLast(64, &samples);
+      }
+    });
+  }
+  double written = 0.0;
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    *value = written;
+    written += 1.0;
+  }
+  ReportAllocations(state, start_count);
+  done.store(true);
+  if (reader.joinable()) {
+    reader.join();
+  }
+}
+BENCHMARK(BM_WriteDoubleWithHistory)
+    ->Args({0, 0})
+    ->Args({1024, 0})
+    ->Args({1024, 1});
+
+// Learning which of 100 * range(0) elements changed after writes to 10 of
+// them, by dispatching changes or by polling every element
+void BM_DetectChangesDispatch(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  std::size_t changes = 0;
+  root.SubscribeSubtree(
+      [&changes](const std::vector<Registry::Element*>& changed) {
+        changes += changed.size();
+      });
+  for (auto _ : state) {
+    for (uint32_t id = 0; id < 10; ++id) {
+      *static_cast<Registry::Double*>(
+          root.GetElement(Registry::ElementHandle(id))) = changes;
+    }
+    root.DispatchChanges();
+  }
+  benchmark::DoNotOptimize(changes);
+}
+BENCHMARK(BM_DetectChangesDispatch)->Arg(10)->Arg(100);
+
+void BM_DetectChangesPolling(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  const std::size_t count = root.ElementCount();
+  std::vector<double> previous(count);
+  std::size_t changes = 0;
+  for (auto _ : state) {
+    for (uint32_t id = 0; id < 10; ++id) {
+      *static_cast<Registry::Double*>(
+          root.GetElement(Registry::ElementHandle(id))) = changes;
+    }
+    for (uint32_t id = 0; id < count; ++id) {
+      const double value = static_cast<Registry::Double*>(
+                               root.GetElement(Registry::ElementHandle(id)))
+                               ->value();
+      if (value != previous[id]) {
+        previous[id] = value;
+        ++changes;
+      }
+    }
+  }
+  benchmark::DoNotOptimize(changes);
+}
+BENCHMARK(BM_DetectChangesPolling)->Arg(10)->Arg(100);
+
+// Exports the 1% of 100 * range(0) elements written since the previous delta
+void BM_SerializeDelta(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  Serializer serializer(&root);
+  const uint32_t changed = static_cast<uint32_t>(state.range(0));
+  std::string delta;
+  uint64_t since = serializer.SerializeDelta(0, &delta);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    for (uint32_t id = 0; id < changed; ++id) {
+      *static_cast<Registry::Double*>(
+          root.GetElement(Registry::ElementHandle(id))) = since;
+    }
+    since = serializer.SerializeDelta(since, &delta);
+  }
+  ReportAllocations(state, start_count);
+  state.counters["bytes"] = delta.size();
+}
+BENCHMARK(BM_SerializeDelta)->Arg(10)->Arg(100);
+
+// Records rows of 100 * range(0) double elements. Rows go to /dev/null, and
+// time spent waiting for the background thread to free the ring is not
+// measured, so that only the cost on the recording thread is
+void BM_Record(benchmark::State& state) {
+  Registry root("root");
+  BuildWideTree(&root, state.range(0));
+  Recorder recorder(64, 8);
+  recorder.AddSubtree(root);
+  recorder.Open("/dev/null");
+  int64_t timestamp = 0;
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    while (!recorder.Record(++timestamp)) {
+      state.PauseTiming();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      state.ResumeTiming();
+    }
+  }
+  ReportAllocations(state, start_count);
+  recorder.Close();
+  state.SetItemsProcessed(state.iterations() * recorder.column_count());
+}
+BENCHMARK(BM_Record)->Arg(10)->Arg(50);
+
+
+// Writing then reading back range(0) doubles held by a single array element
+// in bulk, against as many scalar elements
+void BM_ArrayBulkSetGet(benchmark::State& state) {
+  Registry root("root");
+  const std::size_t size = state.range(0);
+  Registry::DoubleArray* array =
+      root.AddDoubleArray("array", size).ValueOrDie();
+  std::vector<double> values(size, 1.0);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    array->Set(0, size, values.data());
+    array->Get(0, size, values.data());
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_ArrayBulkSetGet)->Arg(8)->Arg(64)->Arg(512);
+
+void BM_ScalarSetGet(benchmark::State& state) {
+  Registry root("root");
+  const std::size_t size = state.range(0);
+  std::vector<Registry::Double*> elements;
+  for (std::size_t index = 0; index < size; ++index) {
+    elements.push_back(
+        root.AddDouble("value" + std::to_string(index)).ValueOrDie());
+  }
+  std::vector<double> values(size, 1.0);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    for (std::size_t index = 0; index < size; ++index) {
+      *elements[index] = values[index];
+    }
+    for (std::size_t index = 0; index < size; ++index) {
+      values[index] = elements[index]->value();
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_ScalarSetGet)->Arg(8)->Arg(64)->Arg(512);
+
+template <typename T>
+T SampleValue() {
+  return static_cast<T>(42);
+}
+
+template <>
+std::string SampleValue<std::string>() {
+  return "a value longer than the small string buffer";
+}
+
+template <typename T>
+Registry::ElementTemplate<T>* AddSampleElement(Registry* root) {
+  Registry::ElementTemplate<T>* element;
+  if constexpr (std::is_same<T, std::string>::value) {
+    element = root->AddString("value", SampleValue<T>()).ValueOrDie();
+  } else if constexpr (std::is_same<T, bool>::value) {
+    element = root->AddBoolean("value").ValueOrDie();
+  } else if constexpr (std::is_same<T, int32_t>::value) {
+    element = root->AddInt32("value").ValueOrDie();
+  } else {
+    element = root->AddDouble("value").ValueOrDie();
+  }
+  *element = SampleValue<T>();
+  return element;
+}
+
+// Writes then reads back an element of type T through the type checked
+// Assign and Extract of Registry::Element, as generic code does, against the
+// typed value() and assignment of Registry::ElementTemplate
+template <typename T>
+void BM_ElementAssignExtract(benchmark::State& state) {
+  Registry root("root");
+  Registry::Element* element = AddSampleElement<T>(&root);
+  const T written = SampleValue<T>();
+  T read = T();
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    element->Assign(written);
+    element->Extract(&read);
+    benchmark::DoNotOptimize(read);
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK_TEMPLATE(BM_ElementAssignExtract, int32_t);
+BENCHMARK_TEMPLATE(BM_ElementAssignExtract, bool);
+BENCHMARK_TEMPLATE(BM_ElementAssignExtract, double);
+BENCHMARK_TEMPLATE(BM_ElementAssignExtract, std::string);
+
+template <typename T>
+void BM_TemplateSetGet(benchmark::State& state) {
+  Registry root("root");
+  Registry::ElementTemplate<T>* element = AddSampleElement<T>(&root);
+  const T written = SampleValue<T>();
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    *element = written;
+    benchmark::DoNotOptimize(element->value());
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK_TEMPLATE(BM_TemplateSetGet, int32_t);
+BENCHMARK_TEMPLATE(BM_TemplateSetGet, bool);
+BENCHMARK_TEMPLATE(BM_TemplateSetGet, double);
+BENCHMARK_TEMPLATE(BM_TemplateSetGet, std::string);
+
+// Queries against a 50k element tree of 500 registries, as run by user
+// interfaces: listing child registries, a glob across registries, and a
+// prefix scan, against copying the names of the child registries
+void BuildQueryTree(Registry* root) {
+  for (int child = 0; child < 500; ++child) {
+    Registry* registry =
+        root->FindOrAddChildRegistry("child" + std::to_string(child));
+    for (int element = 0; element < 100; ++element) {
+      registry->AddDouble("element" + std::to_string(element));
+    }
+  }
+}
+
+void BM_GetChildRegistryNames(benchmark::State& state) {
+  Registry root("root");
+  BuildQueryTree(&root);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(root.GetChildRegistryNames());
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_GetChildRegistryNames);
+
+void BM_ChildRegistries(benchmark::State& state) {
+  Registry root("root");
+  BuildQueryTree(&root);
+  const int64_t start_count = allocation_count.load();
+  for (auto _ : state) {
+    std::size_t size = 0;
+    for (const Registry& child : root.ChildRegistries()) {
+      size += child.name().size();
+    }
+    benchmark::DoNotOptimize(size);
+  }
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_ChildRegistries);
+
+void BM_MatchElementsGlob(benchmark::State& state) {
+  Registry root("root");
+  BuildQueryTree(&root);
+  for (auto _ : state) {
+    std::size_t count = 0;
+    for (const Registry::Element& element :
+         root.MatchElements("child4*.element7")) {
+      benchmark::DoNotOptimize(&element);
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+}
+BENCHMARK(BM_MatchElementsGlob);
+
+void BM_FindElementsByPrefix(benchmark::State& state) {
+  Registry root("root");
+  BuildQueryTree(&root);
+  for (auto _ : state) {
+    std::size_t count = 0;
+    for (const Registry::Element& element :
+         root.FindElementsByPrefix("child42.element1")) {
+      benchmark::DoNotOptimize(&element);
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+}
+BENCHMARK(BM_FindElementsByPrefix);
+
+// Whole-tree operations over 100k double elements run by a pool of range(0)
+// threads. The trees are built once and shared by every run
+Registry* BulkTree() {
+  static Registry* const root = [] {
+    Registry* registry = new Registry("root");
+    BuildWideTree(registry, 1000);
+    return registry;
+  }();
+  return root;
+}
+
+void BM_ParallelSnapshotCapture(benchmark::State& state) {
+  ThreadPool pool(state.range(0));
+  Snapshot snapshot(*BulkTree());
+  for (auto _ : state) {
+    snapshot.Capture(&pool);
+    benchmark::DoNotOptimize(snapshot.Acquire());
+  }
+  state.SetBytesProcessed(state.iterations() * snapshot.size());
+}
+BENCHMARK(BM_ParallelSnapshotCapture)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+void BM_ParallelSerializeValues(benchmark::State& state) {
+  ThreadPool pool(state.range(0));
+  Serializer serializer(BulkTree());
+  std::string dump;
+  for (auto _ : state) {
+    serializer.SerializeValues(&dump, &pool);
+    benchmark::DoNotOptimize(dump.data());
+  }
+  state.SetBytesProcessed(state.iterations() * dump.size());
+}
+BENCHMARK(BM_ParallelSerializeValues)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+void BM_ParallelResetToDefaults(benchmark::State& state) {
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    ResetToDefaults(BulkTree(), &pool);
+  }
+  state.SetItemsProcessed(state.iterations() * BulkTree()->ElementCount());
+}
+BENCHMARK(BM_ParallelResetToDefaults)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+void BM_ParallelDiff(benchmark::State& state) {
+  static Registry* const other = [] {
+    Registry* registry = new Registry("other");
+    BuildWideTree(registry, 1000);
+    return registry;
+  }();
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Diff(BulkTree(), other, &pool));
+  }
+  state.SetItemsProcessed(state.iterations() * BulkTree()->ElementCount());
+}
+BENCHMARK(BM_ParallelDiff)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+// Diffs two trees of 100k double elements after range(0) writes spread over
+// the first tree. Subtrees left unwritten are skipped by their content hash
+void BM_DiffAfterWrites(benchmark::State& state) {
+  Registry lhs("lhs");
+  Registry rhs("rhs");
+  BuildWideTree(&lhs, 1000);
+  BuildWideTree(&rhs, 1000);
+  std::vector<Registry::Double*> written;
+  for (int64_t write = 0; write < state.range(0); ++write) {
+    const std::string child = "child" + std::to_string(write * 37 % 100);
+    const std::string element = "element" + std::to_string(write * 7 % 1000);
+    written.push_back(lhs.FindOrAddChildRegistry(child)
+                          ->FindDouble(element)
+                          .ValueOrDie());
+  }
+  ThreadPool pool(1);
+  double value = 0.0;
+  for (auto _ : state) {
+    value += 1.0;
+    for (Registry::Double* element : written) {
+      *element = value;
+    }
+    benchmark::DoNotOptimize(Diff(&lhs, &rhs, &pool));
+  }
+  state.SetItemsProcessed(state.iterations() * lhs.ElementCount());
+}
+BENCHMARK(BM_DiffAfterWrites)->Arg(1)->Arg(16)->Arg(256);
+
+// Populates a fresh tree with 50k double parameters from config text, parsed
+// by range(0) threads, against adding and assigning them one at a time
+std::string ConfigText() {
+  std::string text;
+  for (int child = 0; child < 500; ++child) {
+    for (int element = 0; element < 100; ++element) {
+      text += "double child" + std::to_string(child) + ".element" +
+              std::to_string(element) + " = " + std::to_string(element) +
+              ".5\n";
+    }
+  }
+  return text;
+}
+
+void BM_ConfigLoad(benchmark::State& state) {
+  const std::string text = ConfigText();
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    Registry root("root");
+    ConfigLoader loader(&root, &pool);
+    benchmark::DoNotOptimize(loader.Load(text).HasValue());
+  }
+  state.SetItemsProcessed(state.iterations() * 50000);
+}
+BENCHMARK(BM_ConfigLoad)->Arg(1)->Arg(4)->UseRealTime();
+
+void BM_ConfigAddAndAssign(benchmark::State& state) {
+  for (auto _ : state) {
+    Registry root("root");
+    for (int child = 0; child < 500; ++child) {
+      Registry* registry =
+          root.FindOrAddChildRegistry("child" + std::to_string(child));
+      for (int element = 0; element < 100; ++element) {
+        *registry->AddDouble("element" + std::to_string(element))
+             .ValueOrDie() = element + 0.5;
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 50000);
+}
+BENCHMARK(BM_ConfigAddAndAssign)->UseRealTime();
+
+// Reads of 256 double parameters through a parameter server, as batches of
+// range(0) paths pipelined range(1) requests deep. Batches of one awaited
+// one at a time are the round trip per parameter of an unbatched protocol
+void BM_ParameterServerGet(benchmark::State& state) {
+  const std::size_t batch_size = state.range(0);
+  const std::size_t depth = state.range(1);
+  Registry root("root");
+  std::vector<std::string> paths;
+  for (int element = 0; element < 256; ++element) {
+    paths.push_back("element" + std::to_string(element));
+    root.AddDouble(paths.back());
+  }
+  const std::string socket_path =
+      "/tmp/registry_benchmark_" + std::to_string(getpid());
+  ParameterServer server(&root, std::chrono::milliseconds(0));
+  ParameterClient client;
+  if (!server.Start(socket_path) || !client.Connect(socket_path)) {
+    state.SkipWithError("Cannot serve parameters");
+    return;
+  }
+  std::vector<std::vector<std::string>> batches;
+  for (std::size_t first = 0; first < paths.size(); first += batch_size) {
+    batches.emplace_back(paths.begin() + first,
+                         paths.begin() + first + batch_size);
+  }
+  for (auto _ : state) {
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    while (received < batches.size()) {
+      while (sent < batches.size() && sent - received < depth) {
+        client.SendGet(batches[sent++]);
+      }
+      benchmark::DoNotOptimize(client.Receive().HasValue());
+      ++received;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * paths.size());
+}
+BENCHMARK(BM_ParameterServerGet)
+    ->Args({1, 1})
+    ->Args({1, 64})
+    ->Args({16, 1})
+    ->Args({256, 1})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace registry
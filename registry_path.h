@@ -0,0 +1,96 @@
+#ifndef REGISTRY_REGISTRY_PATH_H_
+#define REGISTRY_REGISTRY_PATH_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "registry/concurrent_containers.h"
+#include "registry/registry.h"
+
+namespace registry {
+
+namespace internal {
+
+// Deliberately not constexpr: reaching it while building a path at compile
+// time fails the build, naming the problem in the compiler error
+inline void RegistryPathNameIsEmptyOrHasReservedCharacters() {}
+
+}  // namespace internal
+
+/// @class RegistryPath
+/// Full dotted path to an element holding values of type T, joined from the
+/// names of its registries and of the element at compile time. Declared
+/// constexpr, a path with an empty name or a name holding reserved characters
+/// fails to compile, and its hash is computed by the compiler so that
+/// Registry::Find() does no string work beyond comparing the path once:
+///
+///   constexpr auto kTorque =
+///       MakeRegistryPath<double>("robot", "arm", "joint3", "torque");
+///   Registry::Double* torque = root.Find(kTorque).ValueOrDie();
+///
+/// kSize counts the characters of the path plus a terminating null
+template <typename T, std::size_t kSize>
+class RegistryPath {
+ public:
+  using ValueType = T;
+
+  /// @param[in] names string literals naming the root registry, the
+  /// registries down to the element, then the element
+  template <std::size_t... kSizes>
+  constexpr explicit RegistryPath(const char (&... names)[kSizes])
+      : name_{}, size_(0), hash_(0), valid_(true) {
+    static_assert(sizeof...(kSizes) != 0, "A path holds at least one name");
+    static_assert((kSizes + ...) == kSize,
+                  "kSize must count every name and its separator");
+    (Append(names, kSizes - 1), ...);
+    hash_ = internal::HashName(full_name());
+    if (!valid_ && __builtin_is_constant_evaluated()) {
+      internal::RegistryPathNameIsEmptyOrHasReservedCharacters();
+    }
+  }
+
+  /// @return dotted path, as returned by Element::FullName()
+  constexpr std::string_view full_name() const {
+    return std::string_view(name_.data(), size_);
+  }
+
+  /// @return internal::HashName() of the full name
+  constexpr uint64_t hash() const { return hash_; }
+
+  /// @return false if a name is empty or holds reserved characters. Such
+  /// paths only build outside of constant expressions, and find no element
+  constexpr bool IsValid() const { return valid_; }
+
+ private:
+  constexpr void Append(const char* name, std::size_t length) {
+    if (size_ != 0) {
+      name_[size_++] = internal::kNamespaceCharacter;
+    }
+    valid_ = valid_ && length != 0;
+    for (std::size_t index = 0; index < length; ++index) {
+      valid_ = valid_ && name[index] != '\0' &&
+               !internal::IsReservedCharacter(name[index]);
+      name_[size_++] = name[index];
+    }
+  }
+
+  std::array<char, kSize> name_;
+  std::size_t size_;
+  uint64_t hash_;
+  bool valid_;
+};
+
+/// Builds a RegistryPath from string literals, deducing its size
+/// @param[in] names names of the root registry, the registries down to the
+/// element, then the element
+template <typename T, std::size_t... kSizes>
+constexpr RegistryPath<T, (kSizes + ...)> MakeRegistryPath(
+    const char (&... names)[kSizes]) {
+  return RegistryPath<T, (kSizes + ...)>(names...);
+}
+
+}  // namespace registry
+
+#endif  // REGISTRY_REGISTRY_PATH_H_
@@ -1,8 +1,18 @@
 #include "registry/registry.h"
 
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "common/enum_traits.h"
+#include "registry/registry_path.h"
 
 namespace registry {
 
@@ -82,6 +92,147 @@ TEST_F(RegistryTest, AddBoolElementTest) {
   EXPECT_TRUE(test_search.HasValue());
 }
 
+TEST_F(RegistryTest, FindElementByExtendedNameTest) {
+  Registry registry("robot");
+  Registry* joint3 =
+      registry.FindOrAddChildRegistry("arm")->FindOrAddChildRegistry("joint3");
+  common::ErrorOr<Registry::Double*> torque = joint3->AddDouble("torque");
+  ASSERT_TRUE(torque.HasValue());
+
+  std::string_view path = "robot.arm.joint3.torque";
+  common::ErrorOr<Registry::Element*> test_search =
+      registry.FindElementByExtendedName(path);
+  ASSERT_TRUE(test_search.HasValue());
+  EXPECT_EQ(test_search.ValueOrDie(), torque.ValueOrDie());
+
+  test_search = registry.FindElementByExtendedName(path.substr(6));
+  ASSERT_TRUE(test_search.HasValue());
+  EXPECT_EQ(test_search.ValueOrDie(), torque.ValueOrDie());
+
+  EXPECT_FALSE(
+      registry.FindElementByExtendedName("robot.arm.joint3").HasValue());
+  EXPECT_FALSE(registry.FindElementByExtendedName("robot.leg.joint3.torque")
+                   .HasValue());
+  EXPECT_FALSE(registry.FindElementByExtendedName("arm.joint3.").HasValue());
+}
+
+TEST_F(RegistryTest, ElementHandleTest) {
+  Registry registry("robot");
+  Registry* arm = registry.FindOrAddChildRegistry("arm");
+  common::ErrorOr<Registry::Double*> torque =
+      arm->FindOrAddChildRegistry("joint3")->AddDouble("torque");
+  ASSERT_TRUE(torque.HasValue());
+  common::ErrorOr<Registry::Bool*> enabled = arm->AddBoolean("enabled");
+  ASSERT_TRUE(enabled.HasValue());
+  EXPECT_NE(torque.ValueOrDie()->handle(), enabled.ValueOrDie()->handle());
+
+  common::ErrorOr<Registry::Element*> by_full_name =
+      arm->FindElementByFullName("robot.arm.joint3.torque");
+  ASSERT_TRUE(by_full_name.HasValue());
+  EXPECT_EQ(by_full_name.ValueOrDie(), torque.ValueOrDie());
+  EXPECT_FALSE(registry.FindElementByFullName("arm.joint3.torque").HasValue());
+
+  common::ErrorOr<Registry::ElementHandle> handle =
+      arm->FindElementHandle("joint3.torque");
+  ASSERT_TRUE(handle.HasValue());
+  ASSERT_TRUE(handle.ValueOrDie().IsValid());
+  EXPECT_EQ(registry.GetElement(handle.ValueOrDie()), torque.ValueOrDie());
+  EXPECT_EQ(arm->GetElement(enabled.ValueOrDie()->handle()),
+            enabled.ValueOrDie());
+  EXPECT_FALSE(registry.FindElementHandle("arm.missing").HasValue());
+
+  Registry::Int32 detached("detached", 0);
+  EXPECT_FALSE(detached.handle().IsValid());
+}
+
+TEST_F(RegistryTest, FullNameTest) {
+  Registry registry("robot");
+  EXPECT_EQ(registry.FullName(), "robot");
+  common::ErrorOr<Registry*> arm = registry.AddChildRegistry("arm");
+  ASSERT_TRUE(arm.HasValue());
+  Registry* joint3 = arm.ValueOrDie()->FindOrAddChildRegistry("joint#3");
+  EXPECT_EQ(joint3->FullName(), "robot.arm.joint3");
+  EXPECT_EQ(joint3->parent(), arm.ValueOrDie());
+
+  common::ErrorOr<Registry::Double*> torque = joint3->AddDouble("torque");
+  ASSERT_TRUE(torque.HasValue());
+  EXPECT_EQ(torque.ValueOrDie()->FullName(), "robot.arm.joint3.torque");
+  EXPECT_EQ(torque.ValueOrDie()->registry(), joint3);
+
+  Registry::Int32 detached("detached", 0);
+  EXPECT_EQ(detached.FullName(), "detached");
+  EXPECT_EQ(detached.registry(), nullptr);
+}
+
+TEST_F(RegistryTest, InternedNameTest) {
+  Registry registry("robot");
+  Registry::Bool* left = registry.FindOrAddChildRegistry("left")
+                             ->AddBoolean("enabled")
+                             .ValueOrDie();
+  Registry::Bool* right = registry.FindOrAddChildRegistry("right")
+                              ->AddBoolean("enabled")
+                              .ValueOrDie();
+  // Nodes sharing a name share its storage
+  EXPECT_EQ(left->name().data(), right->name().data());
+  EXPECT_EQ(left->FullName(), "robot.left.enabled");
+  EXPECT_EQ(right->FullName(), "robot.right.enabled");
+
+  // Names that were never interned are not found, nor interned by lookups
+  const std::size_t interned = internal::GlobalSymbolTable().size();
+  EXPECT_FALSE(registry.FindElement("never_added_element").HasValue());
+  EXPECT_FALSE(registry.FindChildRegistry("never_added_registry").HasValue());
+  EXPECT_FALSE(
+      registry.FindElementByExtendedName("never_added.enabled").HasValue());
+  EXPECT_EQ(internal::GlobalSymbolTable().size(), interned);
+  // Interned names are only found in the registries holding them
+  EXPECT_FALSE(registry.FindElement("enabled").HasValue());
+  EXPECT_FALSE(registry.FindChildRegistry("left")
+                   .ValueOrDie()
+                   ->FindChildRegistry("right")
+                   .HasValue());
+}
+
+TEST_F(RegistryTest, ArenaRegistryTest) {
+  Arena arena;
+  Registry registry("robot", &arena);
+  Registry* joint3 =
+      registry.FindOrAddChildRegistry("arm")->FindOrAddChildRegistry("joint3");
+  EXPECT_EQ(registry.FindOrAddChildRegistry("arm"), joint3->parent());
+  common::ErrorOr<Registry::Double*> torque =
+      joint3->AddDouble("torque_with_a_long_name");
+  ASSERT_TRUE(torque.HasValue());
+  common::ErrorOr<Registry::String*> label =
+      joint3->AddString("label", "a label longer than the small string buffer");
+  ASSERT_TRUE(label.HasValue());
+  EXPECT_FALSE(joint3->AddString("label", "duplicate").HasValue());
+  EXPECT_FALSE(joint3->AddDouble("torque_with_a_long_name").HasValue());
+
+  *torque.ValueOrDie() = 2.5;
+  EXPECT_EQ(torque.ValueOrDie()->FullName(),
+            "robot.arm.joint3.torque_with_a_long_name");
+  EXPECT_EQ(label.ValueOrDie()->name(), "label");
+
+  common::ErrorOr<Registry::Double*> found =
+      joint3->FindDouble("torque_with_a_long_name");
+  ASSERT_TRUE(found.HasValue());
+  EXPECT_EQ(found.ValueOrDie()->value(), 2.5);
+  EXPECT_TRUE(
+      registry.FindElementByExtendedName("robot.arm.joint3.label").HasValue());
+  EXPECT_GT(arena.SpaceAllocated(), 0);
+
+  // Arrays take both copies of their values from the arena, and are
+  // released with it
+  static_assert(ArenaDestructorSkippable<Registry::DoubleArray>::value,
+                "Arrays of arena backed trees hold no heap memory");
+  const std::size_t allocated = arena.SpaceAllocated();
+  Registry::DoubleArray* gains =
+      joint3->AddDoubleArray("gains", 4096).ValueOrDie();
+  EXPECT_GE(arena.SpaceAllocated(), allocated + 2 * 4096 * sizeof(double));
+  EXPECT_EQ((*gains)[4095], 0.0);
+  gains->Set(4095, 1.5);
+  EXPECT_EQ((*gains)[4095], 1.5);
+}
+
 TEST_F(RegistryTest, ChildRegistryNamesTest) {
   Registry parent("parent_registry");
   parent.AddChildRegistry("child1");
@@ -116,6 +267,589 @@ TEST_F(RegistryTest, EnumTest) {
   EXPECT_EQ(*registry_retrieved, TestEnum::kEnum1);
 }
 
+TEST_F(RegistryTest, ConcurrentStructureTest) {
+  constexpr int kThreads = 4;
+  constexpr int kElements = 500;
+  Arena arena;
+  Registry registry("robot", &arena);
+  std::atomic<bool> done(false);
+  std::atomic<bool> failed(false);
+
+  // Every writer registers the same modules, so the registries are raced for
+  // while each writer adds its own elements
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([&registry, &failed, thread]() {
+      for (int element = 0; element < kElements; ++element) {
+        Registry* module = registry.FindOrAddChildRegistry(
+            "module" + std::to_string(element % 10));
+        const std::string name =
+            "value" + std::to_string(thread) + "_" + std::to_string(element);
+        common::ErrorOr<Registry::Double*> added = module->AddDouble(name);
+        if (!added.HasValue() ||
+            registry.FindElementByFullName(added.ValueOrDie()->FullName())
+                    .ValueOrDie() != added.ValueOrDie()) {
+          failed = true;
+        }
+      }
+    });
+  }
+  std::thread reader([&registry, &done]() {
+    while (!done) {
+      registry.FindElementByExtendedName("module3.value0_3");
+      registry.GetChildRegistryNames();
+    }
+  });
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  reader.join();
+  EXPECT_FALSE(failed);
+
+  EXPECT_EQ(registry.GetChildRegistryNames().size(), 10);
+  std::set<uint32_t> ids;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    for (int element = 0; element < kElements; ++element) {
+      const std::string path = "module" + std::to_string(element % 10) +
+                               ".value" + std::to_string(thread) + "_" +
+                               std::to_string(element);
+      common::ErrorOr<Registry::ElementHandle> handle =
+          registry.FindElementHandle(path);
+      ASSERT_TRUE(handle.HasValue()) << path;
+      ids.insert(handle.ValueOrDie().id());
+      EXPECT_EQ(registry.GetElement(handle.ValueOrDie())->FullName(),
+                "robot." + path);
+    }
+  }
+  EXPECT_EQ(ids.size(), kThreads * kElements);
+  EXPECT_EQ(*ids.rbegin(), kThreads * kElements - 1);
+}
+
+TEST_F(RegistryTest, SubscribeElementTest) {
+  Registry registry("test_registry");
+  Registry::Int32* watched = registry.AddInt32("watched").ValueOrDie();
+  Registry::Int32* unwatched = registry.AddInt32("unwatched").ValueOrDie();
+
+  std::vector<std::vector<Registry::Element*>> batches;
+  common::ErrorOr<uint64_t> id = registry.Subscribe(
+      watched, [&batches](const std::vector<Registry::Element*>& changed) {
+        batches.push_back(changed);
+      });
+  ASSERT_TRUE(id.HasValue());
+  EXPECT_EQ(registry.DispatchChanges(), 0u);
+
+  // Several writes to an element are delivered once per dispatch
+  *watched = 1;
+  *watched = 2;
+  EXPECT_TRUE(static_cast<Registry::Element*>(watched)->Assign(3));
+  *unwatched = 4;
+  EXPECT_EQ(registry.DispatchChanges(), 1u);
+  ASSERT_EQ(batches.size(), 1u);
+  EXPECT_EQ(batches[0], std::vector<Registry::Element*>{watched});
+  EXPECT_EQ(registry.DispatchChanges(), 0u);
+  EXPECT_EQ(batches.size(), 1u);
+
+  EXPECT_TRUE(registry.Unsubscribe(id.ValueOrDie()));
+  EXPECT_FALSE(registry.Unsubscribe(id.ValueOrDie()));
+  *watched = 5;
+  EXPECT_EQ(registry.DispatchChanges(), 0u);
+  EXPECT_EQ(batches.size(), 1u);
+
+  // Elements of other trees cannot be watched
+  Registry other("other");
+  Registry::Int32* foreign = other.AddInt32("foreign").ValueOrDie();
+  EXPECT_FALSE(
+      registry.Subscribe(foreign, [](const std::vector<Registry::Element*>&) {})
+          .HasValue());
+}
+
+TEST_F(RegistryTest, SubscribeSubtreeTest) {
+  Registry registry("test_registry");
+  Registry* child = registry.AddChildRegistry("child").ValueOrDie();
+  Registry::Double* outside = registry.AddDouble("outside").ValueOrDie();
+  Registry::Double* inside = child->AddDouble("inside").ValueOrDie();
+
+  std::vector<Registry::Element*> subtree_changes;
+  std::vector<Registry::Element*> tree_changes;
+  const uint64_t subtree_id = child->SubscribeSubtree(
+      [&subtree_changes](const std::vector<Registry::Element*>& changed) {
+        subtree_changes.insert(subtree_changes.end(), changed.begin(),
+                               changed.end());
+      });
+  registry.SubscribeSubtree(
+      [&tree_changes](const std::vector<Registry::Element*>& changed) {
+        tree_changes.insert(tree_changes.end(), changed.begin(),
+                            changed.end());
+      });
+
+  // Elements added after subscribing are watched too
+  Registry* grandchild = child->AddChildRegistry("grandchild").ValueOrDie();
+  Registry::Double* late = grandchild->AddDouble("late").ValueOrDie();
+  *outside = 1.0;
+  *late = 2.0;
+  *inside = 3.0;
+  EXPECT_EQ(child->DispatchChanges(), 3u);
+  EXPECT_EQ(subtree_changes, (std::vector<Registry::Element*>{late, inside}));
+  EXPECT_EQ(tree_changes,
+            (std::vector<Registry::Element*>{outside, late, inside}));
+
+  EXPECT_TRUE(registry.Unsubscribe(subtree_id));
+  subtree_changes.clear();
+  *inside = 4.0;
+  EXPECT_EQ(registry.DispatchChanges(), 1u);
+  EXPECT_TRUE(subtree_changes.empty());
+}
+
+// Writes racing with dispatches are never lost: the last value written is
+// always observed by a callback
+TEST_F(RegistryTest, ConcurrentDispatchTest) {
+  Registry registry("test_registry");
+  Registry::Int64* counter = registry.AddInt64("counter").ValueOrDie();
+  int64_t last_seen = 0;
+  registry.Subscribe(
+      counter, [&last_seen](const std::vector<Registry::Element*>& changed) {
+        changed[0]->Extract(&last_seen);
+      });
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (int64_t value = 1; value <= 100000; ++value) {
+      *counter = value;
+    }
+    done = true;
+  });
+  while (!done) {
+    registry.DispatchChanges();
+  }
+  writer.join();
+  registry.DispatchChanges();
+  EXPECT_EQ(last_seen, 100000);
+}
+
+TEST_F(RegistryTest, ElementVersionTest) {
+  Registry registry("test_registry");
+  Registry* child = registry.AddChildRegistry("child").ValueOrDie();
+  EXPECT_EQ(child->epoch(), registry.epoch());
+  const uint64_t first_epoch = registry.epoch();
+  Registry::Int32* first = child->AddInt32("first").ValueOrDie();
+  EXPECT_EQ(first->version(), first_epoch);
+
+  const uint64_t second_epoch = child->AdvanceEpoch();
+  EXPECT_GT(second_epoch, first_epoch);
+  EXPECT_EQ(registry.epoch(), second_epoch);
+  Registry::Int32* second = registry.AddInt32("second").ValueOrDie();
+  EXPECT_EQ(second->version(), second_epoch);
+  EXPECT_EQ(first->version(), first_epoch);
+  *first = 1;
+  EXPECT_EQ(first->version(), second_epoch);
+  registry.AdvanceEpoch();
+  EXPECT_TRUE(static_cast<Registry::Element*>(second)->Assign(2));
+  EXPECT_EQ(second->version(), registry.epoch());
+  EXPECT_EQ(first->version(), second_epoch);
+}
+
+TEST_F(RegistryTest, ContentHashTest) {
+  // Same content added in another order, under roots of other names
+  Registry live("live");
+  Registry baseline("baseline");
+  Registry* arm = live.AddChildRegistry("arm").ValueOrDie();
+  Registry::Double* gain = arm->AddDouble("gain").ValueOrDie();
+  arm->AddString("label", "left");
+  arm->AddDoubleArray("limits", 3);
+  live.AddInt32("mode");
+  baseline.AddInt32("mode");
+  Registry* other_arm = baseline.AddChildRegistry("arm").ValueOrDie();
+  other_arm->AddDoubleArray("limits", 3);
+  other_arm->AddString("label", "left");
+  other_arm->AddDouble("gain");
+  EXPECT_EQ(live.ContentHash(), baseline.ContentHash());
+  EXPECT_EQ(arm->ContentHash(), other_arm->ContentHash());
+
+  const uint64_t hash = live.ContentHash();
+  *gain = 2.0;
+  EXPECT_NE(live.ContentHash(), hash);
+  EXPECT_NE(arm->ContentHash(), other_arm->ContentHash());
+  *gain = 0.0;
+  EXPECT_EQ(live.ContentHash(), hash);
+
+  *arm->FindString("label").ValueOrDie() = "right";
+  EXPECT_NE(live.ContentHash(), hash);
+  *arm->FindString("label").ValueOrDie() = "left";
+  arm->FindDoubleArray("limits").ValueOrDie()->Set(2, 1.0);
+  EXPECT_NE(live.ContentHash(), hash);
+  arm->FindDoubleArray("limits").ValueOrDie()->Set(2, 0.0);
+  EXPECT_EQ(live.ContentHash(), hash);
+
+  // Structural changes, empty registries included
+  live.AddChildRegistry("leg");
+  EXPECT_NE(live.ContentHash(), hash);
+  baseline.AddChildRegistry("leg");
+  EXPECT_EQ(live.ContentHash(), baseline.ContentHash());
+  other_arm->AddBoolean("enabled");
+  EXPECT_NE(live.ContentHash(), baseline.ContentHash());
+  arm->AddBoolean("enabled");
+  EXPECT_EQ(live.ContentHash(), baseline.ContentHash());
+}
+
+TEST_F(RegistryTest, ConcurrentContentHashTest) {
+  Registry live("live");
+  Registry* arm = live.AddChildRegistry("arm").ValueOrDie();
+  Registry::Int64* count = arm->AddInt64("count").ValueOrDie();
+  std::thread writer([count]() {
+    for (int64_t value = 1; value <= 100000; ++value) {
+      *count = value;
+    }
+  });
+  while (count->value() != 100000) {
+    live.ContentHash();
+  }
+  writer.join();
+
+  // Writes are not lost to the hashes computed while they ran
+  Registry baseline("baseline");
+  Registry* other_arm = baseline.AddChildRegistry("arm").ValueOrDie();
+  *other_arm->AddInt64("count").ValueOrDie() = 100000;
+  EXPECT_EQ(live.ContentHash(), baseline.ContentHash());
+}
+
+TEST_F(RegistryTest, RegistryPathTest) {
+  constexpr auto kTorque =
+      MakeRegistryPath<double>("test_registry", "arm", "joint3", "torque");
+  static_assert(kTorque.full_name() == "test_registry.arm.joint3.torque",
+                "Names are joined at compile time");
+  static_assert(
+      kTorque.hash() == internal::HashName("test_registry.arm.joint3.torque"),
+      "Paths are hashed at compile time");
+  static_assert(kTorque.IsValid(), "Valid names make valid paths");
+
+  Registry registry("test_registry");
+  EXPECT_FALSE(registry.Find(kTorque).HasValue());
+  Registry* joint = registry.FindOrAddChildRegistry("arm")
+                        ->FindOrAddChildRegistry("joint3");
+  Registry::Double* torque = joint->AddDouble("torque").ValueOrDie();
+  EXPECT_EQ(registry.Find(kTorque).ValueOrDie(), torque);
+  EXPECT_EQ(joint->Find(kTorque).ValueOrDie(), torque);
+
+  // Lookups are type checked
+  constexpr auto kWrongType =
+      MakeRegistryPath<int32_t>("test_registry", "arm", "joint3", "torque");
+  EXPECT_FALSE(registry.Find(kWrongType).HasValue());
+
+  // Invalid names only build outside of constant expressions, where they
+  // never resolve even though the joined path exists
+  const auto invalid =
+      MakeRegistryPath<double>("test_registry", "arm.joint3", "torque");
+  EXPECT_FALSE(invalid.IsValid());
+  EXPECT_EQ(invalid.full_name(), kTorque.full_name());
+  EXPECT_FALSE(registry.Find(invalid).HasValue());
+}
+
+TEST_F(RegistryTest, ReservedCharactersTest) {
+  static_assert(internal::IsReservedCharacter('.'), "Separators are reserved");
+  static_assert(!internal::IsReservedCharacter('_'), "Underscores are valid");
+  Registry registry("test-registry");
+  EXPECT_EQ(registry.name(), "testregistry");
+  Registry::Int32* element = registry.AddInt32("{element}_1").ValueOrDie();
+  EXPECT_EQ(element->name(), "element_1");
+  EXPECT_EQ(element->FullName(), "testregistry.element_1");
+}
+
+TEST_F(RegistryTest, ArrayElementTest) {
+  Registry registry("test_registry");
+  Registry::DoubleArray* gains =
+      registry.AddDoubleArray("gains", 6).ValueOrDie();
+  EXPECT_EQ(gains->size(), 6u);
+  EXPECT_EQ(gains->extent(), 6u);
+  EXPECT_EQ(gains->value_size(), 6 * sizeof(double));
+  EXPECT_EQ((*gains)[5], 0.0);
+  EXPECT_FALSE(registry.AddDoubleArray("gains", 6).HasValue());
+  EXPECT_EQ(registry.FindDoubleArray("gains").ValueOrDie(), gains);
+  EXPECT_EQ(registry.FindArray<double>("gains").ValueOrDie(), gains);
+
+  const double values[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  EXPECT_TRUE(gains->Set(0, 6, values));
+  EXPECT_TRUE(gains->Set(2, -3.0));
+  double read[6] = {};
+  EXPECT_TRUE(gains->Get(1, 3, read));
+  EXPECT_EQ(read[0], 2.0);
+  EXPECT_EQ(read[1], -3.0);
+  EXPECT_EQ(read[2], 4.0);
+  EXPECT_FALSE(gains->Get(4, 3, read));
+  EXPECT_FALSE(gains->Set(6, 1, values));
+
+  // Arrays and scalars of the same type are told apart
+  Registry::Double* scalar = registry.AddDouble("scalar").ValueOrDie();
+  EXPECT_FALSE(registry.FindArray<double>("scalar").HasValue());
+  EXPECT_FALSE(registry.FindDouble("gains").HasValue());
+  EXPECT_FALSE(registry.FindArray<int32_t>("gains").HasValue());
+  EXPECT_EQ(scalar->extent(), 0u);
+
+  // Type checked access only applies to scalars, while raw bytes copy every
+  // value of the array at once
+  Registry::Element* element = gains;
+  EXPECT_FALSE(element->Assign(1.0));
+  EXPECT_TRUE(element->AssignBytes(values));
+  EXPECT_TRUE(element->ExtractBytes(read));
+  EXPECT_EQ(read[2], 3.0);
+  EXPECT_EQ(read[5], 6.0);
+
+  Registry::Int32Array* counts =
+      registry.AddArray<int32_t>("counts", 3).ValueOrDie();
+  EXPECT_TRUE(counts->Set(1, 7));
+  EXPECT_EQ((*counts)[1], 7);
+}
+
+TEST_F(RegistryTest, ValueHistoryTest) {
+  Registry registry("test_registry");
+  Registry::Double* command = registry.AddDouble("command").ValueOrDie();
+  EXPECT_EQ(command->history(), nullptr);
+  *command = -1.0;
+  ASSERT_TRUE(command->EnableHistory(4));
+  EXPECT_FALSE(command->EnableHistory(8));
+
+  // Every write is recorded, whichever way it comes in
+  *command = 1.0;
+  Registry::Element* element = command;
+  EXPECT_TRUE(element->Assign(2.0));
+  const double bytes = 3.0;
+  EXPECT_TRUE(element->AssignBytes(&bytes));
+  command->Reset();
+  std::vector<ValueHistory<double>::Sample> samples;
+  ASSERT_EQ(command->history()->CopyLast(4, &samples), 4u);
+  EXPECT_EQ(samples[0].value, 1.0);
+  EXPECT_EQ(samples[1].value, 2.0);
+  EXPECT_EQ(samples[2].value, 3.0);
+  EXPECT_EQ(samples[3].value, 0.0);
+
+  // Strings are not trivially copyable and keep no history
+  Registry::String* name = registry.AddString("name", "arm").ValueOrDie();
+  EXPECT_FALSE(name->EnableHistory(4));
+  EXPECT_TRUE(name->history() == nullptr);
+
+  // Histories of arena backed trees are released with the arena
+  Arena arena;
+  Registry arena_registry("robot", &arena);
+  Registry::Double* gain = arena_registry.AddDouble("gain").ValueOrDie();
+  ASSERT_TRUE(gain->EnableHistory(1024));
+  EXPECT_FALSE(gain->EnableHistory(16));
+  *gain = 2.0;
+  ASSERT_EQ(gain->history()->CopyLast(4, &samples), 1u);
+  EXPECT_EQ(samples[0].value, 2.0);
+}
+
+TEST_F(RegistryTest, AddElementsTest) {
+  Registry registry("test_registry");
+  Registry* arm = registry.AddChildRegistry("arm").ValueOrDie();
+  std::string label(64, 'x');
+  auto elements = arm->AddElements(
+      Registry::Declare<int32_t>("mode"),
+      Registry::Declare<double>("gain", 0.5),
+      Registry::Declare<std::string>("label", std::move(label)),
+      Registry::Declare<TestEnum>("state", TestEnum::kEnum1),
+      Registry::DeclareArray<double>("limits", 6));
+  ASSERT_TRUE(elements.HasValue());
+  auto [mode, gain, name, state, limits] = elements.ValueOrDie();
+  EXPECT_EQ(mode, arm->FindInt32("mode").ValueOrDie());
+  EXPECT_EQ(mode->value(), 0);
+  EXPECT_EQ(gain->value(), 0.5);
+  EXPECT_EQ(name->value(), std::string(64, 'x'));
+  EXPECT_EQ(state->value(), TestEnum::kEnum1);
+  EXPECT_EQ(limits->size(), 6u);
+  EXPECT_EQ(registry.FindElementByFullName("test_registry.arm.limits")
+                .ValueOrDie(),
+            limits);
+  EXPECT_EQ(registry.ElementCount(), 5u);
+
+  // Declarations whose name is in use fail, the others are still added
+  EXPECT_FALSE(arm->AddElements(Registry::Declare<bool>("enabled"),
+                                Registry::Declare<double>("gain"))
+                   .HasValue());
+  EXPECT_TRUE(arm->FindBoolean("enabled").HasValue());
+  EXPECT_EQ(arm->FindDouble("gain").ValueOrDie()->value(), 0.5);
+
+  std::vector<Registry::Declaration<Registry::Double, double>> joints;
+  for (int joint = 0; joint < 100; ++joint) {
+    joints.push_back(
+        Registry::Declare<double>("joint" + std::to_string(joint), joint));
+  }
+  common::ErrorOr<std::vector<Registry::Double*>> gains =
+      arm->AddElements(std::move(joints));
+  ASSERT_TRUE(gains.HasValue());
+  ASSERT_EQ(gains.ValueOrDie().size(), 100u);
+  EXPECT_EQ(gains.ValueOrDie()[42], arm->FindDouble("joint42").ValueOrDie());
+  EXPECT_EQ(gains.ValueOrDie()[42]->value(), 42.0);
+
+  // Initial values are moved into string elements
+  Registry::String* text =
+      arm->AddString("text", std::string(64, 'y')).ValueOrDie();
+  EXPECT_EQ(text->value(), std::string(64, 'y'));
+}
+
+TEST_F(RegistryTest, VisitTest) {
+  Registry registry("test_registry");
+  Registry* child = registry.AddChildRegistry("child").ValueOrDie();
+  Registry* grandchild = child->AddChildRegistry("grandchild").ValueOrDie();
+  *registry.AddDouble("double").ValueOrDie() = 1.5;
+  *child->AddInt32("int32").ValueOrDie() = 3;
+  *child->AddDouble("other_double").ValueOrDie() = 2.5;
+  grandchild->AddString("string", "text");
+  grandchild->AddEnum<TestEnum>("enum");
+  grandchild->AddDoubleArray("array", 4);
+  Registry other("other");
+  other.AddDouble("outside");
+
+  // Every element of the subtree is visited once, depth-first
+  std::vector<std::string_view> names;
+  registry.ForEachElement([&names](const Registry::Element& element) {
+    names.push_back(element.FullName());
+  });
+  ASSERT_EQ(names.size(), 6u);
+  EXPECT_EQ(names[0], "test_registry.double");
+  EXPECT_EQ(names[1], "test_registry.child.int32");
+  EXPECT_EQ(names[2], "test_registry.child.other_double");
+  EXPECT_EQ(names[3], "test_registry.child.grandchild.string");
+  names.clear();
+  grandchild->ForEachElement([&names](const Registry::Element& element) {
+    names.push_back(element.FullName());
+  });
+  EXPECT_EQ(names.size(), 3u);
+
+  // Visitors get the concrete class of every element
+  double sum = 0.0;
+  int strings = 0;
+  int arrays = 0;
+  int others = 0;
+  registry.Visit([&](auto& element) {
+    using ElementType = typename std::decay<decltype(element)>::type;
+    if constexpr (std::is_same<ElementType, Registry::Double>::value ||
+                  std::is_same<ElementType, Registry::Int32>::value) {
+      sum += element.value();
+    } else if constexpr (std::is_same<ElementType, Registry::String>::value) {
+      EXPECT_EQ(element.value(), "text");
+      ++strings;
+    } else if constexpr (std::is_same<ElementType,
+                                      Registry::DoubleArray>::value) {
+      EXPECT_EQ(element.size(), 4u);
+      ++arrays;
+    } else {
+      EXPECT_TRUE((std::is_same<ElementType, Registry::Element>::value));
+      EXPECT_EQ(element.name(), "enum");
+      ++others;
+    }
+  });
+  EXPECT_EQ(sum, 7.0);
+  EXPECT_EQ(strings, 1);
+  EXPECT_EQ(arrays, 1);
+  EXPECT_EQ(others, 1);
+
+  // Filtered walks only see scalars of the requested type
+  sum = 0.0;
+  int doubles = 0;
+  registry.ForEachElementOfType<double>([&](Registry::Double& element) {
+    sum += element.value();
+    element = 0.0;
+    ++doubles;
+  });
+  EXPECT_EQ(doubles, 2);
+  EXPECT_EQ(sum, 4.0);
+  EXPECT_EQ(registry.FindDouble("double").ValueOrDie()->value(), 0.0);
+}
+
+TEST_F(RegistryTest, GlobTest) {
+  using internal::MatchesGlob;
+  EXPECT_TRUE(MatchesGlob("arm.joint3.torque", "arm.joint3.torque"));
+  EXPECT_FALSE(MatchesGlob("arm.joint3.torque", "arm.joint3.torque2"));
+  EXPECT_TRUE(MatchesGlob("arm.*.torque", "arm.joint3.torque"));
+  EXPECT_TRUE(MatchesGlob("arm.joint*.torque", "arm.joint3.torque"));
+  EXPECT_TRUE(MatchesGlob("arm.*.*", "arm.joint3.torque"));
+  EXPECT_FALSE(MatchesGlob("arm.*.torque", "arm.joint3.motor.torque"));
+  EXPECT_FALSE(MatchesGlob("arm.*", "arm.joint3.torque"));
+  EXPECT_TRUE(MatchesGlob("arm.**", "arm.joint3.torque"));
+  EXPECT_TRUE(MatchesGlob("**.torque", "arm.joint3.motor.torque"));
+  EXPECT_FALSE(MatchesGlob("**.torque", "torque"));
+  EXPECT_TRUE(MatchesGlob("*", ""));
+  EXPECT_FALSE(MatchesGlob("", "arm"));
+  EXPECT_TRUE(MatchesGlob("a*b.**.c*", "axxb.y.z.cc"));
+  EXPECT_FALSE(MatchesGlob("a*b.c", "axb.yb.c"));
+
+  // Patterns of many wildcards failing late, as clients of the parameter
+  // server may send, match in polynomial time
+  const std::string name(40, 'a');
+  EXPECT_FALSE(MatchesGlob("*a*a*a*a*a*a*a*a*a*a*b", name));
+  EXPECT_FALSE(MatchesGlob("**a**a**a**a**a**a**a**a**a**a**b", name));
+  EXPECT_TRUE(MatchesGlob("*a*a*a*a*a*a*a*a*a*a*", name));
+
+  // Mismatches tell how much of the name matched, and why the rest fails
+  using internal::FindGlobMismatch;
+  using internal::GlobMismatch;
+  EXPECT_EQ(FindGlobMismatch("arm.*.torque", "arm.joint3.torque").kind,
+            GlobMismatch::kMatch);
+  GlobMismatch mismatch = FindGlobMismatch("arm.j*1.torque", "arm.joint3.x");
+  EXPECT_EQ(mismatch.kind, GlobMismatch::kName);
+  EXPECT_EQ(mismatch.matched, 4u);
+  EXPECT_EQ(mismatch.literal, "j");
+  mismatch = FindGlobMismatch("arm.*", "arm.joint3.torque");
+  EXPECT_EQ(mismatch.kind, GlobMismatch::kTooDeep);
+  EXPECT_EQ(mismatch.matched, 11u);
+  EXPECT_EQ(FindGlobMismatch("arm.*.*", "arm.joint3").kind,
+            GlobMismatch::kTooShallow);
+}
+
+TEST_F(RegistryTest, MatchTest) {
+  Registry registry("robot");
+  Registry* arm = registry.AddChildRegistry("arm").ValueOrDie();
+  for (const char* joint : {"joint2", "joint1", "joint3"}) {
+    Registry* child = arm->AddChildRegistry(joint).ValueOrDie();
+    child->AddDouble("torque");
+    child->AddDouble("velocity");
+  }
+  arm->FindOrAddChildRegistry("joint2")
+      ->AddChildRegistry("motor")
+      .ValueOrDie()
+      ->AddDouble("torque");
+  registry.AddChildRegistry("base").ValueOrDie()->AddInt32("mode");
+
+  // Results come sorted by full name
+  std::vector<std::string_view> names;
+  for (const Registry::Element& element :
+       registry.MatchElements("arm.*.torque")) {
+    names.push_back(element.FullName());
+  }
+  ASSERT_EQ(names.size(), 3u);
+  EXPECT_EQ(names[0], "robot.arm.joint1.torque");
+  EXPECT_EQ(names[1], "robot.arm.joint2.torque");
+  EXPECT_EQ(names[2], "robot.arm.joint3.torque");
+
+  EXPECT_EQ(registry.MatchElements("**.torque").size(), 4u);
+  EXPECT_EQ(registry.MatchElements("arm.*3.*").size(), 2u);
+  EXPECT_EQ(registry.MatchElements("*.*.velocity").size(), 3u);
+  EXPECT_EQ(registry.MatchElements("**").size(), 8u);
+  EXPECT_EQ(arm->MatchElements("joint2.**").size(), 3u);
+  EXPECT_TRUE(registry.MatchElements("leg.**").empty());
+  EXPECT_EQ(registry.FindElementsByPrefix("arm.joint3.").size(), 2u);
+  EXPECT_EQ(registry.FindElementsByPrefix("b").begin()->FullName(),
+            "robot.base.mode");
+
+  // Child registries are listed in name order, without their descendants
+  names.clear();
+  for (const Registry& child : arm->ChildRegistries()) {
+    names.push_back(child.name());
+  }
+  ASSERT_EQ(names.size(), 3u);
+  EXPECT_EQ(names[0], "joint1");
+  EXPECT_EQ(names[2], "joint3");
+  EXPECT_EQ(registry.MatchRegistries("**").size(), 6u);
+
+  // Views list the tree as it was when they were created, later queries
+  // pick up additions
+  Registry::ElementView view = registry.MatchElements("base.*");
+  registry.FindOrAddChildRegistry("base")->AddInt32("count");
+  EXPECT_EQ(view.size(), 1u);
+  EXPECT_EQ(registry.MatchElements("base.*").size(), 2u);
+  EXPECT_EQ(registry.GetChildRegistryNames(),
+            (std::set<std::string>{"arm", "base"}));
+}
+
 TEST(RegistryElementTest, ConstructDestructTest) {
   std::unique_ptr<Registry::Element> parameter_int32 =
       std::unique_ptr<Registry::Int32>(new Registry::Int32("test_int32", -1));
@@ -177,4 +911,107 @@ TEST(RegistryElementTest, NumericalOperatorTest) {
   EXPECT_EQ(a, 5);
 }
 
+TEST(RegistryElementTest, ConcurrentScalarTest) {
+  constexpr int64_t kWrites = 200000;
+  Registry::Int64 element("counter", 0);
+  std::atomic<bool> failed(false);
+
+  std::vector<std::thread> readers;
+  for (int reader = 0; reader < 4; ++reader) {
+    readers.emplace_back([&element, &failed, reader]() {
+      // A single writer publishes increasing values, so every reader has to
+      // observe a non-decreasing sequence
+      int64_t last = 0;
+      while (last < kWrites) {
+        int64_t value = 0;
+        if (reader % 2 == 0) {
+          value = element.value();
+        } else {
+          static_cast<Registry::Element&>(element).Extract(&value);
+        }
+        if (value < last) {
+          failed = true;
+        }
+        last = value;
+      }
+    });
+  }
+  for (int64_t value = 1; value <= kWrites; ++value) {
+    if (value % 2 == 0) {
+      element = value;
+    } else {
+      static_cast<Registry::Element&>(element).Assign(value);
+    }
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_FALSE(failed);
+}
+
+// Readers never see an array torn between two bulk writes
+TEST(RegistryElementTest, ConcurrentArrayTest) {
+  constexpr std::size_t kSize = 64;
+  Registry::Int64Array array("array", kSize);
+  std::atomic<bool> done(false);
+  std::thread writer([&array, &done]() {
+    int64_t values[kSize];
+    for (int64_t write = 1; write <= 10000; ++write) {
+      std::fill(values, values + kSize, write);
+      array.Set(0, kSize, values);
+    }
+    done = true;
+  });
+  int64_t values[kSize];
+  while (!done) {
+    array.Get(0, kSize, values);
+    for (std::size_t index = 1; index < kSize; ++index) {
+      ASSERT_EQ(values[index], values[0]);
+    }
+  }
+  writer.join();
+  EXPECT_EQ(array[kSize - 1], 10000);
+}
+
+TEST(RegistryElementTest, ConcurrentStringTest) {
+  Registry::String element("label", std::string(1, 'a'));
+  std::atomic<bool> done(false);
+  std::atomic<bool> failed(false);
+
+  std::vector<std::thread> readers;
+  for (int reader = 0; reader < 4; ++reader) {
+    readers.emplace_back([&element, &done, &failed, reader]() {
+      // Every value written is a run of a single character whose length is
+      // determined by that character, a torn read would break the pattern
+      while (!done) {
+        std::string value;
+        if (reader % 2 == 0) {
+          value = element.value();
+        } else {
+          static_cast<Registry::Element&>(element).Extract(&value);
+        }
+        if (value.empty() ||
+            value != std::string(value[0] - 'a' + 1, value[0])) {
+          failed = true;
+        }
+      }
+    });
+  }
+  for (int write = 0; write < 26 * 1000; ++write) {
+    const char character = 'a' + write % 26;
+    std::string value(character - 'a' + 1, character);
+    if (write % 2 == 0) {
+      element = value;
+    } else {
+      static_cast<Registry::Element&>(element).Assign(value);
+    }
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(element.value(), std::string(26, 'z'));
+}
+
 }  // namespace registry
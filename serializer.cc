@@ -0,0 +1,664 @@
+#include "registry/serializer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "registry/concurrent_containers.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Reads and writes the values of one type of element. Typed values are
+/// loaded through the type checked Element::Assign; enum values, whose type
+/// is not known here, are copied as raw bytes of the recorded size, as are
+/// all the values of array elements at once
+struct ValueCodec {
+  using Add = common::ErrorOr<Registry::Element*> (*)(
+      Registry*, const std::string& name, std::size_t extent);
+
+  // Size of the values in the packed block, 0 for length prefixed strings.
+  // Array elements take extent values
+  std::size_t size;
+  void (*write)(const Registry::Element& element, char* out);
+  bool (*read)(Registry::Element* element, const char* in);
+  // Creates an element of the type, nullptr for enums
+  Add add;
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::ValueCodec;
+
+constexpr uint16_t kHasSchema = 0x1;
+constexpr uint16_t kDelta = 0x2;
+constexpr std::size_t kBlockAlignment = 8;
+
+struct Header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t element_count;
+  uint32_t schema_size;
+  uint64_t fingerprint;
+};
+static_assert(sizeof(Header) == 24, "Header must not contain padding");
+
+// Every schema entry starts with its type, value size, path length and
+// extent
+constexpr std::size_t kSchemaEntrySize = 8;
+
+// alignment must be a power of two
+std::size_t AlignUp(std::size_t offset, std::size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Values of power of two sizes up to the block alignment are aligned to
+// their size
+std::size_t ValueAlignment(std::size_t size) {
+  return std::min(size & (~size + 1), kBlockAlignment);
+}
+
+template <typename T>
+void WriteValue(const Registry::Element& element, char* out) {
+  const T value =
+      static_cast<const Registry::ElementTemplate<T>&>(element).value();
+  std::memcpy(out, &value, sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(Registry::Element* element, const char* in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  return element->Assign(value);
+}
+
+template <std::size_t kSize>
+void WriteBytes(const Registry::Element& element, char* out) {
+  uint64_t word = 0;
+  element.ExtractBytes(&word);
+  std::memcpy(out, &word, kSize);
+}
+
+template <std::size_t kSize>
+bool ReadBytes(Registry::Element* element, const char* in) {
+  uint64_t word = 0;
+  std::memcpy(&word, in, kSize);
+  return element->AssignBytes(&word);
+}
+
+void WriteArray(const Registry::Element& element, char* out) {
+  element.ExtractBytes(out);
+}
+
+bool ReadArray(Registry::Element* element, const char* in) {
+  return element->AssignBytes(in);
+}
+
+template <typename ElementType>
+common::ErrorOr<Registry::Element*> Added(
+    common::ErrorOr<ElementType*> maybe_element) {
+  if (!maybe_element.HasValue()) {
+    return maybe_element.ErrorOrDie();
+  }
+  return static_cast<Registry::Element*>(maybe_element.ValueOrDie());
+}
+
+template <typename T>
+constexpr ValueCodec TypedCodec(ValueCodec::Add add) {
+  return ValueCodec{sizeof(T), &WriteValue<T>, &ReadValue<T>, add};
+}
+
+template <std::size_t kSize>
+constexpr ValueCodec BytesCodec() {
+  return ValueCodec{kSize, &WriteBytes<kSize>, &ReadBytes<kSize>, nullptr};
+}
+
+template <typename T>
+constexpr ValueCodec ArrayCodec() {
+  return ValueCodec{
+      sizeof(T), &WriteArray, &ReadArray,
+      [](Registry* registry, const std::string& name, std::size_t extent) {
+        return Added(registry->AddArray<T>(name, extent));
+      }};
+}
+
+// Arrays of enums, which cannot be created here
+template <std::size_t kSize>
+constexpr ValueCodec ArrayBytesCodec() {
+  return ValueCodec{kSize, &WriteArray, &ReadArray, nullptr};
+}
+
+const ValueCodec kInt32Codec = TypedCodec<int32_t>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddInt32(name));
+    });
+const ValueCodec kUnsignedInt32Codec = TypedCodec<uint32_t>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddUnsignedInt32(name));
+    });
+const ValueCodec kInt64Codec = TypedCodec<int64_t>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddInt64(name));
+    });
+const ValueCodec kUnsignedInt64Codec = TypedCodec<uint64_t>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddUnsignedInt64(name));
+    });
+const ValueCodec kBoolCodec = TypedCodec<bool>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddBoolean(name));
+    });
+const ValueCodec kCharCodec = TypedCodec<char>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddChar(name, TypeTrait<char>::default_value));
+    });
+const ValueCodec kFloatCodec = TypedCodec<float>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddFloat(name));
+    });
+const ValueCodec kDoubleCodec = TypedCodec<double>(
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(registry->AddDouble(name));
+    });
+const ValueCodec kStringCodec = ValueCodec{
+    0, nullptr, nullptr,
+    [](Registry* registry, const std::string& name, std::size_t) {
+      return Added(
+          registry->AddString(name, TypeTrait<std::string>::default_value));
+    }};
+const ValueCodec kBytesCodecs[] = {BytesCodec<1>(), BytesCodec<2>(),
+                                   BytesCodec<4>(), BytesCodec<8>()};
+const ValueCodec kInt32ArrayCodec = ArrayCodec<int32_t>();
+const ValueCodec kUnsignedInt32ArrayCodec = ArrayCodec<uint32_t>();
+const ValueCodec kInt64ArrayCodec = ArrayCodec<int64_t>();
+const ValueCodec kUnsignedInt64ArrayCodec = ArrayCodec<uint64_t>();
+const ValueCodec kBoolArrayCodec = ArrayCodec<bool>();
+const ValueCodec kCharArrayCodec = ArrayCodec<char>();
+const ValueCodec kFloatArrayCodec = ArrayCodec<float>();
+const ValueCodec kDoubleArrayCodec = ArrayCodec<double>();
+const ValueCodec kArrayBytesCodecs[] = {
+    ArrayBytesCodec<1>(), ArrayBytesCodec<2>(), ArrayBytesCodec<4>(),
+    ArrayBytesCodec<8>()};
+
+// @return codec for arrays of values of the given type and size, nullptr if
+// the combination is not supported
+const ValueCodec* ArrayCodecFor(TypeEnum type, std::size_t size) {
+  const ValueCodec* codec = nullptr;
+  if (type == TypeTrait<int32_t>::type) {
+    codec = &kInt32ArrayCodec;
+  } else if (type == TypeTrait<uint32_t>::type) {
+    codec = &kUnsignedInt32ArrayCodec;
+  } else if (type == TypeTrait<int64_t>::type) {
+    codec = &kInt64ArrayCodec;
+  } else if (type == TypeTrait<uint64_t>::type) {
+    codec = &kUnsignedInt64ArrayCodec;
+  } else if (type == TypeTrait<bool>::type) {
+    codec = &kBoolArrayCodec;
+  } else if (type == TypeTrait<char>::type) {
+    codec = &kCharArrayCodec;
+  } else if (type == TypeTrait<float>::type) {
+    codec = &kFloatArrayCodec;
+  } else if (type == TypeTrait<double>::type) {
+    codec = &kDoubleArrayCodec;
+  } else if (type != TypeTrait<std::string>::type) {
+    for (const ValueCodec& bytes_codec : kArrayBytesCodecs) {
+      if (bytes_codec.size == size) {
+        codec = &bytes_codec;
+      }
+    }
+  }
+  return codec != nullptr && codec->size == size ? codec : nullptr;
+}
+
+// @return codec for values of the given type and size, held by arrays of
+// extent values unless extent is 0, nullptr if the combination is not
+// supported
+const ValueCodec* CodecFor(TypeEnum type, std::size_t size,
+                          std::size_t extent) {
+  if (extent != 0) {
+    return ArrayCodecFor(type, size);
+  }
+  const ValueCodec* codec = nullptr;
+  if (type == TypeTrait<int32_t>::type) {
+    codec = &kInt32Codec;
+  } else if (type == TypeTrait<uint32_t>::type) {
+    codec = &kUnsignedInt32Codec;
+  } else if (type == TypeTrait<int64_t>::type) {
+    codec = &kInt64Codec;
+  } else if (type == TypeTrait<uint64_t>::type) {
+    codec = &kUnsignedInt64Codec;
+  } else if (type == TypeTrait<bool>::type) {
+    codec = &kBoolCodec;
+  } else if (type == TypeTrait<char>::type) {
+    codec = &kCharCodec;
+  } else if (type == TypeTrait<float>::type) {
+    codec = &kFloatCodec;
+  } else if (type == TypeTrait<double>::type) {
+    codec = &kDoubleCodec;
+  } else if (type == TypeTrait<std::string>::type) {
+    codec = &kStringCodec;
+  } else {
+    for (const ValueCodec& bytes_codec : kBytesCodecs) {
+      if (bytes_codec.size == size) {
+        codec = &bytes_codec;
+      }
+    }
+  }
+  return codec != nullptr && codec->size == size ? codec : nullptr;
+}
+
+// Appends a string prefixed with its length
+void AppendString(const std::string& value, std::string* out) {
+  const uint32_t size = static_cast<uint32_t>(value.size());
+  out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  out->append(value);
+}
+
+// Reads a length prefixed string at offset into element, moving offset past
+// the string
+bool ReadString(std::string_view data, std::size_t* offset,
+                Registry::Element* element) {
+  uint32_t size;
+  if (*offset + sizeof(size) > data.size()) {
+    return false;
+  }
+  std::memcpy(&size, data.data() + *offset, sizeof(size));
+  *offset += sizeof(size);
+  if (*offset + size > data.size() ||
+      !element->Assign(std::string(data.substr(*offset, size)))) {
+    return false;
+  }
+  *offset += size;
+  return true;
+}
+
+std::string_view RelativePath(const Registry& registry,
+                              const Registry::Element& element) {
+  return element.FullName().substr(registry.FullName().size() + 1);
+}
+
+// Entry of the schema of a dump, checked before any element is created
+struct SchemaEntry {
+  TypeEnum type;
+  const ValueCodec* codec;
+  std::size_t extent;
+  std::string_view path;
+};
+
+// Resolves a path of a schema to an element, creating the element and the
+// registries leading to it when they are missing
+// @param[in] create false to only check that the element either exists with
+// the type of the schema or can be created, nullptr standing for the latter
+common::ErrorOr<Registry::Element*> FindOrAddElement(
+    Registry* registry, std::string_view path, TypeEnum type,
+    const ValueCodec& codec, std::size_t extent, bool create, bool* added) {
+  std::string_view::size_type separator =
+      path.find(internal::kNamespaceCharacter);
+  while (separator != std::string_view::npos) {
+    if (separator == 0) {
+      return common::Error::kUnavailable;
+    }
+    if (create) {
+      registry = registry->FindOrAddChildRegistry(
+          std::string(path.substr(0, separator)));
+    } else if (registry != nullptr) {
+      common::ErrorOr<Registry*> maybe_registry =
+          registry->FindChildRegistry(path.substr(0, separator));
+      registry =
+          maybe_registry.HasValue() ? maybe_registry.ValueOrDie() : nullptr;
+    }
+    path.remove_prefix(separator + 1);
+    separator = path.find(internal::kNamespaceCharacter);
+  }
+  if (path.empty()) {
+    return common::Error::kUnavailable;
+  }
+  common::ErrorOr<Registry::Element*> maybe_element =
+      registry != nullptr ? registry->FindElement(path)
+                          : common::Error::kNotFound;
+  if (maybe_element.HasValue()) {
+    Registry::Element* element = maybe_element.ValueOrDie();
+    const std::size_t value_count = extent != 0 ? extent : 1;
+    if (element->type() != type || element->extent() != extent ||
+        element->value_size() != codec.size * value_count) {
+      return common::Error::kUnavailable;
+    }
+    return element;
+  }
+  if (codec.add == nullptr) {
+    return common::Error::kNotFound;
+  }
+  if (!create) {
+    return nullptr;
+  }
+  *added = true;
+  return codec.add(registry, std::string(path), extent);
+}
+
+}  // namespace
+
+Serializer::Serializer(Registry* registry)
+    : registry_(registry), fingerprint_(0), fixed_size_(0) {
+  Build();
+}
+
+void Serializer::Build() {
+  entries_.clear();
+  registry_->ForEachElement([this](Registry::Element& element) {
+    const std::size_t extent = element.extent();
+    const std::size_t size =
+        extent != 0 ? element.value_size() / extent : element.value_size();
+    if (const ValueCodec* codec = CodecFor(element.type(), size, extent)) {
+      entries_.push_back(Entry{
+          &element, codec, static_cast<uint32_t>(element.value_size()), 0});
+    }
+  });
+  // Larger values first keeps every value of the packed block aligned, the
+  // path makes the order independent of the order elements were added in
+  std::sort(entries_.begin(), entries_.end(),
+            [this](const Entry& lhs, const Entry& rhs) {
+              if (lhs.codec->size != rhs.codec->size) {
+                return lhs.codec->size > rhs.codec->size;
+              }
+              if (lhs.element->type() != rhs.element->type()) {
+                return lhs.element->type() < rhs.element->type();
+              }
+              return RelativePath(*registry_, *lhs.element) <
+                     RelativePath(*registry_, *rhs.element);
+            });
+
+  fixed_size_ = LayOut(&entries_);
+  schema_.clear();
+  for (const Entry& entry : entries_) {
+    const std::string_view path = RelativePath(*registry_, *entry.element);
+    const uint16_t path_size = static_cast<uint16_t>(path.size());
+    const uint32_t extent = static_cast<uint32_t>(entry.element->extent());
+    const char prefix[kSchemaEntrySize] = {
+        static_cast<char>(entry.element->type()),
+        static_cast<char>(entry.codec->size),
+        static_cast<char>(path_size & 0xff),
+        static_cast<char>(path_size >> 8),
+        static_cast<char>(extent & 0xff),
+        static_cast<char>((extent >> 8) & 0xff),
+        static_cast<char>((extent >> 16) & 0xff),
+        static_cast<char>(extent >> 24)};
+    schema_.append(prefix, kSchemaEntrySize);
+    schema_.append(path.data(), path_size);
+  }
+  fingerprint_ = internal::HashName(schema_);
+}
+
+std::size_t Serializer::LayOut(std::vector<Entry>* entries) {
+  std::size_t size = 0;
+  for (Entry& entry : *entries) {
+    if (entry.codec->size != 0) {
+      size = AlignUp(size, ValueAlignment(entry.codec->size));
+      entry.offset = static_cast<uint32_t>(size);
+      size += entry.size;
+    }
+  }
+  return size;
+}
+
+void Serializer::Serialize(std::string* out) const {
+  Write(true, nullptr, out);
+}
+
+void Serializer::Serialize(std::string* out, ThreadPool* pool) const {
+  Write(true, pool, out);
+}
+
+void Serializer::SerializeValues(std::string* out) const {
+  Write(false, nullptr, out);
+}
+
+void Serializer::SerializeValues(std::string* out, ThreadPool* pool) const {
+  Write(false, pool, out);
+}
+
+void Serializer::Write(bool with_schema, ThreadPool* pool,
+                       std::string* out) const {
+  const Header header = {
+      kMagic,
+      kVersion,
+      static_cast<uint16_t>(with_schema ? kHasSchema : 0),
+      static_cast<uint32_t>(entries_.size()),
+      static_cast<uint32_t>(with_schema ? schema_.size() : 0),
+      fingerprint_};
+  const std::size_t values_offset =
+      AlignUp(sizeof(Header) + header.schema_size, kBlockAlignment);
+  out->assign(values_offset + fixed_size_, '\0');
+  std::memcpy(&(*out)[0], &header, sizeof(Header));
+  if (with_schema) {
+    std::memcpy(&(*out)[sizeof(Header)], schema_.data(), schema_.size());
+  }
+
+  char* values = &(*out)[values_offset];
+  const auto strings =
+      std::partition_point(entries_.begin(), entries_.end(),
+                           [](const Entry& entry) {
+                             return entry.codec->size != 0;
+                           });
+  const std::size_t fixed_count = strings - entries_.begin();
+  auto write_fixed = [this, values](std::size_t begin, std::size_t end) {
+    for (std::size_t index = begin; index < end; ++index) {
+      const Entry& entry = entries_[index];
+      entry.codec->write(*entry.element, values + entry.offset);
+    }
+  };
+  if (pool != nullptr) {
+    // Fixed size values land at offsets of their own, so runs of entries are
+    // written concurrently. Strings are appended afterwards in order
+    const std::size_t chunk_count =
+        (fixed_count + kWriteChunkSize - 1) / kWriteChunkSize;
+    pool->ParallelFor(chunk_count, [&write_fixed,
+                                    fixed_count](std::size_t chunk) {
+      const std::size_t begin = chunk * kWriteChunkSize;
+      write_fixed(begin, std::min(fixed_count, begin + kWriteChunkSize));
+    });
+  } else {
+    write_fixed(0, fixed_count);
+  }
+  std::string value;
+  for (auto entry = strings; entry != entries_.end(); ++entry) {
+    entry->element->Extract(&value);
+    AppendString(value, out);
+  }
+}
+
+uint64_t Serializer::SerializeDelta(uint64_t since, std::string* out) {
+  const uint64_t epoch = registry_->AdvanceEpoch();
+  out->assign(sizeof(Header), '\0');
+  uint32_t count = 0;
+  std::string value;
+  for (std::size_t index = 0; index < entries_.size(); ++index) {
+    const Entry& entry = entries_[index];
+    if (entry.element->version() < since) {
+      continue;
+    }
+    const uint32_t record_index = static_cast<uint32_t>(index);
+    out->append(reinterpret_cast<const char*>(&record_index),
+                sizeof(record_index));
+    if (entry.codec->size != 0) {
+      const std::size_t offset = out->size();
+      out->resize(offset + entry.size);
+      entry.codec->write(*entry.element, &(*out)[offset]);
+    } else {
+      entry.element->Extract(&value);
+      AppendString(value, out);
+    }
+    ++count;
+  }
+  const Header header = {kMagic, kVersion, kDelta, count, 0, fingerprint_};
+  std::memcpy(&(*out)[0], &header, sizeof(Header));
+  return epoch;
+}
+
+common::ErrorOr<std::size_t> Serializer::Deserialize(std::string_view data) {
+  Header header;
+  if (data.size() < sizeof(Header)) {
+    return common::Error::kUnavailable;
+  }
+  std::memcpy(&header, data.data(), sizeof(Header));
+  const std::size_t values_offset =
+      AlignUp(sizeof(Header) + header.schema_size, kBlockAlignment);
+  if (header.magic != kMagic || header.version != kVersion ||
+      data.size() < values_offset) {
+    return common::Error::kUnavailable;
+  }
+  const std::string_view values = data.substr(values_offset);
+  if ((header.flags & kDelta) != 0) {
+    if (header.fingerprint != fingerprint_) {
+      return common::Error::kUnavailable;
+    }
+    return ReadDelta(header.element_count, data.substr(sizeof(Header)));
+  }
+  if (header.fingerprint == fingerprint_) {
+    return ReadValues(entries_, values);
+  }
+  if ((header.flags & kHasSchema) == 0) {
+    return common::Error::kUnavailable;
+  }
+
+  // The dump was written against another schema, which is merged into the
+  // registry before its values are loaded in the order of the dump
+  // The whole schema and the size of the values are checked before the
+  // first element is created, so that a malformed dump leaves the registry
+  // as it was
+  std::string_view schema = data.substr(sizeof(Header), header.schema_size);
+  std::vector<SchemaEntry> schema_entries;
+  schema_entries.reserve(schema.size() / kSchemaEntrySize);
+  std::size_t fixed_size = 0;
+  std::size_t string_count = 0;
+  bool added = false;
+  while (!schema.empty()) {
+    if (schema.size() < kSchemaEntrySize) {
+      return common::Error::kUnavailable;
+    }
+    const TypeEnum type =
+        static_cast<TypeEnum>(static_cast<unsigned char>(schema[0]));
+    const std::size_t size = static_cast<unsigned char>(schema[1]);
+    const std::size_t path_size = static_cast<unsigned char>(schema[2]) |
+                                  static_cast<unsigned char>(schema[3]) << 8;
+    uint32_t extent = 0;
+    for (int byte = 3; byte >= 0; --byte) {
+      extent = extent << 8 | static_cast<unsigned char>(schema[4 + byte]);
+    }
+    schema.remove_prefix(kSchemaEntrySize);
+    const ValueCodec* codec = CodecFor(type, size, extent);
+    if (codec == nullptr || schema.size() < path_size) {
+      return common::Error::kUnavailable;
+    }
+    const std::string_view path = schema.substr(0, path_size);
+    schema.remove_prefix(path_size);
+    if (codec->size != 0) {
+      // Fixed size values precede the strings. Bounding them by the values
+      // of the dump also bounds the arrays created for them
+      const std::size_t value_count = extent != 0 ? extent : 1;
+      if (string_count != 0 ||
+          value_count > values.size() / codec->size) {
+        return common::Error::kUnavailable;
+      }
+      fixed_size = AlignUp(fixed_size, ValueAlignment(codec->size)) +
+                   codec->size * value_count;
+      if (fixed_size > values.size()) {
+        return common::Error::kUnavailable;
+      }
+    } else {
+      ++string_count;
+    }
+    common::ErrorOr<Registry::Element*> maybe_element = FindOrAddElement(
+        registry_, path, type, *codec, extent, false, &added);
+    if (!maybe_element.HasValue()) {
+      return maybe_element.ErrorOrDie();
+    }
+    schema_entries.push_back(SchemaEntry{type, codec, extent, path});
+  }
+  if (schema_entries.size() != header.element_count) {
+    return common::Error::kUnavailable;
+  }
+  std::size_t offset = fixed_size;
+  for (std::size_t string = 0; string < string_count; ++string) {
+    uint32_t size;
+    if (offset + sizeof(size) > values.size()) {
+      return common::Error::kUnavailable;
+    }
+    std::memcpy(&size, values.data() + offset, sizeof(size));
+    offset += sizeof(size);
+    if (size > values.size() - offset) {
+      return common::Error::kUnavailable;
+    }
+    offset += size;
+  }
+
+  std::vector<Entry> entries;
+  entries.reserve(schema_entries.size());
+  for (const SchemaEntry& schema_entry : schema_entries) {
+    common::ErrorOr<Registry::Element*> maybe_element = FindOrAddElement(
+        registry_, schema_entry.path, schema_entry.type, *schema_entry.codec,
+        schema_entry.extent, true, &added);
+    if (!maybe_element.HasValue()) {
+      return maybe_element.ErrorOrDie();
+    }
+    entries.push_back(
+        Entry{maybe_element.ValueOrDie(), schema_entry.codec,
+              static_cast<uint32_t>(maybe_element.ValueOrDie()->value_size()),
+              0});
+  }
+  if (added) {
+    Build();
+  }
+  LayOut(&entries);
+  return ReadValues(entries, values);
+}
+
+common::ErrorOr<std::size_t> Serializer::ReadValues(
+    const std::vector<Entry>& entries, std::string_view data) {
+  std::size_t offset = 0;
+  auto entry = entries.begin();
+  for (; entry != entries.end() && entry->codec->size != 0; ++entry) {
+    offset = entry->offset + entry->size;
+    if (offset > data.size() ||
+        !entry->codec->read(entry->element, data.data() + entry->offset)) {
+      return common::Error::kUnavailable;
+    }
+  }
+  for (; entry != entries.end(); ++entry) {
+    if (!ReadString(data, &offset, entry->element)) {
+      return common::Error::kUnavailable;
+    }
+  }
+  return entries.size();
+}
+
+common::ErrorOr<std::size_t> Serializer::ReadDelta(
+    uint32_t count, std::string_view data) const {
+  std::size_t offset = 0;
+  for (uint32_t record = 0; record < count; ++record) {
+    uint32_t index;
+    if (offset + sizeof(index) > data.size()) {
+      return common::Error::kUnavailable;
+    }
+    std::memcpy(&index, data.data() + offset, sizeof(index));
+    offset += sizeof(index);
+    if (index >= entries_.size()) {
+      return common::Error::kUnavailable;
+    }
+    const Entry& entry = entries_[index];
+    if (entry.codec->size != 0) {
+      if (offset + entry.size > data.size() ||
+          !entry.codec->read(entry.element, data.data() + offset)) {
+        return common::Error::kUnavailable;
+      }
+      offset += entry.size;
+    } else if (!ReadString(data, &offset, entry.element)) {
+      return common::Error::kUnavailable;
+    }
+  }
+  return std::size_t{count};
+}
+
+}  // namespace registry
@@ -0,0 +1,135 @@
+#ifndef REGISTRY_SERIALIZER_H_
+#define REGISTRY_SERIALIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/error_or.h"
+#include "registry/registry.h"
+#include "registry/thread_pool.h"
+
+namespace registry {
+
+namespace internal {
+
+struct ValueCodec;
+
+}  // namespace internal
+
+/// @class Serializer
+/// Binary serialization of the elements below a registry.
+///
+/// A dump starts with a fixed header followed, in full dumps, by the schema:
+/// the type, value size, dotted path relative to the registry and, for
+/// arrays, number of values of every element. Values follow as one packed
+/// block, grouped by type and ordered by decreasing size of their values so
+/// that every value is naturally aligned, with strings
+/// stored length prefixed at the end. Values-only dumps omit the schema and
+/// are identified by the fingerprint of the schema they were written with.
+/// Data is written in host byte order; dumps from hosts of the other byte
+/// order are rejected.
+///
+/// The layout is computed on construction, so elements added to the
+/// registry afterwards are only picked up by a new Serializer
+class Serializer {
+ public:
+  static constexpr uint32_t kMagic = 0x53474552;  // "REGS"
+  static constexpr uint16_t kVersion = 2;
+
+  /// @param[in] registry registry whose subtree is serialized and into which
+  /// dumps are loaded. Must outlive the serializer
+  explicit Serializer(Registry* registry);
+
+  Serializer(const Serializer&) = delete;
+  Serializer& operator=(const Serializer&) = delete;
+
+  /// Writes the schema and the values of every element
+  /// @param[out] out buffer replaced with the dump, its capacity is reused
+  void Serialize(std::string* out) const;
+
+  /// Same as Serialize() with the fixed size values written by the threads
+  /// of pool, for large registries
+  void Serialize(std::string* out, ThreadPool* pool) const;
+
+  /// Writes the values of every element without the schema. Such dumps can
+  /// only be loaded by a serializer with the same fingerprint
+  /// @param[out] out buffer replaced with the dump, its capacity is reused
+  void SerializeValues(std::string* out) const;
+
+  /// Same as SerializeValues() with the fixed size values written by the
+  /// threads of pool
+  void SerializeValues(std::string* out, ThreadPool* pool) const;
+
+  /// Writes the values of the elements written since an epoch of the tree,
+  /// each prefixed with its index in the schema, then starts a new epoch.
+  /// Like values-only dumps, deltas can only be loaded by a serializer with
+  /// the same fingerprint
+  /// @param[in] since epoch returned by the previous call, 0 to include every
+  /// element
+  /// @param[out] out buffer replaced with the delta, its capacity is reused
+  /// @return epoch to pass to the next call
+  uint64_t SerializeDelta(uint64_t since, std::string* out);
+
+  /// Loads a dump through Element::Assign. For full dumps, child registries
+  /// and elements missing from the registry are created first, except for
+  /// enum elements which must already exist since their type is unknown.
+  /// The schema and the size of the values are checked first, a dump failing
+  /// the check leaves the registry unchanged
+  /// @param[in] data dump written by Serialize(), SerializeValues() or
+  /// SerializeDelta()
+  /// @return number of element values loaded, else an error code: kNotFound
+  /// if an element of the schema cannot be created, kUnavailable if the data
+  /// is malformed, was written against another schema, or conflicts with the
+  /// type of an existing element
+  common::ErrorOr<std::size_t> Deserialize(std::string_view data);
+
+  /// @return hash identifying the schema of the registry, written in every
+  /// dump
+  uint64_t fingerprint() const { return fingerprint_; }
+
+ private:
+  struct Entry {
+    Registry::Element* element;
+    const internal::ValueCodec* codec;
+    // Size of the value, or of all the values of an array, within the packed
+    // block. Unused for strings
+    uint32_t size;
+    // Offset of the value within the packed block, unused for strings
+    uint32_t offset;
+  };
+
+  // Lays out the elements of the registry and computes the schema
+  void Build();
+
+  // Assigns the offsets of entries ordered as in a dump
+  // @return size of the packed block
+  static std::size_t LayOut(std::vector<Entry>* entries);
+
+  // Number of entries written by each task of a parallel write
+  static constexpr std::size_t kWriteChunkSize = 1024;
+
+  // @param[in] pool threads writing the values, nullptr to write them on the
+  // calling thread
+  void Write(bool with_schema, ThreadPool* pool, std::string* out) const;
+
+  // Reads the values block of a dump laid out as entries
+  static common::ErrorOr<std::size_t> ReadValues(
+      const std::vector<Entry>& entries, std::string_view data);
+
+  // Reads the records of a delta
+  common::ErrorOr<std::size_t> ReadDelta(uint32_t count,
+                                         std::string_view data) const;
+
+  Registry* const registry_;
+  std::vector<Entry> entries_;
+  std::string schema_;
+  uint64_t fingerprint_;
+  std::size_t fixed_size_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_SERIALIZER_H_
@@ -0,0 +1,274 @@
+#include "registry/serializer.h"
+
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/enum_traits.h"
+
+namespace registry {
+
+enum class SerializerEnum : uint16_t { kFirst, kSecond };
+
+}  // namespace registry
+
+namespace common {
+
+template <>
+constexpr registry::SerializerEnum
+EnumTrait<registry::SerializerEnum>::default_value() {
+  return registry::SerializerEnum::kFirst;
+}
+
+}  // namespace common
+
+namespace registry {
+
+class SerializerTest : public ::testing::Test {
+ public:
+  SerializerTest() : source_("source") {
+    Registry* child = source_.AddChildRegistry("child").ValueOrDie();
+    *source_.AddDouble("double").ValueOrDie() = 1.25;
+    *source_.AddBoolean("bool").ValueOrDie() = true;
+    *child->AddInt32("int32").ValueOrDie() = -7;
+    *child->AddUnsignedInt64("uint64").ValueOrDie() = 1ull << 40;
+    child->AddChar("char", 'x').ValueOrDie();
+    child->AddString("string", "a longer string value").ValueOrDie();
+    child->AddString("empty", "").ValueOrDie();
+  }
+
+ protected:
+  Registry source_;
+};
+
+TEST_F(SerializerTest, RoundTripCreatesSchema) {
+  Serializer writer(&source_);
+  std::string dump;
+  writer.Serialize(&dump);
+
+  Registry destination("destination");
+  Serializer reader(&destination);
+  common::ErrorOr<std::size_t> loaded = reader.Deserialize(dump);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 7u);
+  EXPECT_EQ(reader.fingerprint(), writer.fingerprint());
+
+  EXPECT_EQ(destination.FindDouble("double").ValueOrDie()->value(), 1.25);
+  EXPECT_TRUE(destination.FindBoolean("bool").ValueOrDie()->value());
+  Registry* child = destination.FindChildRegistry("child").ValueOrDie();
+  EXPECT_EQ(child->FindInt32("int32").ValueOrDie()->value(), -7);
+  EXPECT_EQ(child->FindUnsignedInt64("uint64").ValueOrDie()->value(),
+            1ull << 40);
+  EXPECT_EQ(child->FindChar("char").ValueOrDie()->value(), 'x');
+  EXPECT_EQ(child->FindString("string").ValueOrDie()->value(),
+            "a longer string value");
+  EXPECT_EQ(child->FindString("empty").ValueOrDie()->value(), "");
+}
+
+TEST_F(SerializerTest, ValuesOnly) {
+  Serializer writer(&source_);
+  std::string schema_dump;
+  writer.Serialize(&schema_dump);
+  Registry destination("destination");
+  Serializer reader(&destination);
+  ASSERT_TRUE(reader.Deserialize(schema_dump).HasValue());
+
+  *source_.FindDouble("double").ValueOrDie() = 2.5;
+  *source_.FindChildRegistry("child").ValueOrDie()->FindString("string")
+       .ValueOrDie() = "updated";
+  std::string values_dump;
+  writer.SerializeValues(&values_dump);
+  EXPECT_LT(values_dump.size(), schema_dump.size());
+
+  common::ErrorOr<std::size_t> loaded = reader.Deserialize(values_dump);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 7u);
+  EXPECT_EQ(destination.FindDouble("double").ValueOrDie()->value(), 2.5);
+  EXPECT_EQ(destination.FindChildRegistry("child")
+                .ValueOrDie()
+                ->FindString("string")
+                .ValueOrDie()
+                ->value(),
+            "updated");
+
+  // Values-only dumps cannot be loaded against another schema
+  Registry other("other");
+  other.AddDouble("double");
+  Serializer other_reader(&other);
+  EXPECT_FALSE(other_reader.Deserialize(values_dump).HasValue());
+}
+
+TEST_F(SerializerTest, ParallelMatchesSerial) {
+  Registry* child = source_.FindChildRegistry("child").ValueOrDie();
+  for (int element = 0; element < 5000; ++element) {
+    *child->AddDouble("value" + std::to_string(element)).ValueOrDie() =
+        element * 0.25;
+  }
+  Serializer writer(&source_);
+  ThreadPool pool(4);
+  std::string serial;
+  std::string parallel;
+  writer.Serialize(&serial);
+  writer.Serialize(&parallel, &pool);
+  EXPECT_EQ(parallel, serial);
+  writer.SerializeValues(&serial);
+  writer.SerializeValues(&parallel, &pool);
+  EXPECT_EQ(parallel, serial);
+}
+
+TEST_F(SerializerTest, SubtreeAndEnums) {
+  Registry* child = source_.FindChildRegistry("child").ValueOrDie();
+  *child->AddEnum<SerializerEnum>("mode").ValueOrDie() =
+      SerializerEnum::kSecond;
+  Serializer writer(child);
+  std::string dump;
+  writer.Serialize(&dump);
+
+  // Enum elements cannot be created from a schema
+  Registry destination("destination");
+  Serializer reader(&destination);
+  common::ErrorOr<std::size_t> loaded = reader.Deserialize(dump);
+  ASSERT_FALSE(loaded.HasValue());
+  EXPECT_EQ(loaded.ErrorOrDie(), common::Error::kNotFound);
+
+  Registry::Enum<SerializerEnum>* mode =
+      destination.AddEnum<SerializerEnum>("mode").ValueOrDie();
+  loaded = reader.Deserialize(dump);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 6u);
+  EXPECT_EQ(mode->value(), SerializerEnum::kSecond);
+  EXPECT_EQ(destination.FindInt32("int32").ValueOrDie()->value(), -7);
+  EXPECT_FALSE(destination.FindDouble("double").HasValue());
+}
+
+TEST_F(SerializerTest, RejectsBadData) {
+  Serializer writer(&source_);
+  std::string dump;
+  writer.Serialize(&dump);
+
+  // Elements of the schema must not conflict with existing elements
+  Registry conflicting("conflicting");
+  conflicting.AddInt32("double");
+  Serializer conflicting_reader(&conflicting);
+  common::ErrorOr<std::size_t> loaded = conflicting_reader.Deserialize(dump);
+  ASSERT_FALSE(loaded.HasValue());
+  EXPECT_EQ(loaded.ErrorOrDie(), common::Error::kUnavailable);
+
+  // Malformed dumps are rejected before any element is created
+  Registry destination("destination");
+  Serializer reader(&destination);
+  for (std::size_t size = 0; size < dump.size(); size += 7) {
+    EXPECT_FALSE(reader.Deserialize(dump.substr(0, size)).HasValue());
+  }
+  std::string corrupted = dump;
+  corrupted[0] = 'X';
+  EXPECT_FALSE(reader.Deserialize(corrupted).HasValue());
+  corrupted = dump;
+  const uint32_t element_count = 0xffffffff;
+  std::memcpy(&corrupted[8], &element_count, sizeof(element_count));
+  EXPECT_FALSE(reader.Deserialize(corrupted).HasValue());
+  EXPECT_EQ(destination.ElementCount(), 0u);
+  EXPECT_FALSE(destination.FindChildRegistry("child").HasValue());
+}
+
+TEST_F(SerializerTest, Delta) {
+  Serializer writer(&source_);
+  std::string dump;
+  writer.Serialize(&dump);
+  Registry destination("destination");
+  Serializer reader(&destination);
+  ASSERT_TRUE(reader.Deserialize(dump).HasValue());
+
+  // The first delta holds every element
+  std::string delta;
+  uint64_t since = writer.SerializeDelta(0, &delta);
+  common::ErrorOr<std::size_t> loaded = reader.Deserialize(delta);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 7u);
+
+  since = writer.SerializeDelta(since, &delta);
+  loaded = reader.Deserialize(delta);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 0u);
+
+  Registry* child = source_.FindChildRegistry("child").ValueOrDie();
+  *source_.FindDouble("double").ValueOrDie() = 4.5;
+  *child->FindString("string").ValueOrDie() = "delta";
+  writer.SerializeDelta(since, &delta);
+  loaded = reader.Deserialize(delta);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 2u);
+  EXPECT_EQ(destination.FindDouble("double").ValueOrDie()->value(), 4.5);
+  EXPECT_EQ(destination.FindChildRegistry("child")
+                .ValueOrDie()
+                ->FindString("string")
+                .ValueOrDie()
+                ->value(),
+            "delta");
+
+  // Deltas are only loaded against the same schema, and fully validated
+  Registry other("other");
+  Serializer other_reader(&other);
+  EXPECT_FALSE(other_reader.Deserialize(delta).HasValue());
+  for (std::size_t size = 0; size < delta.size(); ++size) {
+    EXPECT_FALSE(reader.Deserialize(delta.substr(0, size)).HasValue());
+  }
+}
+
+TEST_F(SerializerTest, Arrays) {
+  Registry::DoubleArray* gains =
+      source_.AddDoubleArray("gains", 5).ValueOrDie();
+  const double values[] = {0.5, 1.5, 2.5, 3.5, 4.5};
+  gains->Set(0, 5, values);
+  source_.AddArray<char>("letters", 3).ValueOrDie()->Set(1, 'y');
+  Serializer writer(&source_);
+  std::string dump;
+  writer.Serialize(&dump);
+
+  Registry destination("destination");
+  Serializer reader(&destination);
+  common::ErrorOr<std::size_t> loaded = reader.Deserialize(dump);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 9u);
+  Registry::DoubleArray* loaded_gains =
+      destination.FindDoubleArray("gains").ValueOrDie();
+  ASSERT_EQ(loaded_gains->size(), 5u);
+  for (std::size_t index = 0; index < 5; ++index) {
+    EXPECT_EQ((*loaded_gains)[index], values[index]);
+  }
+  EXPECT_EQ((*destination.FindArray<char>("letters").ValueOrDie())[1], 'y');
+
+  // Arrays of another size conflict with the schema
+  Registry conflicting("conflicting");
+  conflicting.AddDoubleArray("gains", 4);
+  Serializer conflicting_reader(&conflicting);
+  loaded = conflicting_reader.Deserialize(dump);
+  ASSERT_FALSE(loaded.HasValue());
+  EXPECT_EQ(loaded.ErrorOrDie(), common::Error::kUnavailable);
+
+  // Extents larger than the values of the dump are rejected before the
+  // array is allocated
+  std::string corrupted = dump;
+  const uint32_t extent = 0xffffffff;
+  std::memcpy(&corrupted[corrupted.find("gains") - 4], &extent,
+              sizeof(extent));
+  Registry empty("empty");
+  Serializer empty_reader(&empty);
+  loaded = empty_reader.Deserialize(corrupted);
+  ASSERT_FALSE(loaded.HasValue());
+  EXPECT_EQ(loaded.ErrorOrDie(), common::Error::kUnavailable);
+  EXPECT_EQ(empty.ElementCount(), 0u);
+
+  std::string delta;
+  const uint64_t since = writer.SerializeDelta(0, &delta);
+  gains->Set(4, -1.0);
+  writer.SerializeDelta(since, &delta);
+  loaded = reader.Deserialize(delta);
+  ASSERT_TRUE(loaded.HasValue());
+  EXPECT_EQ(loaded.ValueOrDie(), 1u);
+  EXPECT_EQ((*loaded_gains)[4], -1.0);
+  EXPECT_EQ((*loaded_gains)[3], 3.5);
+}
+
+}  // namespace registry
@@ -0,0 +1,223 @@
+#include "registry/shared_region.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace registry {
+
+namespace {
+
+using internal::SharedRegionEntry;
+using internal::SharedRegionHeader;
+
+// Values start on a cache line of their own, away from the table
+constexpr std::size_t kValuesAlignment = 64;
+
+std::size_t AlignUp(std::size_t offset, std::size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool IsShareable(const Registry::Element& element) {
+  const std::size_t size = element.value_size();
+  return element.extent() == 0 &&
+         (size == 1 || size == 2 || size == 4 || size == 8);
+}
+
+}  // namespace
+
+SharedRegion::SharedRegion(Registry* registry)
+    : registry_(registry), memory_(nullptr), size_(0), lock_fd_(-1) {}
+
+SharedRegion::~SharedRegion() {
+  if (memory_ == nullptr) {
+    return;
+  }
+  for (Registry::Element* element : shared_elements_) {
+    element->RelocateValue(nullptr);
+  }
+  munmap(memory_, size_);
+  close(lock_fd_);
+}
+
+common::ErrorOr<std::size_t> SharedRegion::Map(const std::string& path) {
+  if (memory_ != nullptr) {
+    return common::Error::kUnavailable;
+  }
+
+  // Lay out the table, the names and the values, each value aligned to its
+  // size. Larger values go first so that no padding is needed between them
+  std::vector<Registry::Element*> elements;
+  registry_->ForEachElement([&elements](Registry::Element& element) {
+    if (IsShareable(element)) {
+      elements.push_back(&element);
+    }
+  });
+  std::stable_sort(elements.begin(), elements.end(),
+                   [](const Registry::Element* lhs,
+                      const Registry::Element* rhs) {
+                     return lhs->value_size() > rhs->value_size();
+                   });
+  const std::size_t prefix_size = registry_->FullName().size() + 1;
+  const std::size_t names_offset =
+      sizeof(SharedRegionHeader) + elements.size() * sizeof(SharedRegionEntry);
+  std::size_t names_size = 0;
+  for (const Registry::Element* element : elements) {
+    names_size += element->FullName().size() - prefix_size;
+  }
+  const std::size_t values_offset =
+      AlignUp(names_offset + names_size, kValuesAlignment);
+  std::size_t size = values_offset;
+  for (const Registry::Element* element : elements) {
+    size += element->value_size();
+  }
+
+  // A single region maps a path at a time, holding an exclusive lock on a
+  // file next to it for as long as it lives
+  const int lock_fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock_fd < 0) {
+    return common::Error::kUnavailable;
+  }
+  if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+    close(lock_fd);
+    return common::Error::kUnavailable;
+  }
+
+  // The region is built in a new file which then replaces the one at path:
+  // readers still attached to a previous region keep mapping its file,
+  // whatever its layout, instead of seeing it rewritten under them
+  const std::string temporary_path = path + ".tmp";
+  const int fd =
+      open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  void* memory = MAP_FAILED;
+  if (fd >= 0) {
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+  }
+  if (memory == MAP_FAILED) {
+    unlink(temporary_path.c_str());
+    close(lock_fd);
+    return common::Error::kUnavailable;
+  }
+
+  char* bytes = static_cast<char*>(memory);
+  SharedRegionHeader* header = new (bytes) SharedRegionHeader();
+  SharedRegionEntry* entries =
+      reinterpret_cast<SharedRegionEntry*>(bytes + sizeof(SharedRegionHeader));
+  std::size_t name_offset = names_offset;
+  std::size_t value_offset = values_offset;
+  for (Registry::Element* element : elements) {
+    if (!element->RelocateValue(bytes + value_offset)) {
+      continue;
+    }
+    const std::string_view name = element->FullName().substr(prefix_size);
+    std::memcpy(bytes + name_offset, name.data(), name.size());
+    entries[shared_elements_.size()] = SharedRegionEntry{
+        static_cast<uint32_t>(name_offset),
+        static_cast<uint16_t>(name.size()),
+        static_cast<uint8_t>(element->type()),
+        static_cast<uint8_t>(element->value_size()), value_offset};
+    shared_elements_.push_back(element);
+    name_offset += name.size();
+    value_offset += element->value_size();
+  }
+  header->version = kVersion;
+  header->entry_count = static_cast<uint32_t>(shared_elements_.size());
+  header->names_offset = static_cast<uint32_t>(names_offset);
+  header->values_offset = values_offset;
+  header->size = size;
+  header->magic.store(kMagic, std::memory_order_release);
+
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    for (Registry::Element* element : shared_elements_) {
+      element->RelocateValue(nullptr);
+    }
+    shared_elements_.clear();
+    munmap(memory, size);
+    unlink(temporary_path.c_str());
+    close(lock_fd);
+    return common::Error::kUnavailable;
+  }
+  memory_ = memory;
+  size_ = size;
+  lock_fd_ = lock_fd;
+  return shared_elements_.size();
+}
+
+SharedRegionReader::SharedRegionReader() : memory_(nullptr), size_(0) {}
+
+SharedRegionReader::~SharedRegionReader() {
+  if (memory_ != nullptr) {
+    munmap(const_cast<void*>(memory_), size_);
+  }
+}
+
+common::ErrorOr<std::size_t> SharedRegionReader::Attach(
+    const std::string& path) {
+  if (memory_ != nullptr) {
+    return common::Error::kUnavailable;
+  }
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return common::Error::kUnavailable;
+  }
+  struct stat status;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<std::size_t>(status.st_size) >= sizeof(SharedRegionHeader)) {
+    memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return common::Error::kUnavailable;
+  }
+  const std::size_t size = status.st_size;
+
+  // Validate the whole table before trusting any of it. The magic is only
+  // written once the owner has finished initialising the region, so it is
+  // checked before anything else is read
+  const char* bytes = static_cast<const char*>(memory);
+  const SharedRegionHeader* header =
+      reinterpret_cast<const SharedRegionHeader*>(bytes);
+  bool valid =
+      header->magic.load(std::memory_order_acquire) == SharedRegion::kMagic &&
+      header->version == SharedRegion::kVersion && header->size <= size &&
+      sizeof(SharedRegionHeader) +
+              header->entry_count * sizeof(SharedRegionEntry) <=
+          size;
+  const SharedRegionEntry* entries =
+      reinterpret_cast<const SharedRegionEntry*>(bytes +
+                                                 sizeof(SharedRegionHeader));
+  for (uint32_t index = 0; valid && index < header->entry_count; ++index) {
+    const SharedRegionEntry& entry = entries[index];
+    valid = entry.value_size != 0 &&
+            entry.name_offset + std::size_t{entry.name_size} <= size &&
+            entry.value_offset <= size &&
+            entry.value_size <= size - entry.value_offset &&
+            entry.value_offset % entry.value_size == 0;
+    if (valid) {
+      entries_.emplace(
+          std::string_view(bytes + entry.name_offset, entry.name_size),
+          &entry);
+    }
+  }
+  if (!valid) {
+    entries_.clear();
+    munmap(memory, size);
+    return common::Error::kUnavailable;
+  }
+  memory_ = memory;
+  size_ = size;
+  return entries_.size();
+}
+
+}  // namespace registry
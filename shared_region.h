@@ -0,0 +1,148 @@
+#ifndef REGISTRY_SHARED_REGION_H_
+#define REGISTRY_SHARED_REGION_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common/error_or.h"
+#include "registry/registry.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Layout of a shared region: the header, a table describing every shared
+/// element, the relative paths of the elements, then their values
+struct SharedRegionHeader {
+  // Written last, once the rest of the region is initialised
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t names_offset;
+  uint64_t values_offset;
+  uint64_t size;
+};
+
+struct SharedRegionEntry {
+  uint32_t name_offset;
+  uint16_t name_size;
+  uint8_t type;
+  uint8_t value_size;
+  uint64_t value_offset;
+};
+
+}  // namespace internal
+
+/// @class SharedRegion
+/// Moves the values of the scalar elements below a registry into a memory
+/// mapped file, along with a table of their paths, types and offsets, so that
+/// other processes can read them without copies or system calls through a
+/// SharedRegionReader. On Linux, files under /dev/shm are POSIX shared
+/// memory objects; files anywhere else are shared through the page cache.
+///
+/// Elements keep working as usual while their values live in the region.
+/// Only elements present when the region is mapped are shared, and strings
+/// and arrays are never shared. The file, and the lock file next to it, are
+/// left in place when the region is destroyed
+class SharedRegion {
+ public:
+  static constexpr uint32_t kMagic = 0x4d474552;  // "REGM"
+  static constexpr uint32_t kVersion = 1;
+
+  /// @param[in] registry registry whose subtree is shared, must outlive the
+  /// region
+  explicit SharedRegion(Registry* registry);
+
+  /// Moves the values back inside their elements and unmaps the region
+  ~SharedRegion();
+
+  SharedRegion(const SharedRegion&) = delete;
+  SharedRegion& operator=(const SharedRegion&) = delete;
+
+  /// Builds the region in a new file, moves the element values into it, then
+  /// renames it to path. A file already at path is replaced rather than
+  /// rewritten, so readers still attached to it keep their mapping of it.
+  /// The region locks path + ".lock" until destroyed, so a path is mapped by
+  /// a single region at a time. Must not be called concurrently with writes
+  /// to the elements
+  /// @param[in] path path of the file backing the region
+  /// @return number of elements shared, else kUnavailable if the region is
+  /// already mapped, another region maps path, or the file cannot be created
+  /// and mapped
+  common::ErrorOr<std::size_t> Map(const std::string& path);
+
+  /// @return size in bytes of the region, 0 until mapped
+  std::size_t size() const { return size_; }
+
+ private:
+  Registry* const registry_;
+  std::vector<Registry::Element*> shared_elements_;
+  void* memory_;
+  std::size_t size_;
+  // Holds the lock on the lock file of the path while mapped
+  int lock_fd_;
+};
+
+/// @class SharedValue
+/// Read-only view of the value of an element held in a shared region
+template <typename T>
+class SharedValue {
+ public:
+  explicit SharedValue(const std::atomic<T>* value) : value_(value) {}
+
+  T value() const { return value_->load(std::memory_order_acquire); }
+  operator T() const { return value(); }
+
+ private:
+  const std::atomic<T>* value_;
+};
+
+/// @class SharedRegionReader
+/// Read-only attachment to a region mapped by a SharedRegion, possibly in
+/// another process. Lookups resolve paths relative to the registry of the
+/// region, e.g. "child.element"; the resulting views read values straight
+/// from the shared memory
+class SharedRegionReader {
+ public:
+  SharedRegionReader();
+  ~SharedRegionReader();
+
+  SharedRegionReader(const SharedRegionReader&) = delete;
+  SharedRegionReader& operator=(const SharedRegionReader&) = delete;
+
+  /// Maps the file at path read-only
+  /// @param[in] path path of the file backing the region
+  /// @return number of shared elements, else kUnavailable if already
+  /// attached, or if the file cannot be mapped or does not hold a valid region
+  common::ErrorOr<std::size_t> Attach(const std::string& path);
+
+  /// Search for a shared value using its path relative to the registry
+  /// @param[in] path dotted path to the element
+  /// @return view of the value if found and of type T, else an error code
+  template <typename T>
+  common::ErrorOr<SharedValue<T>> Find(std::string_view path) const {
+    auto entry = entries_.find(path);
+    if (entry == entries_.end() ||
+        entry->second->type != static_cast<uint8_t>(TypeTrait<T>::type) ||
+        entry->second->value_size != sizeof(T)) {
+      return common::Error::kNotFound;
+    }
+    return SharedValue<T>(reinterpret_cast<const std::atomic<T>*>(
+        static_cast<const char*>(memory_) + entry->second->value_offset));
+  }
+
+ private:
+  const void* memory_;
+  std::size_t size_;
+  std::unordered_map<std::string_view, const internal::SharedRegionEntry*>
+      entries_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_SHARED_REGION_H_
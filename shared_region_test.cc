@@ -0,0 +1,178 @@
+#include "registry/shared_region.h"
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+class SharedRegionTest : public ::testing::Test {
+ public:
+  SharedRegionTest()
+      : path_(::testing::TempDir() + "shared_region_test_" +
+              std::to_string(getpid())) {}
+  ~SharedRegionTest() override {
+    std::remove(path_.c_str());
+    std::remove((path_ + ".lock").c_str());
+  }
+
+ protected:
+  const std::string path_;
+};
+
+TEST_F(SharedRegionTest, ElementsReadAndWriteThroughRegion) {
+  Registry root("root");
+  Registry* child = root.AddChildRegistry("child").ValueOrDie();
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  Registry::Int32* count = child->AddInt32("count").ValueOrDie();
+  Registry::Bool* flag = child->AddBoolean("flag").ValueOrDie();
+  Registry::String* label = child->AddString("label", "text").ValueOrDie();
+  *value = 1.5;
+  *count = 3;
+
+  {
+    SharedRegion region(&root);
+    common::ErrorOr<std::size_t> shared = region.Map(path_);
+    ASSERT_TRUE(shared.HasValue());
+    // Strings are not shared
+    EXPECT_EQ(shared.ValueOrDie(), 3u);
+    EXPECT_FALSE(region.Map(path_).HasValue());
+
+    // Values moved into the region keep their value and stay writable
+    EXPECT_EQ(value->value(), 1.5);
+    EXPECT_EQ(count->value(), 3);
+    *flag = true;
+    EXPECT_TRUE(flag->value());
+
+    SharedRegionReader reader;
+    ASSERT_TRUE(reader.Attach(path_).HasValue());
+    common::ErrorOr<SharedValue<double>> shared_value =
+        reader.Find<double>("value");
+    ASSERT_TRUE(shared_value.HasValue());
+    EXPECT_EQ(shared_value.ValueOrDie().value(), 1.5);
+    *value = 2.5;
+    EXPECT_EQ(shared_value.ValueOrDie().value(), 2.5);
+    ASSERT_TRUE(reader.Find<int32_t>("child.count").HasValue());
+    EXPECT_EQ(reader.Find<int32_t>("child.count").ValueOrDie().value(), 3);
+    EXPECT_TRUE(reader.Find<bool>("child.flag").ValueOrDie().value());
+
+    // Lookups are type checked
+    EXPECT_FALSE(reader.Find<int64_t>("value").HasValue());
+    EXPECT_FALSE(reader.Find<std::string>("child.label").HasValue());
+    EXPECT_FALSE(reader.Find<double>("missing").HasValue());
+  }
+
+  // Values return inside their elements with the region
+  EXPECT_EQ(value->value(), 2.5);
+  *value = 3.5;
+  EXPECT_EQ(value->value(), 3.5);
+  EXPECT_EQ(label->value(), "text");
+}
+
+TEST_F(SharedRegionTest, ReplacesExistingFiles) {
+  Registry root("root");
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  *value = 1.5;
+  // A larger file, as left by a previous run sharing more elements
+  FILE* file = std::fopen(path_.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  const std::string previous(8192, 'x');
+  std::fwrite(previous.data(), 1, previous.size(), file);
+  std::fclose(file);
+
+  SharedRegionReader reader;
+  {
+    SharedRegion region(&root);
+    ASSERT_TRUE(region.Map(path_).HasValue());
+    struct stat status;
+    ASSERT_EQ(stat(path_.c_str(), &status), 0);
+    EXPECT_EQ(static_cast<std::size_t>(status.st_size), region.size());
+    ASSERT_TRUE(reader.Attach(path_).HasValue());
+    EXPECT_EQ(reader.Find<double>("value").ValueOrDie().value(), 1.5);
+
+    // A path is mapped by a single region at a time
+    Registry other("root");
+    other.AddDouble("value");
+    SharedRegion other_region(&other);
+    EXPECT_FALSE(other_region.Map(path_).HasValue());
+    *value = 2.5;
+    EXPECT_EQ(reader.Find<double>("value").ValueOrDie().value(), 2.5);
+  }
+
+  // Mapping the path again with another layout, as a restarted process
+  // would, leaves the readers attached to the previous file reading it
+  Registry restarted("root");
+  Registry::Int32* count = restarted.AddInt32("count").ValueOrDie();
+  Registry::Double* restarted_value =
+      restarted.AddDouble("value").ValueOrDie();
+  *count = 7;
+  *restarted_value = 3.5;
+  SharedRegion region(&restarted);
+  ASSERT_TRUE(region.Map(path_).HasValue());
+  EXPECT_EQ(reader.Find<double>("value").ValueOrDie().value(), 2.5);
+  EXPECT_FALSE(reader.Find<int32_t>("count").HasValue());
+  SharedRegionReader new_reader;
+  ASSERT_TRUE(new_reader.Attach(path_).HasValue());
+  EXPECT_EQ(new_reader.Find<double>("value").ValueOrDie().value(), 3.5);
+  EXPECT_EQ(new_reader.Find<int32_t>("count").ValueOrDie().value(), 7);
+}
+
+TEST_F(SharedRegionTest, RejectsInvalidRegions) {
+  SharedRegionReader reader;
+  EXPECT_FALSE(reader.Attach(path_).HasValue());
+
+  FILE* file = std::fopen(path_.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  const std::string garbage(256, 'x');
+  std::fwrite(garbage.data(), 1, garbage.size(), file);
+  std::fclose(file);
+  EXPECT_FALSE(reader.Attach(path_).HasValue());
+}
+
+// A value written by one process is read by another one through its own
+// read-only mapping of the region
+TEST_F(SharedRegionTest, TwoProcesses) {
+  Registry root("root");
+  Registry::Int64* counter = root.AddInt64("counter").ValueOrDie();
+  SharedRegion region(&root);
+  ASSERT_TRUE(region.Map(path_).HasValue());
+  *counter = 1;
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    SharedRegionReader reader;
+    if (!reader.Attach(path_).HasValue()) {
+      _exit(1);
+    }
+    common::ErrorOr<SharedValue<int64_t>> shared =
+        reader.Find<int64_t>("counter");
+    if (!shared.HasValue()) {
+      _exit(2);
+    }
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (shared.ValueOrDie().value() != 42) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        _exit(3);
+      }
+      std::this_thread::yield();
+    }
+    _exit(0);
+  }
+
+  *counter = 42;
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+}  // namespace registry
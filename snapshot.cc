@@ -0,0 +1,206 @@
+#include "registry/snapshot.h"
+
+#include <algorithm>
+
+namespace registry {
+
+Snapshot::Group Snapshot::GroupOf(const Registry::Element&) {
+  // Enums and arrays are copied as a whole through ExtractBytes
+  return kOther;
+}
+
+template <typename T>
+Snapshot::Group Snapshot::GroupOf(const Registry::ElementTemplate<T>&) {
+  if constexpr (std::is_same<T, int32_t>::value) {
+    return kInt32;
+  } else if constexpr (std::is_same<T, uint32_t>::value) {
+    return kUnsignedInt32;
+  } else if constexpr (std::is_same<T, int64_t>::value) {
+    return kInt64;
+  } else if constexpr (std::is_same<T, uint64_t>::value) {
+    return kUnsignedInt64;
+  } else if constexpr (std::is_same<T, bool>::value) {
+    return kBool;
+  } else if constexpr (std::is_same<T, char>::value) {
+    return kChar;
+  } else if constexpr (std::is_same<T, float>::value) {
+    return kFloat;
+  } else if constexpr (std::is_same<T, double>::value) {
+    return kDouble;
+  } else if constexpr (std::is_same<T, std::string>::value) {
+    return kString;
+  } else {
+    return kOther;
+  }
+}
+
+Snapshot::Snapshot(const Registry& registry)
+    : registry_(&registry),
+      size_(0),
+      back_(0),
+      front_(1),
+      middle_(2),
+      captures_(0) {
+  layout_.assign(registry.ElementCount(),
+                 Entry{TypeEnum(), 0, kNotCaptured});
+  std::size_t string_count = 0;
+  registry.Visit([this, &string_count](const auto& element) {
+    const uint32_t id = element.handle().id();
+    if (id >= layout_.size()) {
+      // Added after the layout was sized
+      return;
+    }
+    Entry& entry = layout_[id];
+    entry.type = element.type();
+    entry.extent = static_cast<uint32_t>(element.extent());
+    const Group group = GroupOf(element);
+    if (group == kString) {
+      entry.offset = static_cast<uint32_t>(string_count++);
+    } else if (element.value_size() == 0) {
+      return;
+    } else {
+      // Values are naturally aligned within the buffer, arrays to the size
+      // of their values
+      const std::size_t value_size = element.value_size();
+      const std::size_t alignment =
+          element.extent() != 0 ? value_size / element.extent() : value_size;
+      size_ = (size_ + alignment - 1) / alignment * alignment;
+      entry.offset = static_cast<uint32_t>(size_);
+      size_ += value_size;
+    }
+    groups_[group].push_back(Slot{&element, entry.offset});
+  });
+  for (int group = 0; group < kGroupCount; ++group) {
+    const std::size_t size = groups_[group].size();
+    for (std::size_t begin = 0; begin < size; begin += kCaptureChunkSize) {
+      chunks_.push_back(Chunk{static_cast<Group>(group), begin,
+                              std::min(size, begin + kCaptureChunkSize)});
+    }
+  }
+  for (Buffer& buffer : buffers_) {
+    buffer.words.reset(new uint64_t[(size_ + 7) / 8]());
+    buffer.strings.resize(string_count);
+  }
+}
+
+template <typename T>
+void Snapshot::CaptureSlots(const Slot* begin, const Slot* end,
+                            char* bytes) const {
+  for (const Slot* slot = begin; slot != end; ++slot) {
+    const T value =
+        static_cast<const Registry::ElementTemplate<T>*>(slot->element)
+            ->value();
+    std::memcpy(bytes + slot->offset, &value, sizeof(T));
+  }
+}
+
+void Snapshot::CaptureRange(Group group, std::size_t begin, std::size_t end,
+                            Buffer* buffer) const {
+  const Slot* first = groups_[group].data() + begin;
+  const Slot* last = groups_[group].data() + end;
+  char* bytes = buffer->bytes();
+  switch (group) {
+    case kInt32:
+      return CaptureSlots<int32_t>(first, last, bytes);
+    case kUnsignedInt32:
+      return CaptureSlots<uint32_t>(first, last, bytes);
+    case kInt64:
+      return CaptureSlots<int64_t>(first, last, bytes);
+    case kUnsignedInt64:
+      return CaptureSlots<uint64_t>(first, last, bytes);
+    case kBool:
+      return CaptureSlots<bool>(first, last, bytes);
+    case kChar:
+      return CaptureSlots<char>(first, last, bytes);
+    case kFloat:
+      return CaptureSlots<float>(first, last, bytes);
+    case kDouble:
+      return CaptureSlots<double>(first, last, bytes);
+    case kString:
+      for (const Slot* slot = first; slot != last; ++slot) {
+        // Extracting into the preallocated strings reuses their capacity
+        slot->element->Extract(&buffer->strings[slot->offset]);
+      }
+      return;
+    case kOther:
+    case kGroupCount:
+      for (const Slot* slot = first; slot != last; ++slot) {
+        slot->element->ExtractBytes(bytes + slot->offset);
+      }
+      return;
+  }
+}
+
+bool Snapshot::Capture() {
+  Buffer& buffer = buffers_[back_];
+  const uint64_t epoch = registry_->AdvanceEpoch();
+  for (int group = 0; group < kGroupCount; ++group) {
+    CaptureRange(static_cast<Group>(group), 0, groups_[group].size(),
+                 &buffer);
+  }
+  if (!Stabilise(epoch, &buffer)) {
+    return false;
+  }
+  Publish();
+  return true;
+}
+
+bool Snapshot::Capture(ThreadPool* pool) {
+  Buffer& buffer = buffers_[back_];
+  const uint64_t epoch = registry_->AdvanceEpoch();
+  pool->ParallelFor(chunks_.size(), [this, &buffer](std::size_t index) {
+    const Chunk& chunk = chunks_[index];
+    CaptureRange(chunk.group, chunk.begin, chunk.end, &buffer);
+  });
+  if (!Stabilise(epoch, &buffer)) {
+    return false;
+  }
+  Publish();
+  return true;
+}
+
+bool Snapshot::Stabilise(uint64_t epoch, Buffer* buffer) {
+  for (int pass = 0; pass < kMaxPasses; ++pass) {
+    // Writes from here on stamp their element with next or later, writes
+    // that completed before stamped it with at least epoch if they were not
+    // copied by the previous pass
+    const uint64_t next = registry_->AdvanceEpoch();
+    changed_.clear();
+    for (int group = 0; group < kGroupCount; ++group) {
+      const std::vector<Slot>& slots = groups_[group];
+      for (std::size_t index = 0; index < slots.size(); ++index) {
+        if (slots[index].element->version() >= epoch) {
+          changed_.push_back(
+              Chunk{static_cast<Group>(group), index, index + 1});
+        }
+      }
+    }
+    if (changed_.empty()) {
+      return true;
+    }
+    for (const Chunk& chunk : changed_) {
+      CaptureRange(chunk.group, chunk.begin, chunk.end, buffer);
+    }
+    epoch = next;
+  }
+  return false;
+}
+
+void Snapshot::Publish() {
+  buffers_[back_].sequence = ++captures_;
+  back_ = middle_.exchange(static_cast<uint8_t>(back_) | kFreshBit,
+                           std::memory_order_acq_rel) &
+          kIndexMask;
+}
+
+bool Snapshot::Acquire() {
+  if ((middle_.load(std::memory_order_relaxed) & kFreshBit) == 0) {
+    return false;
+  }
+  front_ = middle_.exchange(static_cast<uint8_t>(front_),
+                            std::memory_order_acq_rel) &
+           kIndexMask;
+  return true;
+}
+
+}  // namespace registry
@@ -0,0 +1,217 @@
+#ifndef REGISTRY_SNAPSHOT_H_
+#define REGISTRY_SNAPSHOT_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "registry/registry.h"
+#include "registry/thread_pool.h"
+
+namespace registry {
+
+/// @class Snapshot
+/// Consistent copy of the values of every element below a registry, taken
+/// at one instant and stored in a contiguous buffer laid out by element id.
+/// Elements are copied one after the other, then the elements written
+/// meanwhile, as told by their version, are copied again until a pass finds
+/// none: a capture never holds the new value of one element and the old
+/// value of another written after it. Captures running alongside writes
+/// take a few more passes, and fail when writes overlap kMaxPasses of them
+/// in a row, such as while the tree is written faster than a pass takes.
+///
+/// Captures are triple buffered between a single capturing thread and a
+/// single reading thread: Capture() fills a back buffer and publishes it,
+/// Acquire() swaps the most recent capture in for reading. Neither side ever
+/// waits for the other, and capturing only reads element values so writers
+/// of the elements are never blocked either
+class Snapshot {
+ public:
+  static constexpr uint32_t kNotCaptured = UINT32_MAX;
+  /// Passes copying again the elements written during a capture before it
+  /// fails
+  static constexpr int kMaxPasses = 8;
+
+  /// Lays out the buffers for every element currently held by registry or
+  /// any of its descendants. Elements added afterwards are not captured
+  /// @param[in] registry registry whose subtree is captured
+  explicit Snapshot(const Registry& registry);
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  /// Copies the current value of every element and publishes the copy. Must
+  /// not be called concurrently with itself
+  /// @return false if writes kept overlapping the capture, in which case
+  /// nothing is published, see the class comment
+  bool Capture();
+
+  /// Same as Capture() with the values copied by the threads of pool, which
+  /// pays off for snapshots of many thousands of elements. Elements copied
+  /// again are copied by the calling thread
+  bool Capture(ThreadPool* pool);
+
+  /// Switches the reader over to the most recently published capture. Must
+  /// not be called concurrently with itself or with the getters below
+  /// @return true if a capture newer than the one being read was acquired
+  bool Acquire();
+
+  /// @return number of the capture being read, starting at 1 for the first
+  /// capture. 0 until a capture has been acquired
+  uint64_t sequence() const { return buffers_[front_].sequence; }
+
+  /// Reads the captured value of an element
+  /// @param[in] handle handle of the element
+  /// @param[out] value captured value
+  /// @return true if the element was captured and holds values of type T
+  template <typename T>
+  bool Get(Registry::ElementHandle handle, T* value) const {
+    if (handle.id() >= layout_.size() ||
+        layout_[handle.id()].offset == kNotCaptured ||
+        layout_[handle.id()].type != TypeTrait<T>::type ||
+        layout_[handle.id()].extent != 0) {
+      return false;
+    }
+    const Buffer& buffer = buffers_[front_];
+    const uint32_t offset = layout_[handle.id()].offset;
+    if constexpr (std::is_same<T, std::string>::value) {
+      *value = buffer.strings[offset];
+    } else {
+      std::memcpy(value, buffer.bytes() + offset, sizeof(T));
+    }
+    return true;
+  }
+
+  /// Reads the captured values of an array element
+  /// @param[in] handle handle of the element
+  /// @param[out] values as many values as the element holds
+  /// @return true if the element was captured and is an array of type T
+  template <typename T>
+  bool GetArray(Registry::ElementHandle handle, T* values) const {
+    if (handle.id() >= layout_.size() ||
+        layout_[handle.id()].offset == kNotCaptured ||
+        layout_[handle.id()].type != TypeTrait<T>::type ||
+        layout_[handle.id()].extent == 0) {
+      return false;
+    }
+    std::memcpy(values, buffers_[front_].bytes() + layout_[handle.id()].offset,
+                layout_[handle.id()].extent * sizeof(T));
+    return true;
+  }
+
+  /// @return offset of the value of an element within data(), or the index
+  /// of the value within strings() for string elements. kNotCaptured if the
+  /// element is not part of the snapshot
+  uint32_t Offset(Registry::ElementHandle handle) const {
+    return handle.id() < layout_.size() ? layout_[handle.id()].offset
+                                        : kNotCaptured;
+  }
+
+  /// @return raw bytes of the capture being read
+  const char* data() const { return buffers_[front_].bytes(); }
+  std::size_t size() const { return size_; }
+
+  /// @return string values of the capture being read
+  const std::vector<std::string>& strings() const {
+    return buffers_[front_].strings;
+  }
+
+ private:
+  static constexpr int kBufferCount = 3;
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFreshBit = 0x4;
+
+  struct Entry {
+    TypeEnum type;
+    // Number of values of array elements, 0 otherwise
+    uint32_t extent;
+    uint32_t offset;
+  };
+
+  struct Slot {
+    const Registry::Element* element;
+    uint32_t offset;
+  };
+
+  struct Buffer {
+    char* bytes() const { return reinterpret_cast<char*>(words.get()); }
+
+    std::unique_ptr<uint64_t[]> words;
+    std::vector<std::string> strings;
+    uint64_t sequence = 0;
+  };
+
+  // Slots grouped by value type so that every group is copied by a tight,
+  // fully typed loop. Enums, whose type is unknown here, and arrays go
+  // through the type-erased Extract of the element
+  enum Group {
+    kInt32,
+    kUnsignedInt32,
+    kInt64,
+    kUnsignedInt64,
+    kBool,
+    kChar,
+    kFloat,
+    kDouble,
+    kString,
+    kOther,
+    kGroupCount,
+  };
+
+  // @return group of an element, resolved from its concrete class
+  static Group GroupOf(const Registry::Element& element);
+  template <typename T>
+  static Group GroupOf(const Registry::ElementTemplate<T>& element);
+
+  // Run of the slots of a group, copied by a single task of a parallel
+  // capture
+  struct Chunk {
+    Group group;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  static constexpr std::size_t kCaptureChunkSize = 1024;
+
+  template <typename T>
+  void CaptureSlots(const Slot* begin, const Slot* end, char* bytes) const;
+
+  // Copies the values of the slots [begin, end) of a group into buffer
+  void CaptureRange(Group group, std::size_t begin, std::size_t end,
+                    Buffer* buffer) const;
+
+  // Copies again the elements written since epoch, advancing the epoch
+  // before every pass, until a pass finds none. The buffer then holds the
+  // values of every element as of the start of the last pass
+  // @return false if kMaxPasses passes all found elements written
+  bool Stabilise(uint64_t epoch, Buffer* buffer);
+
+  // Hands the back buffer, filled by a capture, over to the reader
+  void Publish();
+
+  const Registry* const registry_;
+
+  std::vector<Entry> layout_;
+  std::array<std::vector<Slot>, kGroupCount> groups_;
+  std::vector<Chunk> chunks_;
+  std::size_t size_;
+  // Slots written during a pass of Stabilise(), kept to reuse its capacity
+  std::vector<Chunk> changed_;
+
+  Buffer buffers_[kBufferCount];
+  int back_;
+  int front_;
+  // Index of the buffer shared between both sides, plus kFreshBit when it
+  // holds a capture the reader has not acquired yet
+  std::atomic<uint8_t> middle_;
+  uint64_t captures_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_SNAPSHOT_H_
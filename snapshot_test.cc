@@ -0,0 +1,244 @@
+#include "registry/snapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/enum_traits.h"
+
+namespace registry {
+
+enum class SnapshotEnum { kFirst, kSecond };
+
+}  // namespace registry
+
+namespace common {
+
+template <>
+constexpr registry::SnapshotEnum
+EnumTrait<registry::SnapshotEnum>::default_value() {
+  return registry::SnapshotEnum::kFirst;
+}
+
+}  // namespace common
+
+namespace registry {
+
+TEST(SnapshotTest, CaptureAndAcquire) {
+  Registry root("root");
+  Registry* child = root.AddChildRegistry("child").ValueOrDie();
+  Registry::Double* value = root.AddDouble("value").ValueOrDie();
+  Registry::Int32* count = child->AddInt32("count").ValueOrDie();
+  Registry::Bool* flag = child->AddBoolean("flag").ValueOrDie();
+  Registry::String* label = child->AddString("label", "first").ValueOrDie();
+  Registry::Enum<SnapshotEnum>* mode =
+      child->AddEnum<SnapshotEnum>("mode").ValueOrDie();
+  *value = 1.5;
+  *count = 3;
+  *flag = true;
+  *mode = SnapshotEnum::kSecond;
+
+  Snapshot snapshot(root);
+  EXPECT_FALSE(snapshot.Acquire());
+  EXPECT_EQ(snapshot.sequence(), 0u);
+
+  snapshot.Capture();
+  *value = 2.5;
+  *label = "second";
+  EXPECT_TRUE(snapshot.Acquire());
+  EXPECT_FALSE(snapshot.Acquire());
+  EXPECT_EQ(snapshot.sequence(), 1u);
+
+  double double_value = 0.0;
+  EXPECT_TRUE(snapshot.Get(value->handle(), &double_value));
+  EXPECT_EQ(double_value, 1.5);
+  int32_t int_value = 0;
+  EXPECT_TRUE(snapshot.Get(count->handle(), &int_value));
+  EXPECT_EQ(int_value, 3);
+  bool bool_value = false;
+  EXPECT_TRUE(snapshot.Get(flag->handle(), &bool_value));
+  EXPECT_TRUE(bool_value);
+  std::string string_value;
+  EXPECT_TRUE(snapshot.Get(label->handle(), &string_value));
+  EXPECT_EQ(string_value, "first");
+  SnapshotEnum enum_value = SnapshotEnum::kFirst;
+  EXPECT_TRUE(snapshot.Get(mode->handle(), &enum_value));
+  EXPECT_EQ(enum_value, SnapshotEnum::kSecond);
+
+  // Type mismatches and unknown handles are rejected
+  EXPECT_FALSE(snapshot.Get(value->handle(), &int_value));
+  EXPECT_FALSE(snapshot.Get(Registry::ElementHandle(), &double_value));
+
+  snapshot.Capture();
+  EXPECT_TRUE(snapshot.Acquire());
+  EXPECT_EQ(snapshot.sequence(), 2u);
+  EXPECT_TRUE(snapshot.Get(value->handle(), &double_value));
+  EXPECT_EQ(double_value, 2.5);
+  EXPECT_TRUE(snapshot.Get(label->handle(), &string_value));
+  EXPECT_EQ(string_value, "second");
+}
+
+TEST(SnapshotTest, ParallelCapture) {
+  Registry root("root");
+  std::vector<Registry::Int64*> counts;
+  std::vector<Registry::String*> labels;
+  for (int child = 0; child < 8; ++child) {
+    Registry* registry =
+        root.AddChildRegistry("child" + std::to_string(child)).ValueOrDie();
+    for (int element = 0; element < 500; ++element) {
+      counts.push_back(
+          registry->AddInt64("count" + std::to_string(element)).ValueOrDie());
+    }
+    labels.push_back(registry->AddString("label", "").ValueOrDie());
+  }
+  for (std::size_t index = 0; index < counts.size(); ++index) {
+    *counts[index] = static_cast<int64_t>(index) * 3;
+  }
+  for (std::size_t index = 0; index < labels.size(); ++index) {
+    *labels[index] = std::to_string(index);
+  }
+
+  ThreadPool pool(4);
+  Snapshot snapshot(root);
+  snapshot.Capture(&pool);
+  ASSERT_TRUE(snapshot.Acquire());
+  EXPECT_EQ(snapshot.sequence(), 1u);
+  for (std::size_t index = 0; index < counts.size(); ++index) {
+    int64_t value = 0;
+    ASSERT_TRUE(snapshot.Get(counts[index]->handle(), &value));
+    EXPECT_EQ(value, static_cast<int64_t>(index) * 3);
+  }
+  for (std::size_t index = 0; index < labels.size(); ++index) {
+    std::string value;
+    ASSERT_TRUE(snapshot.Get(labels[index]->handle(), &value));
+    EXPECT_EQ(value, std::to_string(index));
+  }
+}
+
+TEST(SnapshotTest, Layout) {
+  Registry root("root");
+  Registry* child = root.AddChildRegistry("child").ValueOrDie();
+  Registry::Char* letter = root.AddChar("letter", 'a').ValueOrDie();
+  Registry::Double* value = child->AddDouble("value").ValueOrDie();
+  Registry::Int32* count = child->AddInt32("count").ValueOrDie();
+  *count = 7;
+
+  // Only the subtree of the given registry is captured
+  Snapshot snapshot(*child);
+  EXPECT_EQ(snapshot.Offset(letter->handle()), Snapshot::kNotCaptured);
+  EXPECT_EQ(snapshot.size(), sizeof(double) + sizeof(int32_t));
+  EXPECT_EQ(snapshot.Offset(value->handle()) % alignof(double), 0u);
+
+  // Elements added after construction are not part of the snapshot
+  Registry::Double* late = child->AddDouble("late").ValueOrDie();
+  EXPECT_EQ(snapshot.Offset(late->handle()), Snapshot::kNotCaptured);
+
+  snapshot.Capture();
+  ASSERT_TRUE(snapshot.Acquire());
+  int32_t int_value = 0;
+  std::memcpy(&int_value, snapshot.data() + snapshot.Offset(count->handle()),
+              sizeof(int_value));
+  EXPECT_EQ(int_value, 7);
+}
+
+// Every capture must hold values written together by the writer: the reader
+// never sees a capture that is torn between two of its buffers
+TEST(SnapshotTest, ConcurrentCaptureAndRead) {
+  Registry root("root");
+  Registry::Int64* counter = root.AddInt64("counter").ValueOrDie();
+  Registry::String* text = root.AddString("text", "").ValueOrDie();
+
+  Snapshot snapshot(root);
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (int64_t iteration = 1; iteration <= 2000; ++iteration) {
+      *counter = iteration;
+      *text = std::to_string(iteration);
+      snapshot.Capture();
+    }
+    done = true;
+  });
+
+  uint64_t last_sequence = 0;
+  while (true) {
+    const bool finished = done;
+    if (!snapshot.Acquire()) {
+      if (finished) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    EXPECT_GT(snapshot.sequence(), last_sequence);
+    last_sequence = snapshot.sequence();
+    int64_t value = 0;
+    std::string string_value;
+    ASSERT_TRUE(snapshot.Get(counter->handle(), &value));
+    ASSERT_TRUE(snapshot.Get(text->handle(), &string_value));
+    EXPECT_EQ(static_cast<uint64_t>(value), snapshot.sequence());
+    EXPECT_EQ(string_value, std::to_string(value));
+  }
+  writer.join();
+  EXPECT_EQ(last_sequence, 2000u);
+}
+
+// Captures hold the values of one instant: the writer writes first, second
+// then third, which the capture copies as first, third then second, so any
+// write landing between two copies breaks the order of the values
+TEST(SnapshotTest, CapturesAreConsistentAcrossElements) {
+  Registry root("root");
+  Registry* arm = root.AddChildRegistry("arm").ValueOrDie();
+  Registry::Int64* first = root.AddInt64("first").ValueOrDie();
+  Registry::Double* second = arm->AddDouble("second").ValueOrDie();
+  // Padding between first and third widens the window a capture can be
+  // preempted in
+  for (int index = 0; index < 1000; ++index) {
+    arm->AddInt64("padding" + std::to_string(index)).ValueOrDie();
+  }
+  Registry::Int64* third = arm->AddInt64("third").ValueOrDie();
+
+  // The writer updates the elements periodically, like a control loop
+  Snapshot snapshot(root);
+  ThreadPool pool(2);
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (int64_t iteration = 1; iteration <= 200; ++iteration) {
+      *first = iteration;
+      *second = static_cast<double>(iteration);
+      *third = iteration;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    done = true;
+  });
+  int published = 0;
+  for (int captures = 0; !done; ++captures) {
+    const bool captured =
+        captures % 2 == 0 ? snapshot.Capture() : snapshot.Capture(&pool);
+    if (!captured) {
+      continue;
+    }
+    ++published;
+    EXPECT_TRUE(snapshot.Acquire());
+    int64_t first_value = 0;
+    double second_value = 0.0;
+    int64_t third_value = 0;
+    EXPECT_TRUE(snapshot.Get(first->handle(), &first_value));
+    EXPECT_TRUE(snapshot.Get(second->handle(), &second_value));
+    EXPECT_TRUE(snapshot.Get(third->handle(), &third_value));
+    EXPECT_LE(static_cast<double>(third_value), second_value);
+    EXPECT_LE(second_value, static_cast<double>(first_value));
+    EXPECT_LE(first_value, third_value + 1);
+    if (HasFailure()) {
+      break;
+    }
+  }
+  writer.join();
+  EXPECT_GT(published, 0);
+}
+
+}  // namespace registry
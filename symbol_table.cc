@@ -0,0 +1,58 @@
+#include "registry/symbol_table.h"
+
+#include <cstring>
+
+namespace registry {
+
+namespace internal {
+
+Symbol SymbolTable::Intern(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (const Entry* entry = index_.Find(name)) {
+    return entry->symbol;
+  }
+  Entry entry;
+  entry.text = arena_.CopyString(name);
+  entry.symbol = static_cast<Symbol>(entries_.size());
+  // The entry is published in the table before the index, so that readers
+  // finding its symbol can always resolve it
+  index_.Insert(&entries_[entries_.PushBack(entry)]);
+  return entry.symbol;
+}
+
+void CompactName::Reference(std::string_view text) {
+  Release();
+  if (text.size() <= kInlineSize) {
+    std::memcpy(inline_, text.data(), text.size());
+  } else {
+    data_ = text.data();
+  }
+  size_ = static_cast<uint32_t>(text.size());
+}
+
+void CompactName::Join(std::string_view prefix, char separator,
+                       std::string_view name, Arena* arena) {
+  Release();
+  const std::size_t size = prefix.size() + 1 + name.size();
+  char* data = inline_;
+  if (size > kInlineSize) {
+    data = arena != nullptr
+               ? static_cast<char*>(arena->Allocate(size, alignof(char)))
+               : new char[size];
+    data_ = data;
+    heap_allocated_ = arena == nullptr;
+  }
+  std::memcpy(data, prefix.data(), prefix.size());
+  data[prefix.size()] = separator;
+  std::memcpy(data + prefix.size() + 1, name.data(), name.size());
+  size_ = static_cast<uint32_t>(size);
+}
+
+SymbolTable& GlobalSymbolTable() {
+  static SymbolTable* const table = new SymbolTable();
+  return *table;
+}
+
+}  // namespace internal
+
+}  // namespace registry
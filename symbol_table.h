@@ -0,0 +1,261 @@
+#ifndef REGISTRY_SYMBOL_TABLE_H_
+#define REGISTRY_SYMBOL_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "registry/arena.h"
+#include "registry/concurrent_containers.h"
+
+namespace registry {
+
+namespace internal {
+
+/// Dense identifier of a name interned in a SymbolTable
+using Symbol = uint32_t;
+
+constexpr Symbol kInvalidSymbol = std::numeric_limits<Symbol>::max();
+
+/// @class SymbolTable
+/// Insert-only table of interned names. Each distinct name is stored once and
+/// identified by a dense Symbol, so that nodes sharing a name share its
+/// storage and names are compared by comparing their symbols.
+///
+/// Find() and text() are lock-free and may run concurrently with Intern().
+/// Symbols are never released, the table grows with the number of distinct
+/// names only
+class SymbolTable {
+ public:
+  SymbolTable() = default;
+
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+
+  /// @param[in] name name to intern
+  /// @return symbol of the name, interned on first use
+  Symbol Intern(std::string_view name);
+
+  /// @param[in] name name to look up
+  /// @return symbol of the name, kInvalidSymbol if it was never interned
+  Symbol Find(std::string_view name) const {
+    const Entry* entry = index_.Find(name);
+    return entry == nullptr ? kInvalidSymbol : entry->symbol;
+  }
+
+  /// @param[in] symbol symbol returned by Intern() or Find()
+  /// @return interned name, valid for the lifetime of the table
+  std::string_view text(Symbol symbol) const { return entries_[symbol].text; }
+
+  /// @return number of distinct names interned
+  std::size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    std::string_view text;
+    Symbol symbol = kInvalidSymbol;
+  };
+
+  struct TextOf {
+    std::string_view operator()(const Entry& entry) const {
+      return entry.text;
+    }
+  };
+
+  // Serialises Intern(), lookups never take it
+  std::mutex mutex_;
+  Arena arena_;
+  // Entries are indexed by symbol and never move, the index views them
+  ConcurrentTable<Entry> entries_;
+  ConcurrentNameMap<const Entry, TextOf> index_;
+};
+
+/// @return table interning the names of every registry tree of the process.
+/// Never destroyed, so that names stay valid during static destruction
+SymbolTable& GlobalSymbolTable();
+
+/// @class CompactName
+/// Dotted name of a registry node in 24 bytes. Names of up to kInlineSize
+/// characters are stored inline, longer ones in an arena, on the heap or in
+/// storage that outlives the node, such as a SymbolTable
+class CompactName {
+ public:
+  static constexpr std::size_t kInlineSize = 16;
+
+  CompactName() : size_(0), heap_allocated_(false) {}
+  ~CompactName() { Release(); }
+
+  CompactName(const CompactName&) = delete;
+  CompactName& operator=(const CompactName&) = delete;
+
+  std::string_view view() const {
+    return std::string_view(size_ <= kInlineSize ? inline_ : data_, size_);
+  }
+
+  /// Views text, or copies it inline when it is short enough
+  /// @param[in] text name, must outlive the node unless it is stored inline
+  void Reference(std::string_view text);
+
+  /// Stores prefix and name joined by separator
+  /// @param[in] prefix dotted name of the parent node
+  /// @param[in] separator character separating the names
+  /// @param[in] name name of the node
+  /// @param[in] arena arena storing long names, nullptr to store them on the
+  /// heap
+  void Join(std::string_view prefix, char separator, std::string_view name,
+            Arena* arena);
+
+ private:
+  void Release() {
+    if (heap_allocated_) {
+      delete[] data_;
+      heap_allocated_ = false;
+    }
+  }
+
+  union {
+    char inline_[kInlineSize];
+    const char* data_;
+  };
+  uint32_t size_;
+  bool heap_allocated_;
+};
+
+/// @class ConcurrentSymbolMap
+/// Insert-only open addressing hash map from symbols to non-owning pointers,
+/// the lock-free counterpart of ConcurrentNameMap for interned names. The
+/// symbol of a value is obtained from the value through SymbolOf and copied
+/// into its slot, so probing compares integers without touching the values.
+///
+/// Find() and ForEach() are lock-free and may run concurrently with Insert().
+/// Calls to Insert() and Reserve() must be serialised by the caller
+template <typename T, typename SymbolOf>
+class ConcurrentSymbolMap {
+ public:
+  ConcurrentSymbolMap() : size_(0) { Publish(kMinCapacity); }
+
+  ConcurrentSymbolMap(const ConcurrentSymbolMap&) = delete;
+  ConcurrentSymbolMap& operator=(const ConcurrentSymbolMap&) = delete;
+
+  T* Find(Symbol symbol) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (std::size_t index = Spread(symbol) & table->mask;;
+         index = (index + 1) & table->mask) {
+      const Slot& slot = table->slots[index];
+      T* value = slot.value.load(std::memory_order_acquire);
+      if (value == nullptr) {
+        return nullptr;
+      }
+      if (slot.symbol == symbol) {
+        return value;
+      }
+    }
+  }
+
+  /// Inserts value under the symbol returned by SymbolOf, unless it is in use
+  /// @return the value stored under the symbol and whether it was inserted
+  std::pair<T*, bool> Insert(T* value) {
+    const Symbol symbol = SymbolOf()(*value);
+    if (T* existing = Find(symbol)) {
+      return std::make_pair(existing, false);
+    }
+    Reserve(size_.load(std::memory_order_relaxed) + 1);
+    Place(table_.load(std::memory_order_relaxed), symbol, value);
+    size_.fetch_add(1, std::memory_order_release);
+    return std::make_pair(value, true);
+  }
+
+  /// Grows the table so that it can hold count values without growing again
+  void Reserve(std::size_t count) {
+    const Table* table = table_.load(std::memory_order_relaxed);
+    std::size_t capacity = table->mask + 1;
+    while (count * 2 > capacity) {
+      capacity *= 2;
+    }
+    if (capacity == table->mask + 1) {
+      return;
+    }
+    Table* grown = Publish(capacity);
+    for (std::size_t index = 0; index <= table->mask; ++index) {
+      const Slot& slot = table->slots[index];
+      if (T* value = slot.value.load(std::memory_order_relaxed)) {
+        Place(grown, slot.symbol, value);
+      }
+    }
+    table_.store(grown, std::memory_order_release);
+  }
+
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  /// Calls function with every value of the map, in no particular order
+  template <typename Function>
+  void ForEach(Function function) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (std::size_t index = 0; index <= table->mask; ++index) {
+      T* value = table->slots[index].value.load(std::memory_order_acquire);
+      if (value != nullptr) {
+        function(*value);
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kMinCapacity = 8;
+
+  struct Slot {
+    Symbol symbol = kInvalidSymbol;
+    std::atomic<T*> value{nullptr};
+  };
+
+  struct Table {
+    explicit Table(std::size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]) {}
+
+    const std::size_t mask;
+    const std::unique_ptr<Slot[]> slots;
+  };
+
+  // Symbols are dense, multiplying spreads consecutive ones over the table
+  static std::size_t Spread(Symbol symbol) {
+    const uint64_t spread = symbol * 0x9e3779b97f4a7c15ull;
+    return static_cast<std::size_t>(spread >> 32);
+  }
+
+  // Allocates a table of the given capacity, only publishing it straight
+  // away when the map does not have one yet
+  Table* Publish(std::size_t capacity) {
+    tables_.push_back(std::make_unique<Table>(capacity));
+    if (tables_.size() == 1) {
+      table_.store(tables_.back().get(), std::memory_order_release);
+    }
+    return tables_.back().get();
+  }
+
+  // The symbol is written before the value is released, readers only look at
+  // the symbol of slots whose value they acquired
+  static void Place(Table* table, Symbol symbol, T* value) {
+    std::size_t index = Spread(symbol) & table->mask;
+    while (table->slots[index].value.load(std::memory_order_relaxed) !=
+           nullptr) {
+      index = (index + 1) & table->mask;
+    }
+    table->slots[index].symbol = symbol;
+    table->slots[index].value.store(value, std::memory_order_release);
+  }
+
+  std::atomic<Table*> table_;
+  std::atomic<std::size_t> size_;
+  std::vector<std::unique_ptr<Table>> tables_;
+};
+
+}  // namespace internal
+
+}  // namespace registry
+
+#endif  // REGISTRY_SYMBOL_TABLE_H_
@@ -0,0 +1,113 @@
+#include "registry/symbol_table.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+namespace internal {
+
+namespace {
+
+struct Node {
+  Symbol symbol;
+};
+
+struct SymbolOfNode {
+  Symbol operator()(const Node& node) const { return node.symbol; }
+};
+
+}  // namespace
+
+TEST(SymbolTableTest, InternsEachNameOnce) {
+  SymbolTable table;
+  EXPECT_EQ(table.Find("gain"), kInvalidSymbol);
+  const Symbol gain = table.Intern("gain");
+  const Symbol offset = table.Intern(std::string("offset"));
+  EXPECT_NE(gain, offset);
+  EXPECT_EQ(table.Intern(std::string("gain")), gain);
+  EXPECT_EQ(table.Find("gain"), gain);
+  EXPECT_EQ(table.size(), 2u);
+
+  // Interned text does not view the caller's storage
+  std::string name("enabled");
+  const Symbol enabled = table.Intern(name);
+  name.assign("changed");
+  EXPECT_EQ(table.text(enabled), "enabled");
+  EXPECT_EQ(table.text(gain), "gain");
+}
+
+TEST(SymbolTableTest, FindsWhileInterning) {
+  SymbolTable table;
+  constexpr int kCount = 5000;
+  std::thread writer([&table]() {
+    for (int index = 0; index < kCount; ++index) {
+      table.Intern("name" + std::to_string(index));
+    }
+  });
+  // Symbols are dense and resolvable as soon as they can be found
+  std::size_t found = 0;
+  while (found < kCount) {
+    const std::string name = "name" + std::to_string(found);
+    const Symbol symbol = table.Find(name);
+    if (symbol == kInvalidSymbol) {
+      continue;
+    }
+    ASSERT_EQ(symbol, found);
+    ASSERT_EQ(table.text(symbol), name);
+    ++found;
+  }
+  writer.join();
+}
+
+TEST(SymbolTableTest, SymbolMapTest) {
+  ConcurrentSymbolMap<Node, SymbolOfNode> map;
+  std::vector<std::unique_ptr<Node>> nodes;
+  for (Symbol symbol = 0; symbol < 1000; ++symbol) {
+    nodes.push_back(std::make_unique<Node>(Node{symbol * 3}));
+    EXPECT_TRUE(map.Insert(nodes.back().get()).second);
+  }
+  Node duplicate{3};
+  std::pair<Node*, bool> inserted = map.Insert(&duplicate);
+  EXPECT_FALSE(inserted.second);
+  EXPECT_EQ(inserted.first, nodes[1].get());
+  EXPECT_EQ(map.size(), 1000u);
+  for (Symbol symbol = 0; symbol < 3000; ++symbol) {
+    Node* node = map.Find(symbol);
+    if (symbol % 3 == 0) {
+      ASSERT_EQ(node, nodes[symbol / 3].get());
+    } else {
+      ASSERT_EQ(node, nullptr);
+    }
+  }
+  std::size_t visited = 0;
+  map.ForEach([&visited](const Node&) { ++visited; });
+  EXPECT_EQ(visited, 1000u);
+}
+
+TEST(SymbolTableTest, CompactNameTest) {
+  EXPECT_EQ(sizeof(CompactName), 24u);
+  Arena arena;
+  CompactName name;
+  name.Reference("gain");
+  EXPECT_EQ(name.view(), "gain");
+  const std::string_view interned = "a_name_longer_than_inline";
+  name.Reference(interned);
+  EXPECT_EQ(name.view().data(), interned.data());
+
+  // Short names are stored inline whether or not an arena is given
+  name.Join("robot.arm", '.', "gain", &arena);
+  EXPECT_EQ(name.view(), "robot.arm.gain");
+  EXPECT_EQ(arena.SpaceAllocated(), 0u);
+  name.Join("robot.arm.joint1", '.', "offset", nullptr);
+  EXPECT_EQ(name.view(), "robot.arm.joint1.offset");
+  name.Join("robot.arm.joint1", '.', "offset", &arena);
+  EXPECT_EQ(name.view(), "robot.arm.joint1.offset");
+  EXPECT_GT(arena.SpaceAllocated(), 0u);
+}
+
+}  // namespace internal
+}  // namespace registry
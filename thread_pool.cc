@@ -0,0 +1,139 @@
+#include "registry/thread_pool.h"
+
+#include <algorithm>
+
+namespace registry {
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+    : thread_count_(std::max<std::size_t>(thread_count, 1)),
+      ranges_(new Range[thread_count_]),
+      task_(nullptr),
+      generation_(0),
+      busy_(0),
+      stopping_(false) {
+  threads_.reserve(thread_count_ - 1);
+  for (std::size_t worker = 1; worker < thread_count_; ++worker) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::ParallelFor(std::size_t count,
+                             const std::function<void(std::size_t)>& task) {
+  std::lock_guard<std::mutex> call_lock(call_mutex_);
+  if (thread_count_ == 1 || count <= 1) {
+    for (std::size_t index = 0; index < count; ++index) {
+      task(index);
+    }
+    return;
+  }
+  for (std::size_t worker = 0; worker < thread_count_; ++worker) {
+    std::lock_guard<std::mutex> lock(ranges_[worker].mutex);
+    ranges_[worker].begin = count * worker / thread_count_;
+    ranges_[worker].end = count * (worker + 1) / thread_count_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    busy_ = thread_count_ - 1;
+    ++generation_;
+  }
+  start_.notify_all();
+  RunTasks(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(std::size_t worker) {
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    start_.wait(lock, [this, generation] {
+      return stopping_ || generation_ != generation;
+    });
+    if (stopping_) {
+      return;
+    }
+    generation = generation_;
+    lock.unlock();
+    RunTasks(worker);
+    lock.lock();
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunTasks(std::size_t worker) {
+  Range& range = ranges_[worker];
+  for (;;) {
+    std::size_t index;
+    bool has_task;
+    {
+      // The end is moved by thieves, so it is only read under the lock
+      std::lock_guard<std::mutex> lock(range.mutex);
+      index = range.begin;
+      has_task = index != range.end;
+      if (has_task) {
+        ++range.begin;
+      }
+    }
+    if (has_task) {
+      (*task_)(index);
+    } else if (!Steal(worker)) {
+      return;
+    }
+  }
+}
+
+bool ThreadPool::Steal(std::size_t worker) {
+  for (;;) {
+    std::size_t victim = worker;
+    std::size_t largest = 0;
+    for (std::size_t other = 0; other < thread_count_; ++other) {
+      if (other == worker) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(ranges_[other].mutex);
+      const std::size_t size = ranges_[other].end - ranges_[other].begin;
+      if (size > largest) {
+        victim = other;
+        largest = size;
+      }
+    }
+    if (largest == 0) {
+      return false;
+    }
+    std::size_t begin;
+    std::size_t end;
+    {
+      std::lock_guard<std::mutex> lock(ranges_[victim].mutex);
+      Range& range = ranges_[victim];
+      if (range.begin == range.end) {
+        // Drained since it was sized up, look again
+        continue;
+      }
+      // The victim keeps the front half, which it is working through
+      end = range.end;
+      begin = end - (end - range.begin + 1) / 2;
+      range.end = begin;
+    }
+    std::lock_guard<std::mutex> lock(ranges_[worker].mutex);
+    ranges_[worker].begin = begin;
+    ranges_[worker].end = end;
+    return true;
+  }
+}
+
+}  // namespace registry
@@ -0,0 +1,83 @@
+#ifndef REGISTRY_THREAD_POOL_H_
+#define REGISTRY_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace registry {
+
+/// @class ThreadPool
+/// Fixed set of threads running the tasks of one ParallelFor() at a time.
+/// The tasks of a call are dealt out as one contiguous range per thread, the
+/// calling thread included. A thread runs its range from the front and, once
+/// it is done, steals the back half of the largest range left, so uneven
+/// tasks are balanced without any central queue
+class ThreadPool {
+ public:
+  /// @param[in] thread_count number of threads running tasks, the thread
+  /// calling ParallelFor() included. A pool of one thread runs every task on
+  /// the calling thread
+  explicit ThreadPool(std::size_t thread_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// @return number of threads running tasks, the calling thread included
+  std::size_t size() const { return thread_count_; }
+
+  /// Runs task(index) for every index in [0, count) and returns once all of
+  /// them are done. Tasks run concurrently and in no particular order. Calls
+  /// are serialised; tasks must not call ParallelFor() themselves
+  /// @param[in] count number of tasks
+  /// @param[in] task function called with the index of each task
+  void ParallelFor(std::size_t count,
+                   const std::function<void(std::size_t)>& task);
+
+ private:
+  // Tasks left to a thread, [begin, end). Padded so that threads popping
+  // their own range do not share cache lines
+  struct alignas(64) Range {
+    std::mutex mutex;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+
+  void WorkerLoop(std::size_t worker);
+
+  // Runs tasks from the range of worker, then stolen ones, until none is left
+  void RunTasks(std::size_t worker);
+
+  // Moves the back half of the largest range of another thread to the range
+  // of worker
+  // @return false if there was nothing left to steal
+  bool Steal(std::size_t worker);
+
+  const std::size_t thread_count_;
+  // One range per thread, the calling thread's first
+  std::unique_ptr<Range[]> ranges_;
+  std::vector<std::thread> threads_;
+
+  // Serialises calls to ParallelFor()
+  std::mutex call_mutex_;
+
+  // Guards the fields below, which hand a call over to the workers
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(std::size_t)>* task_;
+  uint64_t generation_;
+  // Number of workers still running tasks of the current call
+  std::size_t busy_;
+  bool stopping_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_THREAD_POOL_H_
@@ -0,0 +1,63 @@
+#include "registry/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+  for (std::size_t thread_count : {0, 1, 2, 4, 8}) {
+    ThreadPool pool(thread_count);
+    EXPECT_EQ(pool.size(), std::max<std::size_t>(thread_count, 1));
+    for (std::size_t count : {0, 1, 3, 1000}) {
+      std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[count]());
+      pool.ParallelFor(count, [&runs](std::size_t index) { ++runs[index]; });
+      for (std::size_t index = 0; index < count; ++index) {
+        EXPECT_EQ(runs[index].load(), 1) << index;
+      }
+    }
+  }
+}
+
+TEST(ThreadPoolTest, BalancesUnevenTasks) {
+  // Every slow task is dealt to the calling thread, the others steal them
+  ThreadPool pool(4);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  pool.ParallelFor(64, [&mutex, &threads](std::size_t index) {
+    if (index < 16) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    }
+  });
+  EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(ThreadPoolTest, StealingRunsEveryTaskOnce) {
+  // Short tasks of uneven cost keep workers stealing from ranges that are
+  // being drained, each task must still run exactly once
+  ThreadPool pool(8);
+  constexpr std::size_t kCount = 512;
+  std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[kCount]());
+  for (int round = 0; round < 200; ++round) {
+    pool.ParallelFor(kCount, [&runs](std::size_t index) {
+      if (index % 64 == 0) {
+        std::this_thread::yield();
+      }
+      ++runs[index];
+    });
+  }
+  for (std::size_t index = 0; index < kCount; ++index) {
+    EXPECT_EQ(runs[index].load(), 200) << index;
+  }
+}
+
+}  // namespace registry
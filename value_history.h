@@ -0,0 +1,165 @@
+#ifndef REGISTRY_VALUE_HISTORY_H_
+#define REGISTRY_VALUE_HISTORY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace registry {
+
+/// @class ValueHistory
+/// Fixed capacity ring of the most recent values written to an element,
+/// each stamped with the time of its write. Meant for diagnostics such as
+/// the last seconds of a joint command, without running a logger.
+///
+/// There is a single writer, and any number of readers copy windows of the
+/// ring without ever blocking it. Every slot is guarded by a sequence number
+/// as in a seqlock: a reader discards the samples the writer overwrote while
+/// they were copied, so copies only hold whole samples of consecutive
+/// writes. Storage is allocated up front, recording never allocates.
+///
+/// Values are stored as relaxed atomic words, which restricts T to trivially
+/// copyable types
+template <typename T>
+class ValueHistory {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Sample {
+    Clock::time_point time;
+    T value;
+  };
+
+  /// @param[in] capacity number of samples kept, rounded up to a power of two
+  explicit ValueHistory(std::size_t capacity)
+      : mask_(RoundUp(capacity) - 1),
+        slots_(new Slot[mask_ + 1]),
+        count_(0) {
+    // Asserted here rather than on the class, so that elements of any type
+    // can hold a pointer to a history
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Values are copied in and out of the ring as raw words");
+  }
+
+  ValueHistory(const ValueHistory&) = delete;
+  ValueHistory& operator=(const ValueHistory&) = delete;
+
+  /// Appends a sample, overwriting the oldest one when the ring is full.
+  /// Must not be called concurrently with itself
+  void Record(const T& value, Clock::time_point time = Clock::now()) {
+    const uint64_t index = count_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index & mask_];
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    // Odd while the slot is written, readers of the previous sample of the
+    // slot see the sequence move on and discard their copy
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(time.time_since_epoch().count(),
+                    std::memory_order_relaxed);
+    for (std::size_t word = 0; word < kWords; ++word) {
+      slot.words[word].store(words[word], std::memory_order_relaxed);
+    }
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    count_.store(index + 1, std::memory_order_release);
+  }
+
+  /// Copies the most recent samples, oldest first
+  /// @param[in] max_count largest number of samples copied
+  /// @param[out] samples samples copied, replacing its contents
+  /// @return number of samples copied
+  std::size_t CopyLast(std::size_t max_count,
+                       std::vector<Sample>* samples) const {
+    return Copy(max_count, Clock::time_point::min(), samples);
+  }
+
+  /// Copies the samples recorded at or after since, oldest first, such as
+  /// the last two seconds with CopySince(Clock::now() - 2s, &samples)
+  /// @param[out] samples samples copied, replacing its contents
+  /// @return number of samples copied
+  std::size_t CopySince(Clock::time_point since,
+                        std::vector<Sample>* samples) const {
+    return Copy(capacity(), since, samples);
+  }
+
+  std::size_t capacity() const { return mask_ + 1; }
+
+  /// @return number of samples recorded since the history was created
+  uint64_t count() const { return count_.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr std::size_t kWords =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> time{0};
+    std::atomic<uint64_t> words[kWords] = {};
+  };
+
+  static std::size_t RoundUp(std::size_t capacity) {
+    std::size_t rounded = 1;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+    return rounded;
+  }
+
+  // Reads the sample of write index from its slot
+  // @return false if the slot no longer, or not yet, holds that sample
+  bool Read(uint64_t index, Sample* sample) const {
+    const Slot& slot = slots_[index & mask_];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * index + 2) {
+      return false;
+    }
+    const int64_t time = slot.time.load(std::memory_order_relaxed);
+    uint64_t words[kWords];
+    for (std::size_t word = 0; word < kWords; ++word) {
+      words[word] = slot.words[word].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      return false;
+    }
+    sample->time = Clock::time_point(Clock::duration(time));
+    std::memcpy(&sample->value, words, sizeof(T));
+    return true;
+  }
+
+  std::size_t Copy(std::size_t max_count, Clock::time_point since,
+                   std::vector<Sample>* samples) const {
+    samples->clear();
+    const uint64_t end = count_.load(std::memory_order_acquire);
+    const uint64_t begin =
+        end - std::min<uint64_t>(end, std::min(max_count, capacity()));
+    Sample sample;
+    for (uint64_t index = begin; index < end; ++index) {
+      if (!Read(index, &sample)) {
+        // Overwritten while copying, and so were the samples before it.
+        // Dropping them keeps the copy a run of consecutive writes
+        samples->clear();
+        continue;
+      }
+      if (sample.time >= since) {
+        samples->push_back(sample);
+      }
+    }
+    return samples->size();
+  }
+
+  const std::size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  // Samples recorded, the next one goes to slot count_ & mask_
+  std::atomic<uint64_t> count_;
+};
+
+}  // namespace registry
+
+#endif  // REGISTRY_VALUE_HISTORY_H_
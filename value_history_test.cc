@@ -0,0 +1,90 @@
+#include "registry/value_history.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace registry {
+
+namespace {
+
+struct Command {
+  uint64_t sequence;
+  double position;
+  uint64_t check;
+};
+
+}  // namespace
+
+TEST(ValueHistoryTest, KeepsTheMostRecentValues) {
+  ValueHistory<int32_t> history(5);
+  EXPECT_EQ(history.capacity(), 8u);
+  std::vector<ValueHistory<int32_t>::Sample> samples;
+  EXPECT_EQ(history.CopyLast(4, &samples), 0u);
+
+  for (int32_t value = 0; value < 3; ++value) {
+    history.Record(value);
+  }
+  EXPECT_EQ(history.CopyLast(8, &samples), 3u);
+  EXPECT_EQ(samples[0].value, 0);
+  EXPECT_EQ(samples[2].value, 2);
+  EXPECT_LE(samples[0].time, samples[2].time);
+
+  for (int32_t value = 3; value < 20; ++value) {
+    history.Record(value);
+  }
+  EXPECT_EQ(history.count(), 20u);
+  EXPECT_EQ(history.CopyLast(100, &samples), 8u);
+  EXPECT_EQ(samples.front().value, 12);
+  EXPECT_EQ(samples.back().value, 19);
+  EXPECT_EQ(history.CopyLast(2, &samples), 2u);
+  EXPECT_EQ(samples.front().value, 18);
+}
+
+TEST(ValueHistoryTest, CopiesSamplesSinceATime) {
+  using Clock = ValueHistory<double>::Clock;
+  ValueHistory<double> history(16);
+  const Clock::time_point start = Clock::now();
+  for (int second = 0; second < 10; ++second) {
+    history.Record(second * 0.5, start + std::chrono::seconds(second));
+  }
+  std::vector<ValueHistory<double>::Sample> samples;
+  EXPECT_EQ(history.CopySince(start + std::chrono::seconds(8), &samples), 2u);
+  EXPECT_EQ(samples[0].value, 4.0);
+  EXPECT_EQ(samples[0].time, start + std::chrono::seconds(8));
+  EXPECT_EQ(samples[1].value, 4.5);
+}
+
+TEST(ValueHistoryTest, ReadersCopyConsistentWindows) {
+  ValueHistory<Command> history(64);
+  std::atomic<bool> done(false);
+  std::thread writer([&history, &done]() {
+    for (uint64_t sequence = 0; sequence < 200000; ++sequence) {
+      history.Record(Command{sequence, sequence * 0.25, ~sequence});
+    }
+    done.store(true);
+  });
+  std::vector<ValueHistory<Command>::Sample> samples;
+  std::size_t copies = 0;
+  while (!done.load() || copies == 0) {
+    history.CopyLast(32, &samples);
+    for (std::size_t index = 0; index < samples.size(); ++index) {
+      const Command& command = samples[index].value;
+      ASSERT_EQ(command.check, ~command.sequence);
+      ASSERT_EQ(command.position, command.sequence * 0.25);
+      if (index != 0) {
+        ASSERT_EQ(command.sequence, samples[index - 1].value.sequence + 1);
+      }
+    }
+    ++copies;
+  }
+  writer.join();
+  EXPECT_EQ(history.CopyLast(32, &samples), 32u);
+  EXPECT_EQ(samples.back().value.sequence, 199999u);
+}
+
+}  // namespace registry